@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "timing.h"
+#include <stdint.h>
+
+#define BENCH_MIN_NS (300 * NSEC_PER_MSEC) /* 每个测试项至少运行的时间 */
+
+/* 被测函数，每次调用处理一块数据 */
+typedef void (*bench_fn_t)(void *ctx);
+
+/*
+ * 重复调用 fn 直到运行时间超过 BENCH_MIN_NS
+ * 参数: fn - 被测函数
+ *       ctx - 传给 fn 的参数
+ *       calls - 输出调用次数
+ * 返回: 总耗时（纳秒）
+ */
+int64_t bench_run(bench_fn_t fn, void *ctx, long *calls);
+
+/*
+ * 把 stdout 重定向到 /dev/null，测量打印函数时使用
+ * 返回: 原 stdout 的文件描述符，供 bench_stdout_restore() 恢复
+ */
+int bench_stdout_mute(void);
+
+/*
+ * 恢复 bench_stdout_mute() 重定向前的 stdout
+ */
+void bench_stdout_restore(int saved_fd);
+
+/*
+ * 输出一项测试结果，并记录下来供 --json 和 --baseline 使用
+ * 参数: name - 测试项名称
+ *       value - 结果数值
+ *       unit - 单位，如 "MB/s"。时间单位（ns/us/ms）越小越好，其他越大越好
+ */
+void bench_report(const char *name, double value, const char *unit);
+
+/*
+ * 测试组无法完成某些测试项时调用（准备失败、结果校验不一致等），打印原因并使
+ * uart_bench 以失败退出，避免缺少的结果被当作没有退化
+ * 参数: fmt - printf 格式的原因
+ */
+void bench_fail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* 各测试组 */
+void bench_format(void);
+void bench_hex(void);
+void bench_crc(void);
+void bench_trigger(void);
+void bench_json(void);
+void bench_pty(void);
+
+#endif /* __BENCH_H__ */
@@ -0,0 +1,176 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "checksum.h"
+#include "crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CRC_CHUNK 4096 /* 每次处理的字节数 */
+
+typedef struct {
+	uint8_t data[CRC_CHUNK];
+	size_t len;
+	checksum_t cs;
+	volatile uint32_t result;
+} crc_ctx_t;
+
+/* 参与测试的校验算法 */
+static const char *const checksum_specs[] = {
+    "crc8", "crc16-modbus", "crc16-ccitt", "crc32", "crc32c", "sum8", "xor8",
+};
+
+/* 按 Rocksoft 模型逐位计算，作为 checksum 模块的参考实现 */
+static uint32_t checksum_bitwise(const checksum_t *c, const uint8_t *p, size_t len)
+{
+	uint64_t top = 1ull << (c->width - 1);
+	uint64_t mask = (1ull << c->width) - 1;
+	uint64_t crc = c->init;
+	uint32_t r;
+	uint8_t b;
+	int i;
+
+	if (c->type != CHECKSUM_CRC) {
+		for (r = 0; len > 0; len--) {
+			r = c->type == CHECKSUM_SUM ? r + *p++ : r ^ *p++;
+		}
+		return r & mask;
+	}
+
+	while (len-- > 0) {
+		b = *p++;
+		if (c->reflect) {
+			for (r = 0, i = 0; i < 8; i++) {
+				r = (r << 1) | ((b >> i) & 1);
+			}
+			b = r;
+		}
+		crc ^= (uint64_t)b << (c->width - 8);
+		for (i = 0; i < 8; i++) {
+			crc = (crc & top) ? (crc << 1) ^ c->poly : crc << 1;
+		}
+		crc &= mask;
+	}
+	if (c->reflect) {
+		for (r = 0, i = 0; i < c->width; i++) {
+			r = (r << 1) | ((crc >> i) & 1);
+		}
+		crc = r;
+	}
+
+	return (uint32_t)((crc ^ c->xorout) & mask);
+}
+
+/* 逐位计算，作为参考实现 */
+static uint16_t crc16_bitwise(const uint8_t *p, size_t len)
+{
+	uint16_t crc = CRC16_MODBUS_INIT;
+	int i;
+
+	while (len-- > 0) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+		}
+	}
+	return crc;
+}
+
+static void run_bitwise(void *arg)
+{
+	crc_ctx_t *ctx = arg;
+
+	ctx->result = crc16_bitwise(ctx->data, ctx->len);
+}
+
+static void run_slicing(void *arg)
+{
+	crc_ctx_t *ctx = arg;
+
+	ctx->result = crc16_modbus(ctx->data, ctx->len);
+}
+
+static void run_checksum(void *arg)
+{
+	crc_ctx_t *ctx = arg;
+
+	ctx->result = checksum_compute(&ctx->cs, ctx->data, ctx->len);
+}
+
+static void run_bytes(const char *name, bench_fn_t fn, crc_ctx_t *ctx)
+{
+	int64_t ns;
+	long calls;
+
+	ns = bench_run(fn, ctx, &calls);
+	bench_report(name, (double)calls * ctx->len * 1000.0 / ns, "MB/s");
+}
+
+void bench_crc(void)
+{
+	crc_ctx_t *ctx;
+	unsigned int seed = 1;
+	size_t i;
+
+	ctx = malloc(sizeof(crc_ctx_t));
+	if (ctx == NULL) {
+		bench_fail("crc: out of memory\n");
+		return;
+	}
+
+	for (i = 0; i < CRC_CHUNK; i++) {
+		seed = seed * 1103515245 + 12345;
+		ctx->data[i] = (uint8_t)(seed >> 16);
+	}
+
+	/* 检查所有长度，覆盖 8 字节块之后的尾部 */
+	for (i = 0; i <= 64; i++) {
+		if (crc16_modbus(ctx->data, i) != crc16_bitwise(ctx->data, i)) {
+			bench_fail("crc.modbus16: result mismatch with bitwise at length %zu, skipped\n",
+			           i);
+			free(ctx);
+			return;
+		}
+	}
+
+	ctx->len = CRC_CHUNK;
+	run_bytes("crc.modbus16.bitwise", run_bitwise, ctx);
+	run_bytes("crc.modbus16.slicing8", run_slicing, ctx);
+
+	/* Modbus RTU 帧很短，单独测量 8 字节请求帧的速度 */
+	ctx->len = 6;
+	run_bytes("crc.modbus16.slicing8.request", run_slicing, ctx);
+
+	/* checksum 模块的各算法，名称中带实际使用的实现 */
+	ctx->len = CRC_CHUNK;
+	for (i = 0; i < sizeof(checksum_specs) / sizeof(checksum_specs[0]); i++) {
+		char name[96];
+		size_t len;
+
+		if (checksum_init(&ctx->cs, checksum_specs[i]) < 0) {
+			bench_fail("checksum: invalid algorithm %s, skipped\n", checksum_specs[i]);
+			continue;
+		}
+		for (len = 0; len <= 64; len++) {
+			if (checksum_compute(&ctx->cs, ctx->data, len) !=
+			    checksum_bitwise(&ctx->cs, ctx->data, len)) {
+				break;
+			}
+		}
+		if (len <= 64) {
+			bench_fail("checksum.%s: result mismatch with bitwise at length %zu, skipped\n",
+			           ctx->cs.name, len);
+			continue;
+		}
+		snprintf(name, sizeof(name), "checksum.%s.%s", ctx->cs.name, ctx->cs.impl);
+		run_bytes(name, run_checksum, ctx);
+	}
+
+	free(ctx);
+}
@@ -0,0 +1,127 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "outbuf.h"
+#include "uart_assist.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FORMAT_CHUNK 4096 /* 与接收线程单次读取的大小一致 */
+
+typedef struct {
+	char data[FORMAT_CHUNK];
+	outbuf_t out;
+} format_ctx_t;
+
+static void old_hex(void *arg)
+{
+	format_ctx_t *ctx = arg;
+
+	print_hex(ctx->data, FORMAT_CHUNK);
+}
+
+static void new_hex(void *arg)
+{
+	format_ctx_t *ctx = arg;
+
+	outbuf_hex(&ctx->out, ctx->data, FORMAT_CHUNK);
+	outbuf_flush(&ctx->out);
+}
+
+static void old_ascii(void *arg)
+{
+	format_ctx_t *ctx = arg;
+
+	print_ascii(ctx->data, FORMAT_CHUNK);
+}
+
+static void new_ascii(void *arg)
+{
+	format_ctx_t *ctx = arg;
+
+	outbuf_ascii(&ctx->out, ctx->data, FORMAT_CHUNK);
+	outbuf_flush(&ctx->out);
+}
+
+static void old_timestamp(void *arg)
+{
+	print_timestamp();
+}
+
+static void new_timestamp(void *arg)
+{
+	format_ctx_t *ctx = arg;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	outbuf_timestamp(&ctx->out, (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+}
+
+/* 以 MB/s 报告处理输入数据的速度 */
+static void run_bytes(const char *name, bench_fn_t fn, format_ctx_t *ctx)
+{
+	int64_t ns;
+	long calls;
+	int saved;
+
+	saved = bench_stdout_mute();
+	ns = bench_run(fn, ctx, &calls);
+	outbuf_flush(&ctx->out);
+	bench_stdout_restore(saved);
+
+	bench_report(name, (double)calls * FORMAT_CHUNK * 1000.0 / ns, "MB/s");
+}
+
+/* 以每秒百万次报告调用速度 */
+static void run_calls(const char *name, bench_fn_t fn, format_ctx_t *ctx)
+{
+	int64_t ns;
+	long calls;
+	int saved;
+
+	saved = bench_stdout_mute();
+	ns = bench_run(fn, ctx, &calls);
+	outbuf_flush(&ctx->out);
+	bench_stdout_restore(saved);
+
+	bench_report(name, (double)calls * 1000.0 / ns, "Mcalls/s");
+}
+
+void bench_format(void)
+{
+	format_ctx_t *ctx;
+	unsigned int seed = 1;
+	int i;
+
+	ctx = malloc(sizeof(format_ctx_t));
+	if (ctx == NULL) {
+		bench_fail("format: out of memory\n");
+		return;
+	}
+	outbuf_init(&ctx->out, stdout);
+
+	/* 大约四分之三为可打印字符，其余为控制字符和高位字节 */
+	for (i = 0; i < FORMAT_CHUNK; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 4 != 0) {
+			ctx->data[i] = (char)(32 + (seed >> 8) % 95);
+		} else {
+			ctx->data[i] = (char)(seed >> 8);
+		}
+	}
+
+	run_bytes("format.print_hex", old_hex, ctx);
+	run_bytes("format.outbuf_hex", new_hex, ctx);
+	run_bytes("format.print_ascii", old_ascii, ctx);
+	run_bytes("format.outbuf_ascii", new_ascii, ctx);
+	run_calls("format.print_timestamp", old_timestamp, ctx);
+	run_calls("format.outbuf_timestamp", new_timestamp, ctx);
+
+	free(ctx);
+}
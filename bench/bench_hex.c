@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "hex_codec.h"
+#include "uart_assist.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEX_CHUNK 4096 /* 每次处理的字节数 */
+
+typedef struct {
+	const hex_codec_t *codec;
+	uint8_t bin[HEX_CHUNK];
+	uint8_t dec[HEX_CHUNK];
+	char hex[HEX_CHUNK * 2 + 1]; /* parse_hex_string() 需要以 '\0' 结尾 */
+	char out[HEX_CHUNK * 3];
+} hex_ctx_t;
+
+static void run_decode(void *arg)
+{
+	hex_ctx_t *ctx = arg;
+	size_t err_pos;
+
+	ctx->codec->decode(ctx->hex, HEX_CHUNK * 2, ctx->dec, &err_pos);
+}
+
+/* send 模式 -f hex 的入口：strlen()、长度检查加上自动选择的实现 */
+static void run_parse(void *arg)
+{
+	hex_ctx_t *ctx = arg;
+
+	parse_hex_string(ctx->hex, (char *)ctx->dec, HEX_CHUNK);
+}
+
+static void run_encode(void *arg)
+{
+	hex_ctx_t *ctx = arg;
+
+	ctx->codec->encode(ctx->bin, HEX_CHUNK, ctx->hex);
+}
+
+static void run_encode_spaced(void *arg)
+{
+	hex_ctx_t *ctx = arg;
+
+	ctx->codec->encode_spaced(ctx->bin, HEX_CHUNK, ctx->out);
+}
+
+/* 以 MB/s 报告处理二进制数据的速度 */
+static void run_bytes(const char *op, bench_fn_t fn, hex_ctx_t *ctx)
+{
+	char name[64];
+	int64_t ns;
+	long calls;
+
+	ns = bench_run(fn, ctx, &calls);
+	snprintf(name, sizeof(name), "hex.%s.%s", op, ctx->codec->name);
+	bench_report(name, (double)calls * HEX_CHUNK * 1000.0 / ns, "MB/s");
+}
+
+/* 检查各实现的结果与标量实现完全一致，包括非法字符的位置 */
+static int check_codec(const hex_codec_t *codec, const hex_codec_t *ref, hex_ctx_t *ctx)
+{
+	static char want[HEX_CHUNK * 3];
+	size_t err_pos, want_pos, len;
+
+	ref->encode_spaced(ctx->bin, HEX_CHUNK, want);
+	codec->encode_spaced(ctx->bin, HEX_CHUNK, ctx->out);
+	if (memcmp(want, ctx->out, HEX_CHUNK * 3) != 0) {
+		return -1;
+	}
+
+	ref->encode(ctx->bin, HEX_CHUNK, want);
+	codec->encode(ctx->bin, HEX_CHUNK, ctx->hex);
+	if (memcmp(want, ctx->hex, HEX_CHUNK * 2) != 0) {
+		return -1;
+	}
+
+	/* 小写输入 */
+	for (len = 0; len < HEX_CHUNK * 2; len++) {
+		ctx->hex[len] = (char)tolower((unsigned char)ctx->hex[len]);
+	}
+	if (codec->decode(ctx->hex, HEX_CHUNK * 2, ctx->dec, &err_pos) != 0 ||
+	    memcmp(ctx->bin, ctx->dec, HEX_CHUNK) != 0) {
+		return -1;
+	}
+
+	/* 在每个可能的位置放一个非法字符，长度覆盖 SIMD 块的边界 */
+	for (len = 2; len <= 96; len += 2) {
+		size_t bad;
+
+		for (bad = 0; bad < len; bad++) {
+			char saved = ctx->hex[bad];
+
+			ctx->hex[bad] = (bad & 1) ? 'g' : '/';
+			if (ref->decode(ctx->hex, len, ctx->dec, &want_pos) != -1 ||
+			    codec->decode(ctx->hex, len, ctx->dec, &err_pos) != -1 ||
+			    err_pos != want_pos) {
+				ctx->hex[bad] = saved;
+				return -1;
+			}
+			ctx->hex[bad] = saved;
+		}
+	}
+
+	codec->encode(ctx->bin, HEX_CHUNK, ctx->hex);
+
+	return 0;
+}
+
+void bench_hex(void)
+{
+	const hex_codec_t *const *list;
+	hex_ctx_t *ctx;
+	unsigned int seed = 1;
+	int i, count;
+	int64_t ns;
+	long calls;
+
+	ctx = malloc(sizeof(hex_ctx_t));
+	if (ctx == NULL) {
+		bench_fail("hex: out of memory\n");
+		return;
+	}
+
+	for (i = 0; i < HEX_CHUNK; i++) {
+		seed = seed * 1103515245 + 12345;
+		ctx->bin[i] = (uint8_t)(seed >> 16);
+	}
+
+	count = hex_codec_list(&list);
+	for (i = 0; i < count; i++) {
+		ctx->codec = list[i];
+		if (check_codec(list[i], list[count - 1], ctx) < 0) {
+			bench_fail("hex.%s: result mismatch with scalar, skipped\n", list[i]->name);
+			continue;
+		}
+
+		run_bytes("decode", run_decode, ctx);
+		run_bytes("encode", run_encode, ctx);
+		run_bytes("encode_spaced", run_encode_spaced, ctx);
+	}
+
+	hex_encode(ctx->bin, HEX_CHUNK, ctx->hex);
+	ctx->hex[HEX_CHUNK * 2] = '\0';
+	ns = bench_run(run_parse, ctx, &calls);
+	bench_report("hex.parse_hex_string", (double)calls * HEX_CHUNK * 1000.0 / ns, "MB/s");
+
+	free(ctx);
+}
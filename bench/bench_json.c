@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "json_config.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define JSON_ITEM_BYTES 16 /* 每项 HexData 的字节数 */
+
+typedef struct {
+	const char *path;
+	int items;
+	int failed;
+} json_ctx_t;
+
+/* 生成 items 项的配置文件，Delay 和 DelayUs 交替出现，每 4 项带一个响应 */
+static int write_config(const char *path, int items)
+{
+	FILE *fp;
+	int i, j;
+
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		return -1;
+	}
+
+	fprintf(fp, "{\n  \"GroupName\": \"bench\",\n  \"CycleCount\": 1,\n  \"SendList\": [\n");
+	for (i = 0; i < items; i++) {
+		fprintf(fp, "    {\"Number\": %d, \"HexData\": \"", i + 1);
+		for (j = 0; j < JSON_ITEM_BYTES; j++) {
+			fprintf(fp, "%02x", (i * 31 + j) & 0xff);
+		}
+		fprintf(fp, "\", ");
+		if (i % 2 == 0) {
+			fprintf(fp, "\"Delay\": 10, ");
+		} else {
+			fprintf(fp, "\"DelayUs\": 500, ");
+		}
+		if (i % 4 == 0) {
+			fprintf(fp, "\"ExpectHex\": \"%02x0300\", \"Timeout\": 100, ", i & 0xff);
+		}
+		fprintf(fp, "\"Enable\": 1}%s\n", i + 1 < items ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+
+	if (fclose(fp) != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+/* file 模式启动时的完整流程：解析、校验并解码到 arena、释放 */
+static void run_load(void *arg)
+{
+	json_ctx_t *ctx = arg;
+	json_config_t *config;
+
+	config = parse_json_file(ctx->path);
+	if (config == NULL || validate_json_config(config) < 0 ||
+	    config->record_count != ctx->items) {
+		ctx->failed = 1;
+	}
+	free_json_config(config);
+}
+
+void bench_json(void)
+{
+	static const int sizes[] = {1000, 100000};
+	char path[] = "/tmp/uart_bench_XXXXXX";
+	char name[64];
+	json_ctx_t ctx;
+	int64_t ns;
+	long calls;
+	int saved;
+	int fd, i;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		bench_fail("json: mkstemp() failed: %s\n", strerror(errno));
+		return;
+	}
+	close(fd);
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		if (write_config(path, sizes[i]) < 0) {
+			bench_fail("json: failed to write %s: %s\n", path, strerror(errno));
+			break;
+		}
+
+		ctx.path = path;
+		ctx.items = sizes[i];
+		ctx.failed = 0;
+
+		/* 校验失败时会打印错误，测量期间屏蔽输出，之后再报告 */
+		saved = bench_stdout_mute();
+		ns = bench_run(run_load, &ctx, &calls);
+		bench_stdout_restore(saved);
+
+		if (ctx.failed) {
+			bench_fail("json.load.%d: failed to load generated config, skipped\n",
+			           sizes[i]);
+			continue;
+		}
+		snprintf(name, sizeof(name), "json.load.%d", sizes[i]);
+		bench_report(name, (double)ns / calls / NSEC_PER_MSEC, "ms");
+	}
+
+	unlink(path);
+}
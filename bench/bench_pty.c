@@ -0,0 +1,269 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "histogram.h"
+#include "uart_assist.h"
+#include "uartdev.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define PTY_CHUNK 4096        /* 与接收线程单次读取的大小一致 */
+#define PTY_RTT_LEN 16        /* 往返测试每次的字节数，一个短 Modbus 报文的量级 */
+#define PTY_RTT_WARMUP 100
+#define PTY_RTT_COUNT 5000
+#define PTY_POLL_MS 100       /* 对端线程检查退出标志的间隔 */
+
+/*
+ * 一对 pty：被测的一端用 uartdev 打开从设备，与测试串口的路径相同；
+ * 对端线程直接读写主设备
+ */
+typedef struct {
+	int master;
+	int slave;    /* 保持打开，被测端关闭时不会挂断 */
+	uartdev_t *dev;
+	pthread_t tid;
+	volatile int stop;
+	char buf[PTY_CHUNK];
+} pty_ctx_t;
+
+static int pty_open(pty_ctx_t *ctx)
+{
+	char name[64];
+	int flags;
+
+	memset(ctx, 0, sizeof(*ctx));
+	if (openpty(&ctx->master, &ctx->slave, name, NULL, NULL) < 0) {
+		bench_fail("pty: openpty() failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* 对端线程用 poll 等待，以便及时响应退出标志 */
+	flags = fcntl(ctx->master, F_GETFL);
+	fcntl(ctx->master, F_SETFL, flags | O_NONBLOCK);
+
+	ctx->dev = uartdev_new(name, 115200, 8, 'N', 1);
+	if (ctx->dev == NULL || uartdev_setup(ctx->dev) < 0) {
+		bench_fail("pty: failed to set up %s: %s\n", name, strerror(errno));
+		uartdev_del(ctx->dev);
+		close(ctx->master);
+		close(ctx->slave);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void pty_close(pty_ctx_t *ctx)
+{
+	uartdev_del(ctx->dev);
+	close(ctx->master);
+	close(ctx->slave);
+}
+
+static int pty_start(pty_ctx_t *ctx, void *(*fn)(void *))
+{
+	ctx->stop = 0;
+	if (pthread_create(&ctx->tid, NULL, fn, ctx) != 0) {
+		bench_fail("pty: failed to create peer thread\n");
+		return -1;
+	}
+	return 0;
+}
+
+static void pty_stop(pty_ctx_t *ctx)
+{
+	ctx->stop = 1;
+	pthread_join(ctx->tid, NULL);
+	/* 丢弃残留数据，不影响下一项测试 */
+	tcflush(ctx->slave, TCIOFLUSH);
+	tcflush(ctx->master, TCIOFLUSH);
+}
+
+/* 等待主设备可读或可写，超时或出错返回 0 */
+static int pty_wait(int fd, short events)
+{
+	struct pollfd pfd = {.fd = fd, .events = events};
+
+	return poll(&pfd, 1, PTY_POLL_MS) > 0;
+}
+
+/* 对端：尽快读走数据 */
+static void *drain_thread(void *arg)
+{
+	pty_ctx_t *ctx = arg;
+	char buf[PTY_CHUNK];
+
+	while (!ctx->stop) {
+		if (pty_wait(ctx->master, POLLIN)) {
+			while (read(ctx->master, buf, sizeof(buf)) > 0) {
+			}
+		}
+	}
+	return NULL;
+}
+
+/* 对端：持续写入数据 */
+static void *feed_thread(void *arg)
+{
+	pty_ctx_t *ctx = arg;
+	char buf[PTY_CHUNK];
+
+	memset(buf, 0x55, sizeof(buf));
+	while (!ctx->stop) {
+		if (pty_wait(ctx->master, POLLOUT)) {
+			while (!ctx->stop && write(ctx->master, buf, sizeof(buf)) > 0) {
+			}
+		}
+	}
+	return NULL;
+}
+
+/* 对端：收到的数据原样发回 */
+static void *echo_thread(void *arg)
+{
+	pty_ctx_t *ctx = arg;
+	char buf[PTY_CHUNK];
+	ssize_t n;
+
+	while (!ctx->stop) {
+		if (!pty_wait(ctx->master, POLLIN)) {
+			continue;
+		}
+		n = read(ctx->master, buf, sizeof(buf));
+		if (n > 0 && write(ctx->master, buf, n) != n) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+/* send 模式的写入路径：uartdev_send_all()，写满时等待 */
+static void bench_pty_send(pty_ctx_t *ctx)
+{
+	int64_t start, ns;
+	long long bytes = 0;
+
+	if (pty_start(ctx, drain_thread) < 0) {
+		return;
+	}
+
+	memset(ctx->buf, 0xaa, sizeof(ctx->buf));
+	start = timing_now_ns();
+	do {
+		if (uartdev_send_all(ctx->dev, ctx->buf, PTY_CHUNK, NULL) < 0) {
+			bench_fail("pty: uartdev_send_all() failed: %s\n", strerror(errno));
+			break;
+		}
+		bytes += PTY_CHUNK;
+	} while (timing_now_ns() - start < BENCH_MIN_NS);
+	ns = timing_now_ns() - start;
+
+	pty_stop(ctx);
+	bench_report("pty.send", (double)bytes * 1000.0 / ns, "MB/s");
+}
+
+/* loopback 模式的接收路径：uart_recv_with_timeout()，poll() 加 read() */
+static void bench_pty_recv(pty_ctx_t *ctx)
+{
+	int64_t start, ns;
+	long long bytes = 0;
+	int n;
+
+	if (pty_start(ctx, feed_thread) < 0) {
+		return;
+	}
+
+	start = timing_now_ns();
+	do {
+		n = uart_recv_with_timeout(ctx->dev, ctx->buf, PTY_CHUNK, 1);
+		if (n < 0) {
+			break;
+		}
+		bytes += n;
+	} while (timing_now_ns() - start < BENCH_MIN_NS);
+	ns = timing_now_ns() - start;
+
+	pty_stop(ctx);
+	bench_report("pty.recv", (double)bytes * 1000.0 / ns, "MB/s");
+}
+
+/* 发送 PTY_RTT_LEN 字节，等对端原样发回，统计往返时间 */
+static void bench_pty_rtt(pty_ctx_t *ctx)
+{
+	histogram_t *hist;
+	int64_t start;
+	int i, got, n;
+
+	hist = malloc(sizeof(histogram_t));
+	if (hist == NULL) {
+		bench_fail("pty.rtt: out of memory\n");
+		return;
+	}
+	hist_init(hist);
+	if (pty_start(ctx, echo_thread) < 0) {
+		free(hist);
+		return;
+	}
+
+	memset(ctx->buf, 0x5a, PTY_RTT_LEN);
+	for (i = 0; i < PTY_RTT_WARMUP + PTY_RTT_COUNT; i++) {
+		start = timing_now_ns();
+		if (uartdev_send_all(ctx->dev, ctx->buf, PTY_RTT_LEN, NULL) < 0) {
+			bench_fail("pty: uartdev_send_all() failed: %s\n", strerror(errno));
+			break;
+		}
+		for (got = 0; got < PTY_RTT_LEN; got += n) {
+			n = uart_recv_with_timeout(ctx->dev, ctx->buf + got, PTY_RTT_LEN - got, 1);
+			if (n <= 0) {
+				bench_fail("pty.rtt: no echo within 1 s, aborted\n");
+				pty_stop(ctx);
+				free(hist);
+				return;
+			}
+		}
+		if (i >= PTY_RTT_WARMUP) {
+			hist_add(hist, timing_now_ns() - start);
+		}
+	}
+
+	pty_stop(ctx);
+	bench_report("pty.rtt.p50", hist_percentile(hist, 50) / 1000.0, "us");
+	bench_report("pty.rtt.p99", hist_percentile(hist, 99) / 1000.0, "us");
+	free(hist);
+}
+
+void bench_pty(void)
+{
+	pty_ctx_t *ctx;
+
+	ctx = malloc(sizeof(pty_ctx_t));
+	if (ctx == NULL) {
+		bench_fail("pty: out of memory\n");
+		return;
+	}
+	if (pty_open(ctx) < 0) {
+		free(ctx);
+		return;
+	}
+
+	bench_pty_send(ctx);
+	bench_pty_recv(ctx);
+	bench_pty_rtt(ctx);
+
+	pty_close(ctx);
+	free(ctx);
+}
@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "trigger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIGGER_CHUNK 4096 /* 每次扫描的字节数，与接收线程单次读取相同 */
+#define TRIGGER_CHECK_CHUNKS 16
+
+typedef struct {
+	char data[TRIGGER_CHUNK * TRIGGER_CHECK_CHUNKS];
+	trigger_t trig;
+} trigger_ctx_t;
+
+/* 典型的日志关键字，前 n 个参与测试 */
+static char *const patterns[] = {
+    "ERROR",    "panic",       "Oops",     "WARN",     "timeout",   "fail",     "reset",
+    "hex:0d0a", "watchdog",    "assert",   "overflow", "underrun",  "segfault", "abort",
+    "fatal",    "Call Trace:", "BUG:",     "retry",    "crc error", "no ack",   "busy",
+    "denied",   "invalid",     "lost",     "unknown",  "halt",      "exception", "trap",
+    "nak",      "stall",       "brownout", "hard fault",
+};
+
+static void run_scan(void *arg)
+{
+	trigger_ctx_t *ctx = arg;
+
+	trigger_push(&ctx->trig, ctx->data, TRIGGER_CHUNK, 0);
+}
+
+/* 在每个位置逐个比较模式（含重叠），作为参考实现 */
+static long count_naive(trigger_ctx_t *ctx, size_t len)
+{
+	const trigger_pattern_t *p;
+	long n = 0;
+	size_t pos;
+	int i;
+
+	for (i = 0; i < ctx->trig.pattern_count; i++) {
+		p = &ctx->trig.patterns[i];
+		for (pos = 0; pos + p->len <= len; pos++) {
+			n += memcmp(ctx->data + pos, p->data, p->len) == 0;
+		}
+	}
+	return n;
+}
+
+void bench_trigger(void)
+{
+	static const int counts[] = {1, 8, 32};
+	trigger_ctx_t *ctx;
+	unsigned int seed = 1;
+	char name[64];
+	int64_t ns;
+	long calls, naive;
+	size_t i, pos;
+	int c, k, saved;
+
+	ctx = malloc(sizeof(trigger_ctx_t));
+	if (ctx == NULL) {
+		bench_fail("trigger: out of memory\n");
+		return;
+	}
+
+	/* 可打印字符组成的随机文本，中间插入一些关键字 */
+	for (i = 0; i < sizeof(ctx->data); i++) {
+		seed = seed * 1103515245 + 12345;
+		ctx->data[i] = 32 + (seed >> 16) % 95;
+	}
+	for (pos = 100, k = 0; pos + 16 < sizeof(ctx->data); pos += 997, k++) {
+		memcpy(ctx->data + pos, patterns[k % 7], strlen(patterns[k % 7]));
+	}
+	memcpy(ctx->data + TRIGGER_CHUNK - 2, "ERROR", 5);
+
+	for (c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++) {
+		if (trigger_setup(&ctx->trig, NULL, patterns, counts[c], NULL, 0) < 0) {
+			bench_fail("trigger.aho-corasick.%d: failed to set up trigger\n", counts[c]);
+			break;
+		}
+
+		/* 按块输入整段数据，匹配数与逐个模式查找相同，跨块的匹配也不遗漏 */
+		naive = count_naive(ctx, sizeof(ctx->data));
+		saved = bench_stdout_mute();
+		for (k = 0; k < TRIGGER_CHECK_CHUNKS; k++) {
+			trigger_push(&ctx->trig, ctx->data + k * TRIGGER_CHUNK, TRIGGER_CHUNK, 0);
+		}
+		bench_stdout_restore(saved);
+		if (ctx->trig.matches != naive) {
+			bench_fail("trigger.aho-corasick.%d: %ld matches, expected %ld, skipped\n",
+			           counts[c], ctx->trig.matches, naive);
+			trigger_free(&ctx->trig);
+			continue;
+		}
+
+		saved = bench_stdout_mute();
+		ns = bench_run(run_scan, ctx, &calls);
+		bench_stdout_restore(saved);
+		snprintf(name, sizeof(name), "trigger.aho-corasick.%d", counts[c]);
+		bench_report(name, (double)calls * TRIGGER_CHUNK * 1000.0 / ns, "MB/s");
+		trigger_free(&ctx->trig);
+	}
+
+	free(ctx);
+}
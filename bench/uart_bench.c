@@ -0,0 +1,420 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "bench.h"
+#include "cJSON.h"
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_MAX_RESULTS 256
+#define BENCH_NAME_LEN 64
+#define BENCH_UNIT_LEN 16
+#define BENCH_DEFAULT_TOLERANCE 20.0 /* 默认允许的退化百分比 */
+
+/* 被测模块引用的全局标志 */
+volatile int g_running = 1;
+int g_quiet = 0;
+
+typedef struct {
+	const char *name;
+	void (*run)(void);
+} bench_suite_t;
+
+typedef struct {
+	char name[BENCH_NAME_LEN];
+	double value;
+	char unit[BENCH_UNIT_LEN];
+} bench_result_t;
+
+static const bench_suite_t suites[] = {
+    {"format", bench_format},
+    {"hex", bench_hex},
+    {"crc", bench_crc},
+    {"trigger", bench_trigger},
+    {"json", bench_json},
+    {"pty", bench_pty},
+};
+
+#define SUITE_COUNT ((int)(sizeof(suites) / sizeof(suites[0])))
+
+/* 本次运行的结果，用于 --json 输出和与基线比较 */
+static bench_result_t results[BENCH_MAX_RESULTS];
+static int result_count;
+static int fail_count; /* bench_fail() 的调用次数 */
+
+enum {
+	OPT_JSON = 256,
+	OPT_BASELINE,
+	OPT_TOLERANCE,
+	OPT_REPEAT,
+};
+
+static const struct option long_options[] = {{"json", required_argument, 0, OPT_JSON},
+                                             {"baseline", required_argument, 0, OPT_BASELINE},
+                                             {"tolerance", required_argument, 0, OPT_TOLERANCE},
+                                             {"repeat", required_argument, 0, OPT_REPEAT},
+                                             {"help", no_argument, 0, 'h'},
+                                             {0, 0, 0, 0}};
+
+int64_t bench_run(bench_fn_t fn, void *ctx, long *calls)
+{
+	int64_t start = timing_now_ns();
+	int64_t elapsed;
+	long n = 0;
+	int i;
+
+	do {
+		/* 每次批量调用，减少读时钟的开销 */
+		for (i = 0; i < 16; i++) {
+			fn(ctx);
+		}
+		n += 16;
+		elapsed = timing_now_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+
+	*calls = n;
+	return elapsed;
+}
+
+int bench_stdout_mute(void)
+{
+	int saved, fd;
+
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	fd = open("/dev/null", O_WRONLY);
+	if (saved < 0 || fd < 0) {
+		perror("bench_stdout_mute");
+		exit(EXIT_FAILURE);
+	}
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+
+	return saved;
+}
+
+void bench_stdout_restore(int saved_fd)
+{
+	fflush(stdout);
+	dup2(saved_fd, STDOUT_FILENO);
+	close(saved_fd);
+}
+
+/* 时间单位的结果越小越好，其他（速率）越大越好 */
+static int lower_is_better(const char *unit)
+{
+	return strcmp(unit, "ns") == 0 || strcmp(unit, "us") == 0 || strcmp(unit, "ms") == 0;
+}
+
+void bench_report(const char *name, double value, const char *unit)
+{
+	bench_result_t *r;
+	int i;
+
+	printf("%-40s %14.2f %s\n", name, value, unit);
+	fflush(stdout);
+
+	/* --repeat 时同一项保留最好的一次，减少其他负载造成的波动 */
+	for (i = 0; i < result_count; i++) {
+		r = &results[i];
+		if (strcmp(r->name, name) == 0) {
+			if (lower_is_better(unit) ? value < r->value : value > r->value) {
+				r->value = value;
+			}
+			return;
+		}
+	}
+
+	if (result_count < BENCH_MAX_RESULTS) {
+		r = &results[result_count++];
+		snprintf(r->name, sizeof(r->name), "%s", name);
+		r->value = value;
+		snprintf(r->unit, sizeof(r->unit), "%s", unit);
+	}
+}
+
+void bench_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	fflush(stdout);
+	fail_count++;
+}
+
+/* 把结果写成 JSON，同一格式也用作基线文件 */
+static int write_json(const char *path)
+{
+	cJSON *root, *list, *item;
+	char *text;
+	FILE *fp;
+	int i, ret = 0;
+
+	root = cJSON_CreateObject();
+	list = cJSON_AddArrayToObject(root, "results");
+	for (i = 0; i < result_count; i++) {
+		item = cJSON_CreateObject();
+		cJSON_AddStringToObject(item, "name", results[i].name);
+		cJSON_AddNumberToObject(item, "value", results[i].value);
+		cJSON_AddStringToObject(item, "unit", results[i].unit);
+		cJSON_AddStringToObject(item, "better",
+		                        lower_is_better(results[i].unit) ? "lower" : "higher");
+		cJSON_AddItemToArray(list, item);
+	}
+
+	text = cJSON_Print(root);
+	cJSON_Delete(root);
+	if (text == NULL) {
+		return -1;
+	}
+
+	fp = fopen(path, "w");
+	if (fp == NULL || fprintf(fp, "%s\n", text) < 0) {
+		ret = -1;
+	}
+	if (fp != NULL && fclose(fp) != 0) {
+		ret = -1;
+	}
+	free(text);
+	if (ret < 0) {
+		perror(path);
+	}
+
+	return ret;
+}
+
+static cJSON *read_json(const char *path)
+{
+	cJSON *root;
+	char *text;
+	FILE *fp;
+	long len;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		perror(path);
+		return NULL;
+	}
+	if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+		perror(path);
+		fclose(fp);
+		return NULL;
+	}
+
+	text = malloc(len + 1);
+	if (text == NULL || fread(text, 1, len, fp) != (size_t)len) {
+		perror(path);
+		free(text);
+		fclose(fp);
+		return NULL;
+	}
+	text[len] = '\0';
+	fclose(fp);
+
+	root = cJSON_Parse(text);
+	free(text);
+	if (root == NULL) {
+		fprintf(stderr, "%s: invalid JSON\n", path);
+	}
+
+	return root;
+}
+
+/* 本次运行中名为 name 的结果，没有时返回 NULL */
+static const bench_result_t *find_result(const char *name)
+{
+	int i;
+
+	for (i = 0; i < result_count; i++) {
+		if (strcmp(results[i].name, name) == 0) {
+			return &results[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * 与基线比较本次运行的结果，基线中没有的项跳过。
+ * 运行全部测试组时，基线中有而本次没有产生的项算作失败（测试组中途退出）；
+ * 只运行部分测试组时这些项跳过
+ * 返回: 退化超过 tolerance 百分比和缺少的项数, -1 基线文件无法读取
+ */
+static int compare_baseline(const char *path, double tolerance, int all_suites)
+{
+	const cJSON *root, *list, *item, *name, *value;
+	const bench_result_t *r;
+	double base, change;
+	int i, worse, regressed = 0;
+
+	root = read_json(path);
+	if (root == NULL) {
+		return -1;
+	}
+	list = cJSON_GetObjectItemCaseSensitive(root, "results");
+
+	printf("\nBaseline %s (tolerance %.0f%%):\n", path, tolerance);
+	printf("%-40s %14s %14s %8s\n", "name", "baseline", "current", "change");
+	for (i = 0; i < result_count; i++) {
+		r = &results[i];
+		value = NULL;
+		cJSON_ArrayForEach(item, list)
+		{
+			name = cJSON_GetObjectItemCaseSensitive(item, "name");
+			if (cJSON_IsString(name) && strcmp(name->valuestring, r->name) == 0) {
+				value = cJSON_GetObjectItemCaseSensitive(item, "value");
+				break;
+			}
+		}
+		if (!cJSON_IsNumber(value) || value->valuedouble <= 0) {
+			printf("%-40s %14s %14.2f %8s\n", r->name, "-", r->value, "new");
+			continue;
+		}
+
+		base = value->valuedouble;
+		change = (r->value - base) * 100.0 / base;
+		worse = lower_is_better(r->unit) ? change > tolerance : -change > tolerance;
+		regressed += worse;
+		printf("%-40s %14.2f %14.2f %+7.1f%%%s\n", r->name, base, r->value, change,
+		       worse ? "  REGRESSED" : "");
+	}
+
+	cJSON_ArrayForEach(item, list)
+	{
+		name = cJSON_GetObjectItemCaseSensitive(item, "name");
+		if (!all_suites || !cJSON_IsString(name) || find_result(name->valuestring) != NULL) {
+			continue;
+		}
+		value = cJSON_GetObjectItemCaseSensitive(item, "value");
+		printf("%-40s %14.2f %14s %8s  MISSING\n", name->valuestring,
+		       cJSON_IsNumber(value) ? value->valuedouble : 0.0, "-", "");
+		regressed++;
+	}
+
+	cJSON_Delete((cJSON *)root);
+	return regressed;
+}
+
+static void print_usage(const char *program_name)
+{
+	int i;
+
+	printf("Usage: %s [options] [suite...]\n", program_name);
+	printf("Suites:");
+	for (i = 0; i < SUITE_COUNT; i++) {
+		printf(" %s", suites[i].name);
+	}
+	printf("\n");
+	printf("Options:\n");
+	printf("  --json <file>       Write results as JSON (also the baseline format)\n");
+	printf("  --baseline <file>   Compare with a saved --json file, exit 1 on regression\n");
+	printf("  --tolerance <pct>   Allowed regression in percent (default: %.0f)\n",
+	       BENCH_DEFAULT_TOLERANCE);
+	printf("  --repeat <n>        Run the suites n times and keep the best result of each "
+	       "item\n");
+	printf("  -h, --help          Show this help message\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *json_file = NULL;
+	const char *baseline_file = NULL;
+	double tolerance = BENCH_DEFAULT_TOLERANCE;
+	char *endptr;
+	int i, j, opt, found;
+	int repeat = 1, run;
+	int regressed;
+
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case OPT_JSON:
+			json_file = optarg;
+			break;
+		case OPT_BASELINE:
+			baseline_file = optarg;
+			break;
+		case OPT_TOLERANCE:
+			tolerance = strtod(optarg, &endptr);
+			if (*endptr != '\0' || tolerance < 0) {
+				fprintf(stderr, "Invalid tolerance: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case OPT_REPEAT:
+			repeat = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' || repeat < 1) {
+				fprintf(stderr, "Invalid repeat count: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	/* 先检查测试组名，避免运行一半才报错 */
+	for (j = optind; j < argc; j++) {
+		found = 0;
+		for (i = 0; i < SUITE_COUNT; i++) {
+			found |= strcmp(argv[j], suites[i].name) == 0;
+		}
+		if (!found) {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* 不指定测试组时运行全部测试组 */
+	for (run = 1; run <= repeat; run++) {
+		if (repeat > 1) {
+			printf("Run %d/%d\n", run, repeat);
+		}
+		for (i = 0; i < SUITE_COUNT; i++) {
+			found = optind == argc;
+			for (j = optind; j < argc; j++) {
+				found |= strcmp(argv[j], suites[i].name) == 0;
+			}
+			if (found) {
+				suites[i].run();
+			}
+		}
+	}
+
+	if (json_file != NULL && write_json(json_file) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	if (baseline_file != NULL) {
+		regressed = compare_baseline(baseline_file, tolerance, optind == argc);
+		if (regressed < 0) {
+			return EXIT_FAILURE;
+		}
+		if (regressed > 0) {
+			printf("%d result(s) regressed more than %.0f%% or missing\n", regressed,
+			       tolerance);
+			return EXIT_FAILURE;
+		}
+		if (fail_count == 0) {
+			printf("No regression\n");
+		}
+	}
+
+	if (fail_count > 0) {
+		printf("%d benchmark(s) failed\n", fail_count);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -35,6 +35,12 @@ case ${1} in
 		cmake --build ${BUILD_DIR}
 		cmake --install ${BUILD_DIR} --prefix ${RELEASE_DIR}
 		;;
+	trace)
+		rm -vrf ${BUILD_DIR}
+		cmake -S . -B ${BUILD_DIR} -D CMAKE_C_COMPILER=${CC} -D CMAKE_CXX_COMPILER=${CXX} -D CMAKE_BUILD_TYPE=Release -D ENABLE_TRACE=ON
+		cmake --build ${BUILD_DIR}
+		cmake --install ${BUILD_DIR} --prefix ${RELEASE_DIR}
+		;;
 	*)
 		rm -vrf ${BUILD_DIR}
 		cmake -S . -B ${BUILD_DIR} -D CMAKE_C_COMPILER=${CC} -D CMAKE_CXX_COMPILER=${CXX}
@@ -9,13 +9,21 @@ Free Software Foundation.
 #ifndef __ARGS_PARSER_H__
 #define __ARGS_PARSER_H__
 
+#include "metrics.h"
 #include <stdint.h>
 
 typedef enum {
 	MODE_LOOPBACK, /* 自测模式 */
 	MODE_SEND,     /* 发送模式 */
 	MODE_RECV,     /* 接收模式 */
-	MODE_FILE      /* 文件模式 */
+	MODE_FILE,     /* 文件模式 */
+	MODE_BENCH,    /* 吞吐量测试模式 */
+	MODE_PRBS,     /* PRBS 误码率测试模式 */
+	MODE_REPLAY,   /* 抓包回放模式 */
+	MODE_PING,     /* 往返延迟测试模式 */
+	MODE_MODBUS,   /* Modbus RTU 主站轮询模式 */
+	MODE_BRIDGE,   /* 串口桥接模式 */
+	MODE_SERVER    /* TCP 服务器模式 */
 } test_mode_t;
 
 typedef enum {
@@ -24,7 +32,9 @@ typedef enum {
 } output_format_t;
 
 typedef struct {
-	char *device;           /* 串口设备名 */
+	char *device;           /* 串口设备名（指向 devices[0]） */
+	char **devices;         /* 串口设备列表（多端口） */
+	int device_count;       /* 串口设备个数 */
 	int baud;               /* 波特率 */
 	int data_bit;           /* 数据位 */
 	char parity;            /* 校验位 */
@@ -34,7 +44,30 @@ typedef struct {
 	int send_interval;      /* 发送间隔（毫秒） */
 	int send_count;         /* 发送次数（0=无限） */
 	output_format_t format; /* 接收打印格式 */
-	char *json_file;        /* JSON配置文件（file模式） */
+	char *json_file;        /* JSON配置文件（file模式）或抓包文件（replay模式） */
+	int duration;           /* 测试持续时间（秒），0=直到 Ctrl+C */
+	int prbs_order;         /* PRBS 阶数 7/15/23/31 */
+	int spin_us;            /* file 模式延时最后忙等的微秒数 */
+	char *capture_file;     /* recv/bridge 模式抓包文件，NULL 表示不抓包 */
+	double speed;           /* replay 模式时间缩放系数，0 表示最快速度 */
+	char *send_file;        /* send 模式要发送的文件，NULL 表示发送 send_string */
+	int low_latency;        /* 是否设置 ASYNC_LOW_LATENCY */
+	int latency_timer;      /* USB 串口 latency_timer（毫秒），0 表示不修改 */
+	int timeout_ms;         /* ping 模式等待回显的超时时间（毫秒） */
+	char *frame_spec;       /* recv 模式分帧规则，NULL 表示不分帧 */
+	char *checksum_spec;    /* 校验算法，NULL 表示不追加/不检查 */
+	char **triggers;        /* recv 模式触发模式列表（--trigger） */
+	int trigger_count;
+	char **actions;         /* 匹配时的动作列表（--on-match） */
+	int action_count;
+	char *peer;             /* bridge 模式的另一端：串口设备或 pty[:链接] */
+	int tap;                /* bridge 模式是否打印转发的数据 */
+	char *listen;           /* server 模式监听地址 "[addr:]port" */
+	int quiet;              /* 不打印逐包输出 */
+	char *metrics_file;     /* 指标导出文件，NULL 表示不导出 */
+	metrics_format_t metrics_format;
+	int metrics_interval;   /* 指标导出间隔（秒） */
+	char *trace_file;       /* 跟踪输出文件，NULL 表示不跟踪 */
 } uart_config_t;
 
 /*
@@ -0,0 +1,30 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __BRIDGE_H__
+#define __BRIDGE_H__
+
+#include "args_parser.h"
+#include "uartdev.h"
+
+#define BRIDGE_BUF_SIZE 65536   /* 每个方向的管道或拷贝缓冲区大小 */
+#define BRIDGE_MAX_EVENTS 4     /* epoll_wait 单次返回的最大事件数 */
+#define BRIDGE_PEER_PTY "pty"   /* --peer 取该值时创建新的伪终端 */
+
+/*
+ * 桥接模式：把串口和另一端（另一个串口，或新建的伪终端供旧程序打开）双向连接。
+ * 两个方向在同一个 epoll 循环中转发：优先用 splice() 经管道在内核中搬运，
+ * 驱动不支持时退回到大缓冲区的 read()/write()；目的端写不进时暂停读取源端，
+ * 由内核缓冲区反压。打开 --tap 或 --capture 时使用拷贝方式，同时打印或抓包一份数据。
+ * 参数: dev - 已打开的串口设备
+ *       config - 命令行配置，使用 peer、tap、capture_file、format 和串口参数
+ * 返回: 0 成功, -1 失败
+ */
+int uart_bridge_test(uartdev_t *dev, const uart_config_t *config);
+
+#endif /* __BRIDGE_H__ */
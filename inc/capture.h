@@ -0,0 +1,127 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include "uartdev.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 二进制抓包文件格式，所有整数均为小端：
+ *
+ * 文件头（CAPTURE_HEADER_SIZE 字节）:
+ *   0   char[8]  magic "UARTCAP\0"
+ *   8   u16      version (CAPTURE_VERSION)
+ *   10  u16      header_size
+ *   12  u32      baud
+ *   16  u8       data_bit
+ *   17  char     parity 'N'/'O'/'E'
+ *   18  u8       stop_bit
+ *   19  u8       reserved
+ *   20  u32      reserved
+ *   24  i64      start_realtime_ns  开始时的 CLOCK_REALTIME
+ *   32  i64      start_mono_ns      开始时的 CLOCK_MONOTONIC，与上一项一起把记录时间换算为墙上时间
+ *   40  char[88] port               设备名，以 '\0' 结尾
+ *
+ * 记录，紧接文件头依次存放:
+ *   0   i64      ts_ns   CLOCK_MONOTONIC 时间戳（纳秒）
+ *   8   u8       dir     CAPTURE_DIR_RX/CAPTURE_DIR_TX
+ *   9   u8[3]    reserved
+ *   12  u32      len     数据长度
+ *   16  u8[len]  data
+ */
+#define CAPTURE_MAGIC "UARTCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_SIZE 128
+#define CAPTURE_PORT_LEN 88
+#define CAPTURE_RECORD_SIZE 16 /* 记录头长度，不含数据 */
+#define CAPTURE_BUF_SIZE (1 << 20) /* 写缓冲区大小 */
+
+#define CAPTURE_DIR_RX 0 /* 从串口接收 */
+#define CAPTURE_DIR_TX 1 /* 向串口发送 */
+
+typedef struct {
+	int fd;
+	size_t len;        /* 缓冲区中待写出的字节数 */
+	uint64_t records;  /* 已写入的记录数 */
+	uint64_t bytes;    /* 已写入的数据字节数（不含记录头） */
+	int error;         /* 第一次写失败的 errno，之后不再写入 */
+	uint8_t *buf;
+} capture_t;
+
+/*
+ * 创建抓包文件并写入文件头
+ * 参数: c - 抓包上下文
+ *       path - 文件路径，已存在时覆盖
+ *       dev - 串口设备，记录端口名和参数
+ * 返回: 0 成功, -1 失败并设置 errno
+ */
+int capture_open(capture_t *c, const char *path, const uartdev_t *dev);
+
+/*
+ * 追加一条记录，数据先写入内存缓冲区，缓冲区满时才写文件
+ * 参数: ts_ns - CLOCK_MONOTONIC 时间戳
+ *       dir - CAPTURE_DIR_RX/CAPTURE_DIR_TX
+ * 返回: 0 成功, -1 写文件失败
+ */
+int capture_write(capture_t *c, int64_t ts_ns, int dir, const void *data, size_t len);
+
+/*
+ * 写出缓冲区中的数据
+ * 返回: 0 成功, -1 失败
+ */
+int capture_flush(capture_t *c);
+
+/*
+ * 写出剩余数据并关闭文件
+ * 返回: 0 成功, -1 期间有写失败
+ */
+int capture_close(capture_t *c);
+
+/* 只读方式映射的抓包文件 */
+typedef struct {
+	const uint8_t *map; /* 文件映射 */
+	size_t size;        /* 文件大小 */
+	size_t off;         /* 下一条记录的偏移 */
+	int baud;           /* 以下来自文件头 */
+	int data_bit;
+	char parity;
+	int stop_bit;
+	int64_t start_realtime_ns;
+	int64_t start_mono_ns;
+	char port[CAPTURE_PORT_LEN];
+} capture_reader_t;
+
+/* 一条记录，data 直接指向文件映射 */
+typedef struct {
+	int64_t ts_ns;
+	int dir;
+	uint32_t len;
+	const uint8_t *data;
+} capture_record_t;
+
+/*
+ * 以只读方式映射抓包文件并检查文件头
+ * 返回: 0 成功, -1 失败并设置 errno（格式错误时为 EINVAL）
+ */
+int capture_reader_open(capture_reader_t *r, const char *path);
+
+/*
+ * 读取下一条记录，不复制数据
+ * 返回: 1 读到记录, 0 文件结束, -1 记录被截断
+ */
+int capture_reader_next(capture_reader_t *r, capture_record_t *rec);
+
+/*
+ * 解除映射
+ */
+void capture_reader_close(capture_reader_t *r);
+
+#endif /* __CAPTURE_H__ */
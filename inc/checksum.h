@@ -0,0 +1,91 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __CHECKSUM_H__
+#define __CHECKSUM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHECKSUM_MAX_SIZE 4 /* 校验值最大字节数 */
+
+typedef enum {
+	CHECKSUM_CRC, /* CRC-8/16/32 */
+	CHECKSUM_SUM, /* 按字节累加，截断到 width 位 */
+	CHECKSUM_XOR  /* 按字节异或 */
+} checksum_type_t;
+
+struct checksum;
+
+/* 计算实现：在 state 上累加 data，state 为 CRC 寄存器或累加值 */
+typedef uint32_t (*checksum_update_t)(const struct checksum *c, uint32_t state,
+                                      const uint8_t *data, size_t len);
+
+/*
+ * 校验算法。CRC 使用 Rocksoft 模型参数（poly/init/refin=refout/xorout），
+ * 用 slicing-by-8 查找表计算；CPU 支持时 CRC-32C（x86 SSE4.2）和
+ * CRC-32/CRC-32C（ARMv8 CRC 扩展）使用硬件指令。
+ * 校验值在帧中的字节序：反射 CRC 低字节在前（如 Modbus），其他高字节在前。
+ */
+typedef struct checksum {
+	char name[48];          /* 用于打印，如 "crc16-modbus" */
+	checksum_type_t type;
+	int width;              /* 位数 8/16/32 */
+	uint32_t poly;          /* CRC 多项式（不反射的写法） */
+	uint32_t init;          /* CRC 初值 */
+	uint32_t xorout;        /* CRC 结果异或值 */
+	int reflect;            /* CRC 输入和输出是否反射 */
+	int little_endian;      /* 校验值是否低字节在前 */
+	const char *impl;       /* 实际使用的实现，如 "slicing-by-8" */
+	checksum_update_t update;
+	uint32_t table[8][256]; /* slicing-by-8 查找表 */
+} checksum_t;
+
+/*
+ * 根据名称或参数初始化校验算法
+ * 参数: c - 输出
+ *       spec - 预定义名称：crc8, crc8-maxim, crc16-modbus, crc16-ccitt, crc16-xmodem,
+ *              crc32, crc32c, sum8, sum16, xor8；
+ *              或自定义 CRC：crc<8|16|32>:<poly>[:<init>[:<xorout>[:r]]]，数值可用 0x 前缀，
+ *              r 表示输入输出反射，如 crc16:0x8005:0xffff:0:r 等同 crc16-modbus
+ * 返回: 0 成功, -1 失败
+ */
+int checksum_init(checksum_t *c, const char *spec);
+
+/*
+ * 返回预定义名称列表，用于帮助信息
+ */
+const char *checksum_names(void);
+
+/*
+ * 校验值的字节数
+ */
+static inline int checksum_size(const checksum_t *c)
+{
+	return c->width / 8;
+}
+
+/*
+ * 计算一段数据的校验值
+ */
+uint32_t checksum_compute(const checksum_t *c, const void *data, size_t len);
+
+/*
+ * 计算 data 的校验值并按帧中的字节序写到 out，out 至少 checksum_size() 字节
+ * 返回: 写入的字节数
+ */
+int checksum_append(const checksum_t *c, const void *data, size_t len, uint8_t *out);
+
+/*
+ * 检查以校验值结尾的帧
+ * 参数: frame, len - 整帧，最后 checksum_size() 字节为校验值
+ * 返回: 1 正确, 0 错误或帧太短
+ */
+int checksum_verify(const checksum_t *c, const void *frame, size_t len);
+
+#endif /* __CHECKSUM_H__ */
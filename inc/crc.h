@@ -0,0 +1,34 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __CRC_H__
+#define __CRC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC16_MODBUS_INIT 0xFFFF
+
+/*
+ * 累加计算 Modbus CRC16（多项式 0x8005 反射即 0xA001，初值 0xFFFF，无异或输出）。
+ * 使用 slicing-by-8 查找表，每次处理 8 字节，表在第一次调用时生成。
+ * 参数: crc - 上一段的结果，第一段传 CRC16_MODBUS_INIT
+ *       data, len - 数据
+ * 返回: 新的 CRC 值
+ */
+uint16_t crc16_modbus_update(uint16_t crc, const void *data, size_t len);
+
+/*
+ * 计算一段数据的 Modbus CRC16，帧中按低字节在前存放
+ */
+static inline uint16_t crc16_modbus(const void *data, size_t len)
+{
+	return crc16_modbus_update(CRC16_MODBUS_INIT, data, len);
+}
+
+#endif /* __CRC_H__ */
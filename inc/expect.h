@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __EXPECT_H__
+#define __EXPECT_H__
+
+#include "histogram.h"
+#include "json_config.h"
+#include "metrics.h"
+#include "uartdev.h"
+#include <stdint.h>
+
+#define EXPECT_RX_SIZE (4 * EXPECT_MAX_LEN) /* 等待匹配的接收数据最多保留的字节数 */
+
+/* 一个等待响应的请求 */
+typedef struct {
+	const send_record_t *rec;
+	int64_t sent_ns;      /* 开始发送的时间（CLOCK_MONOTONIC） */
+	int64_t deadline_ns;  /* 超时时间 */
+	uint64_t rx_mark;     /* 发送时已接收的字节数，超时时用来区分没有响应和响应不符 */
+	int attempt;          /* 已重发的次数 */
+} expect_req_t;
+
+/* 按发送项统计 */
+typedef struct {
+	long sent;
+	long ok;
+	long timeouts;        /* 超时前收到的字节数不足期望长度 */
+	long mismatches;      /* 收到足够的字节但没有匹配 */
+	long retries;
+	histogram_t *latency; /* 从开始发送到收到完整响应 */
+} expect_step_t;
+
+/*
+ * 请求/响应引擎：file 模式发送带 ExpectHex 的项后登记为等待中的请求，
+ * 在延时和等待期间持续读取串口，按发送顺序依次匹配响应。
+ * 接收数据先放入缓冲区，队首请求在其中查找（按掩码比较）期望的响应，
+ * 响应之前的字节计为多余数据丢弃，因此提前到达或与后续响应相连的数据都不会丢失。
+ */
+typedef struct {
+	uartdev_t *dev;
+	const json_config_t *config;
+	int64_t default_timeout_ns;          /* 未设置 Timeout 的项使用的超时 */
+	expect_req_t queue[MAX_OUTSTANDING_LIMIT];
+	int head;
+	int count;                           /* 等待中的请求数 */
+	uint8_t rx[EXPECT_RX_SIZE];
+	size_t rx_len;
+	uint64_t rx_total;                   /* 累计接收的字节数 */
+	int64_t rx_ns;                       /* 最后一次收到数据的时间 */
+	expect_step_t *steps;                /* 按 config->records 下标 */
+	long ok;
+	long failed;                         /* 重发用完后仍失败的请求数 */
+	long retries;
+	uint64_t unexpected;                 /* 丢弃的多余字节数 */
+	int stop;                            /* OnFail=stop 的请求失败，应停止发送 */
+	int error;                           /* 读写串口出错时的 errno */
+	metrics_port_t *metrics;             /* 接收、超时和失败计入指标 */
+} expect_t;
+
+/*
+ * 初始化请求/响应引擎
+ * 参数: e - 引擎
+ *       dev - 串口设备
+ *       config - 已验证的 JSON 配置，其中的发送记录在引擎使用期间不能改变
+ *       timeout_ms - 未设置 Timeout 的项等待响应的超时（毫秒）
+ * 返回: 0 成功, -1 失败
+ */
+int expect_init(expect_t *e, uartdev_t *dev, const json_config_t *config, int timeout_ms);
+
+/*
+ * 登记已发送的请求，rec 没有 ExpectHex 时无操作。
+ * 调用前需用 expect_wait_slot() 保证等待中的请求数小于 MaxOutstanding
+ * 参数: rec - 发送记录
+ *       sent_ns - 开始发送的时间
+ */
+void expect_sent(expect_t *e, const send_record_t *rec, int64_t sent_ns);
+
+/*
+ * 持续接收并匹配响应，直到 until_ns（CLOCK_MONOTONIC）
+ * 返回: 0 成功, -1 读串口出错或需要停止（e->stop）
+ */
+int expect_poll_until(expect_t *e, int64_t until_ns);
+
+/*
+ * 接收并匹配响应，直到等待中的请求数小于 MaxOutstanding
+ * 返回: 0 成功, -1 读串口出错或需要停止
+ */
+int expect_wait_slot(expect_t *e);
+
+/*
+ * 接收并匹配响应，直到所有请求都收到响应或超时
+ * 返回: 0 成功, -1 读串口出错或需要停止
+ */
+int expect_drain(expect_t *e);
+
+/*
+ * 打印总计和每个发送项的统计及响应延迟
+ */
+void expect_report(const expect_t *e);
+
+/*
+ * 释放引擎
+ */
+void expect_free(expect_t *e);
+
+#endif /* __EXPECT_H__ */
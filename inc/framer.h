@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __FRAMER_H__
+#define __FRAMER_H__
+
+#include "checksum.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_DELIM_MAX 16   /* 分隔符最大长度 */
+#define FRAME_MAX_SIZE 65536 /* 默认最大帧长，超过时截断 */
+
+typedef enum {
+	FRAME_IDLE,  /* 字符间空闲超过指定字符时间时分帧 */
+	FRAME_DELIM, /* 遇到分隔符时分帧，帧包含分隔符 */
+	FRAME_LEN,   /* 帧头中的长度字段决定帧长 */
+	FRAME_FIXED  /* 固定长度 */
+} frame_mode_t;
+
+/* 分帧规则，由 framer_parse_rule() 从 --frame 参数解析 */
+typedef struct {
+	frame_mode_t mode;
+	double idle_chars;               /* FRAME_IDLE: 空闲字符时间数，如 3.5 */
+	char delim[FRAME_DELIM_MAX];     /* FRAME_DELIM: 分隔符 */
+	int delim_len;
+	int len_offset;                  /* FRAME_LEN: 长度字段在帧中的偏移 */
+	int len_size;                    /* FRAME_LEN: 长度字段字节数 1/2/4 */
+	int len_big_endian;              /* FRAME_LEN: 长度字段是否大端 */
+	int len_extra;                   /* FRAME_LEN: 帧长 = 偏移 + 字段长度 + 字段值 + extra */
+	int fixed_size;                  /* FRAME_FIXED: 帧长 */
+	int max_size;                    /* 最大帧长 */
+} frame_rule_t;
+
+#define FRAME_FLAG_OVERFLOW 0x01   /* 超过最大帧长被截断 */
+#define FRAME_FLAG_INCOMPLETE 0x02 /* 结束时仍未收完的帧 */
+#define FRAME_FLAG_BAD_CHECKSUM 0x04 /* 帧尾的校验值不正确 */
+
+/* 一帧数据，data 直接指向接收缓冲区，只有跨数据块的帧才指向内部的拼接缓冲区 */
+typedef struct {
+	const char *data;
+	size_t len;
+	int64_t first_ns; /* 收到第一个字节所在数据块的时间（CLOCK_MONOTONIC） */
+	int64_t last_ns;  /* 收到最后一个字节所在数据块的时间 */
+	int flags;        /* FRAME_FLAG_* */
+} frame_t;
+
+/* 每收到一帧调用一次，frame->data 只在回调期间有效 */
+typedef void (*frame_cb_t)(void *arg, const frame_t *frame);
+
+typedef struct {
+	frame_rule_t rule;
+	int64_t idle_ns;     /* FRAME_IDLE: 空闲时间（纳秒） */
+	int64_t char_ns;     /* 一个字符的传输时间 */
+	frame_cb_t cb;
+	void *arg;
+	const checksum_t *checksum; /* 不为 NULL 时检查每帧的校验值 */
+	char *carry;         /* 跨数据块的未完成帧 */
+	size_t carry_len;
+	int64_t carry_ns;    /* 未完成帧第一个字节的时间 */
+	int64_t last_ns;     /* 上一个数据块的时间 */
+	uint64_t frames;     /* 统计：帧数 */
+	uint64_t bytes;      /* 统计：帧中的字节数 */
+	uint64_t copied;     /* 统计：经过拼接缓冲区的帧数 */
+	uint64_t overflows;  /* 统计：被截断的帧数 */
+	uint64_t discarded;  /* 统计：长度字段非法时为重新同步丢弃的字节数 */
+	uint64_t checksum_errors; /* 统计：校验值错误的帧数 */
+} framer_t;
+
+/*
+ * 解析分帧规则
+ * 参数: rule - 输出规则
+ *       spec - 规则字符串：
+ *              idle:<chars>                  如 idle:3.5
+ *              delim:<hex>                   如 delim:0d0a
+ *              len:<offset>:<size>[le|be][:<extra>]  如 len:2:2be:2
+ *              fixed:<size>                  如 fixed:16
+ * 返回: 0 成功, -1 失败
+ */
+int framer_parse_rule(frame_rule_t *rule, const char *spec);
+
+/*
+ * 把规则格式化为可读字符串，用于打印
+ */
+void framer_describe(const frame_rule_t *rule, char *buf, size_t len);
+
+/*
+ * 初始化分帧器
+ * 参数: f - 分帧器
+ *       rule - 分帧规则
+ *       char_ns - 一个字符的传输时间，FRAME_IDLE 用来换算空闲时间
+ *       cb, arg - 每帧的回调
+ * 返回: 0 成功, -1 失败并设置 errno
+ */
+int framer_init(framer_t *f, const frame_rule_t *rule, int64_t char_ns, frame_cb_t cb,
+                void *arg);
+
+/*
+ * 设置每帧的校验算法，帧的最后 checksum_size() 字节为校验值，
+ * 不正确时帧带 FRAME_FLAG_BAD_CHECKSUM。截断和未收完的帧不检查。
+ * 参数: cs - 校验算法，NULL 表示不检查，调用者保证其在分帧器使用期间有效
+ */
+void framer_set_checksum(framer_t *f, const checksum_t *cs);
+
+/*
+ * 输入一个数据块，完整的帧立即通过回调输出
+ * 参数: data, len - 数据块
+ *       ts_ns - 收到数据块的时间（CLOCK_MONOTONIC）
+ */
+void framer_push(framer_t *f, const char *data, size_t len, int64_t ts_ns);
+
+/*
+ * 检查空闲超时，FRAME_IDLE 模式下空闲时间已到时输出未完成帧，其他模式无操作
+ * 参数: now_ns - 当前时间（CLOCK_MONOTONIC）
+ */
+void framer_poll(framer_t *f, int64_t now_ns);
+
+/*
+ * 输出剩余的未完成帧，FRAME_IDLE 以外的模式带 FRAME_FLAG_INCOMPLETE
+ */
+void framer_flush(framer_t *f);
+
+/*
+ * 释放分帧器
+ */
+void framer_free(framer_t *f);
+
+#endif /* __FRAMER_H__ */
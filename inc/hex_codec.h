@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __HEX_CODEC_H__
+#define __HEX_CODEC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * hex 编解码实现，按 CPU 在运行时选择：
+ * x86 为 avx2/sse2/scalar，aarch64 为 neon/scalar。各实现结果完全相同。
+ */
+typedef struct {
+	const char *name;
+	/*
+	 * 解码 hex 字符串（大小写均可），src_len 必须为偶数
+	 * 返回: 0 成功, -1 含非法字符，*err_pos 为第一个非法字符的位置
+	 */
+	int (*decode)(const char *src, size_t src_len, uint8_t *dst, size_t *err_pos);
+	/* 编码为连续的大写 hex，dst 需要 2*len 字节 */
+	void (*encode)(const uint8_t *src, size_t len, char *dst);
+	/* 编码为 "XX " 格式（与 print_hex 一致，不含换行），dst 需要 3*len 字节 */
+	void (*encode_spaced)(const uint8_t *src, size_t len, char *dst);
+} hex_codec_t;
+
+/*
+ * 获取当前 CPU 上最快的实现
+ */
+const hex_codec_t *hex_codec_best(void);
+
+/*
+ * 获取当前 CPU 支持的所有实现（基准测试用）
+ * 参数: list - 输出实现列表
+ * 返回: 实现个数
+ */
+int hex_codec_list(const hex_codec_t *const **list);
+
+/* 使用最快实现的便捷函数 */
+static inline int hex_decode(const char *src, size_t src_len, uint8_t *dst, size_t *err_pos)
+{
+	return hex_codec_best()->decode(src, src_len, dst, err_pos);
+}
+
+static inline void hex_encode(const uint8_t *src, size_t len, char *dst)
+{
+	hex_codec_best()->encode(src, len, dst);
+}
+
+static inline void hex_encode_spaced(const uint8_t *src, size_t len, char *dst)
+{
+	hex_codec_best()->encode_spaced(src, len, dst);
+}
+
+#endif /* __HEX_CODEC_H__ */
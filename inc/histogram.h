@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <stdint.h>
+
+/*
+ * 对数-线性直方图（HDR 风格）：小于 128 的值每个值一个桶，
+ * 之后每个 2 的幂区间分为 64 个桶，相对误差不超过 1/64。
+ * 最大可记录 2^41 ns（约 36 分钟），更大的值记入最后一个桶。
+ */
+#define HIST_SUB_BITS 6
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 41
+#define HIST_BUCKETS (2 * HIST_SUB_COUNT + (HIST_MAX_BITS - HIST_SUB_BITS - 1) * HIST_SUB_COUNT)
+
+typedef struct {
+	uint64_t count; /* 样本数 */
+	int64_t min;    /* 最小值（精确） */
+	int64_t max;    /* 最大值（精确） */
+	double sum;     /* 总和，用于求平均值 */
+	uint64_t buckets[HIST_BUCKETS];
+} histogram_t;
+
+/*
+ * 清空直方图
+ */
+void hist_init(histogram_t *h);
+
+/*
+ * 记录一个样本，负数按 0 记录
+ */
+void hist_add(histogram_t *h, int64_t value);
+
+/*
+ * 获取百分位数
+ * 参数: h - 直方图
+ *       pct - 百分位，0-100，例如 99.9
+ * 返回: 该百分位所在桶的上界（不超过最大值），无样本时返回 0
+ */
+int64_t hist_percentile(const histogram_t *h, double pct);
+
+/*
+ * 平均值，无样本时返回 0
+ */
+double hist_mean(const histogram_t *h);
+
+/*
+ * 以微秒为单位打印 min/avg/p50/p99/p99.9/max，样本单位为纳秒
+ * 参数: h - 直方图
+ *       name - 名称，作为行首
+ */
+void hist_report_us(const histogram_t *h, const char *name);
+
+/*
+ * 以 HDR 直方图的百分位表格式打印分布（微秒），
+ * 每行为百分位、该百分位的值和不超过该值的样本数
+ */
+void hist_print_table_us(const histogram_t *h);
+
+#endif /* __HISTOGRAM_H__ */
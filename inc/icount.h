@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __ICOUNT_H__
+#define __ICOUNT_H__
+
+#include "uartdev.h"
+
+/* 驱动统计的计数（TIOCGICOUNT），各字段在驱动中是 int，会回绕 */
+typedef struct {
+	unsigned int rx;          /* 硬件收到的字符数 */
+	unsigned int tx;          /* 硬件发出的字符数 */
+	unsigned int frame;       /* 帧错误：停止位不对，通常是波特率或参数不匹配、线路干扰 */
+	unsigned int parity;      /* 校验错误 */
+	unsigned int overrun;     /* UART FIFO 溢出：中断或 DMA 没有及时取走数据 */
+	unsigned int buf_overrun; /* tty 缓冲区溢出：应用程序读取太慢 */
+	unsigned int brk;         /* 收到 break */
+} icount_counts_t;
+
+typedef struct {
+	const uartdev_t *dev;
+	int supported;         /* 驱动是否支持 TIOCGICOUNT（pty、多数 USB CDC 不支持） */
+	icount_counts_t start; /* icount_start() 时的计数 */
+	icount_counts_t last;  /* 上次 icount_poll() 时的计数 */
+} icount_t;
+
+/*
+ * 读取驱动计数
+ * 返回: 0 成功, -1 失败并设置 errno（不支持时为 ENOTTY 或 EINVAL）
+ */
+int icount_read(const uartdev_t *dev, icount_counts_t *c);
+
+/*
+ * 记录开始时的计数，驱动不支持时打印一次提示，之后的调用都不输出
+ * 返回: 1 支持, 0 不支持
+ */
+int icount_start(icount_t *ic, const uartdev_t *dev);
+
+/*
+ * 读取计数，打印与上次相比的增量 "  Driver: rx +N, tx +N, frame +N, ..."
+ * 参数: errors_only - 为真时只在错误计数增加时打印
+ */
+void icount_poll(icount_t *ic, int errors_only);
+
+/*
+ * 打印从开始到现在的增量，与程序自己的收发字节数对照，并对出现的错误给出可能的原因
+ * 参数: rx_bytes, tx_bytes - 程序读到和写出的字节数，-1 表示不打印
+ * 返回: 错误计数（帧、校验、两种溢出）增加的总数
+ */
+long icount_report(icount_t *ic, long long rx_bytes, long long tx_bytes);
+
+#endif /* __ICOUNT_H__ */
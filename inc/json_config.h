@@ -9,18 +9,63 @@ Free Software Foundation.
 #ifndef __JSON_CONFIG_H__
 #define __JSON_CONFIG_H__
 
+#include "checksum.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define EXPECT_MAX_LEN 1024       /* ExpectHex 最大字节数 */
+#define EXPECT_MAX_TIMEOUT 60000  /* Timeout 最大毫秒数 */
+#define EXPECT_MAX_RETRIES 100    /* OnFail retry 最大次数 */
+#define MAX_OUTSTANDING_LIMIT 64  /* MaxOutstanding 上限 */
+
+/* 响应不符合预期时的处理 */
+typedef enum {
+	ON_FAIL_CONTINUE, /* 记录失败，继续发送下一项（默认） */
+	ON_FAIL_STOP,     /* 停止发送 */
+	ON_FAIL_RETRY     /* 重发本项，最多 retries 次 */
+} on_fail_t;
+
 typedef struct {
 	int number;     /* 标签号 */
 	char *hex_data; /* HEX数据字符串 */
-	int delay;      /* 延时（毫秒） */
+	int delay;      /* 延时（毫秒），未设置时为 -1 */
+	int delay_us;   /* 延时（微秒），未设置时为 -1 */
+	double delay_chars; /* 延时（字符时间），未设置时为 -1 */
 	int enable;     /* 是否启用 */
+	char *expect_hex;  /* 期望的响应（HEX），NULL 表示不等待响应 */
+	char *expect_mask; /* 响应掩码（HEX），为 1 的位参与比较，NULL 表示全部比较 */
+	int timeout;       /* 等待响应的超时（毫秒），未设置时为 -1 */
+	char *on_fail;     /* 失败处理：continue/stop/retry[:N]，NULL 表示 continue */
 } send_item_t;
 
+/* 已解码的发送项，数据位于 json_config_t.arena 中 */
+typedef struct {
+	size_t offset;           /* 数据在 arena 中的偏移 */
+	int len;                 /* 数据长度（字节） */
+	int64_t delay_ns;        /* 延时（纳秒），不含按字符时间计算的部分 */
+	double delay_chars;      /* 延时（字符时间），发送前按波特率换算，0 表示无 */
+	const send_item_t *item; /* 对应的原始发送项 */
+	const uint8_t *expect;   /* 期望的响应，位于 expect_arena 中，NULL 表示不等待 */
+	const uint8_t *expect_mask; /* 响应掩码，NULL 表示全部比较 */
+	int expect_len;          /* 期望响应的字节数 */
+	int64_t timeout_ns;      /* 等待响应的超时，0 表示使用默认值 */
+	on_fail_t on_fail;       /* 失败处理 */
+	int retries;             /* ON_FAIL_RETRY 的最多重发次数 */
+} send_record_t;
+
 typedef struct {
 	char *group_name;       /* 配置组名称 */
 	int cycle_count;        /* 循环次数 */
 	send_item_t *send_list; /* 发送列表数组 */
 	int send_list_count;    /* 发送列表元素个数 */
+	int max_outstanding;    /* 同时等待响应的请求数，未设置时为 1 */
+	/* 以下由 validate_json_config() 生成 */
+	uint8_t *arena;         /* 所有启用项解码后的数据，连续存放 */
+	size_t arena_len;       /* arena 总长度 */
+	send_record_t *records; /* 启用的发送项，按发送顺序排列 */
+	int record_count;       /* 启用的发送项个数 */
+	uint8_t *expect_arena;  /* 所有启用项的期望响应和掩码 */
+	int expect_count;       /* 带 ExpectHex 的启用项个数 */
 } json_config_t;
 
 /*
@@ -31,12 +76,22 @@ typedef struct {
 json_config_t *parse_json_file(const char *filename);
 
 /*
- * 验证JSON配置的有效性
+ * 验证JSON配置的有效性，并把所有启用项的 HexData 一次解码到 arena 中，
+ * 发送时直接使用 records，不再重复解析
  * 参数: config - 配置结构体
  * 返回: 0 成功, -1 失败
  */
 int validate_json_config(json_config_t *config);
 
+/*
+ * 在每个发送项的数据后追加校验值，重新生成 arena，
+ * 需要在 validate_json_config() 之后调用
+ * 参数: config - 配置结构体
+ *       cs - 校验算法
+ * 返回: 0 成功, -1 失败
+ */
+int json_config_add_checksum(json_config_t *config, const checksum_t *cs);
+
 /*
  * 释放JSON配置结构体的内存
  * 参数: config - 配置结构体
@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __LOWLAT_H__
+#define __LOWLAT_H__
+
+#include "uartdev.h"
+
+#define LATENCY_TIMER_MIN 1   /* FTDI latency_timer 取值范围（毫秒） */
+#define LATENCY_TIMER_MAX 255
+
+/*
+ * 设置或清除串口驱动的 ASYNC_LOW_LATENCY 标志（TIOCGSERIAL/TIOCSSERIAL）
+ * 返回: 0 成功, -1 失败并设置 errno（驱动不支持时为 ENOTTY 或 EINVAL）
+ */
+int lowlat_set_async(uartdev_t *dev, int enable);
+
+/*
+ * 查找 USB 转串口的 latency_timer sysfs 文件（FTDI 等驱动提供）
+ * 参数: dev - 串口设备，支持 /dev/serial/by-id 等符号链接
+ *       path - 输出路径
+ *       len - path 缓冲区大小
+ * 返回: 0 找到, -1 设备没有 latency_timer
+ */
+int lowlat_timer_path(const uartdev_t *dev, char *path, size_t len);
+
+/*
+ * 读取 latency_timer
+ * 返回: 毫秒, -1 失败
+ */
+int lowlat_get_timer(const uartdev_t *dev);
+
+/*
+ * 写入 latency_timer，需要写 sysfs 的权限
+ * 返回: 0 成功, -1 失败并设置 errno
+ */
+int lowlat_set_timer(const uartdev_t *dev, int ms);
+
+/*
+ * 应用低延迟设置并打印结果，不支持的设置只打印提示
+ * 参数: dev - 已打开的串口设备
+ *       low_latency - 是否设置 ASYNC_LOW_LATENCY
+ *       timer_ms - 要设置的 latency_timer，0 表示只读取不修改
+ * 返回: 0 成功, -1 明确要求的设置失败
+ */
+int lowlat_apply(uartdev_t *dev, int low_latency, int timer_ms);
+
+#endif /* __LOWLAT_H__ */
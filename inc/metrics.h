@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_MAX_PORTS 256        /* 最多统计的端口数 */
+#define METRICS_PORT_LEN 128         /* 端口名的最大长度 */
+#define METRICS_DEFAULT_INTERVAL 10  /* 默认导出间隔（秒） */
+#define METRICS_MAX_INTERVAL 3600
+
+typedef enum {
+	METRICS_JSON, /* 每次导出追加一行 JSON */
+	METRICS_PROM  /* Prometheus textfile collector 格式，每次整体替换文件 */
+} metrics_format_t;
+
+/*
+ * 每个端口的计数。测试线程用 metrics_*() 原子累加，不加锁；
+ * 导出线程定期读取，计数只增不减，速率由两次导出之间的差值计算。
+ */
+typedef struct {
+	char port[METRICS_PORT_LEN];
+	uint64_t tx_bytes;
+	uint64_t tx_packets;   /* 发送次数 */
+	uint64_t rx_bytes;
+	uint64_t rx_packets;   /* 接收次数（每次 read() 或每帧） */
+	uint64_t timeouts;     /* 接收超时或等待响应超时 */
+	uint64_t errors;       /* 读写失败、数据丢弃、校验错误、响应失败 */
+	uint64_t late_count;   /* 调度延迟的样本数 */
+	uint64_t late_sum_ns;  /* 实际发送时间晚于计划时间的累计值 */
+	uint64_t late_max_ns;
+} metrics_port_t;
+
+/*
+ * 启动指标导出线程，每 interval_sec 秒把所有端口的计数写入 path
+ * 参数: path - 输出文件，json 格式追加写入，prom 格式先写 path.tmp 再重命名
+ *       format - 输出格式
+ *       interval_sec - 导出间隔，1-METRICS_MAX_INTERVAL 秒
+ * 返回: 0 成功, -1 失败
+ */
+int metrics_open(const char *path, metrics_format_t format, int interval_sec);
+
+/*
+ * 注册端口，返回其计数。没有调用 metrics_open() 时返回 NULL，
+ * 下面的累加函数对 NULL 无操作，调用方不需要判断
+ * 参数: port - 端口名，同名端口返回同一个计数
+ */
+metrics_port_t *metrics_port(const char *port);
+
+/*
+ * 停止导出线程，退出前再导出一次最终的计数
+ */
+void metrics_close(void);
+
+static inline void metrics_tx(metrics_port_t *m, uint64_t bytes)
+{
+	if (m != NULL) {
+		__atomic_add_fetch(&m->tx_bytes, bytes, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&m->tx_packets, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static inline void metrics_rx(metrics_port_t *m, uint64_t bytes)
+{
+	if (m != NULL) {
+		__atomic_add_fetch(&m->rx_bytes, bytes, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&m->rx_packets, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static inline void metrics_timeout(metrics_port_t *m)
+{
+	if (m != NULL) {
+		__atomic_add_fetch(&m->timeouts, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static inline void metrics_error(metrics_port_t *m)
+{
+	if (m != NULL) {
+		__atomic_add_fetch(&m->errors, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/* 记录一次调度延迟（实际时间 - 计划时间），提前的按 0 计 */
+static inline void metrics_late(metrics_port_t *m, int64_t late_ns)
+{
+	uint64_t ns = late_ns > 0 ? (uint64_t)late_ns : 0;
+	uint64_t max;
+
+	if (m == NULL) {
+		return;
+	}
+	__atomic_add_fetch(&m->late_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&m->late_sum_ns, ns, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&m->late_max_ns, __ATOMIC_RELAXED);
+	while (ns > max && !__atomic_compare_exchange_n(&m->late_max_ns, &max, ns, 1,
+	                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+#endif /* __METRICS_H__ */
@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __MODBUS_H__
+#define __MODBUS_H__
+
+#include "uartdev.h"
+#include <stdint.h>
+
+#define MODBUS_MAX_REQUESTS 64   /* -s 中最多的请求个数 */
+#define MODBUS_MAX_ADU 256       /* RTU 帧最大长度 */
+#define MODBUS_MAX_REGS 125      /* 功能码 3/4 一次最多读的寄存器数 */
+#define MODBUS_MAX_BITS 2000     /* 功能码 1/2 一次最多读的线圈数 */
+#define MODBUS_T35_FIXED_NS 1750000 /* 波特率高于 19200 时 T3.5 固定为 1750us */
+
+/* 一个轮询请求：读 slave 的 count 个寄存器/线圈 */
+typedef struct {
+	int slave;     /* 从站地址 1-247 */
+	int function;  /* 功能码 1/2/3/4 */
+	int address;   /* 起始地址 0-65535 */
+	int count;     /* 数量 */
+	uint8_t adu[8];   /* 编码好的请求帧，含 CRC */
+	int resp_len;     /* 正常响应的长度 */
+} modbus_req_t;
+
+/*
+ * 解析轮询请求列表
+ * 参数: spec - 逗号分隔的 "slave:function:address:count"，如 "1:3:0:10,2:4:100:2"
+ *       reqs - 输出请求数组，至少 MODBUS_MAX_REQUESTS 个元素
+ * 返回: 请求个数, -1 格式错误
+ */
+int modbus_parse_requests(const char *spec, modbus_req_t *reqs);
+
+/*
+ * 帧间隔 T3.5：波特率不高于 19200 时为 3.5 个字符时间，否则固定 1750us
+ */
+int64_t modbus_t35_ns(const uartdev_t *dev);
+
+/*
+ * Modbus RTU 主站轮询测试：按顺序循环发送请求，在 T3.5 允许的范围内尽快轮询，
+ * 校验响应的 CRC、从站地址、功能码和长度，按从站统计请求数、超时、CRC 错误、
+ * 异常响应和响应延迟分布。
+ * 参数: dev - 串口设备
+ *       spec - 轮询请求列表，见 modbus_parse_requests()
+ *       duration - 测试时间（秒），0 表示直到 Ctrl+C
+ *       timeout_ms - 响应超时时间
+ * 返回: 0 成功（没有超时和错误）, -1 失败
+ */
+int uart_modbus_test(uartdev_t *dev, const char *spec, int duration, int timeout_ms);
+
+#endif /* __MODBUS_H__ */
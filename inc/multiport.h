@@ -0,0 +1,25 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __MULTIPORT_H__
+#define __MULTIPORT_H__
+
+#include "args_parser.h"
+
+#define MULTIPORT_MAX_EVENTS 64    /* epoll_wait 单次返回的最大事件数 */
+#define MULTIPORT_RX_BUF_SIZE 4096 /* 每个端口的接收缓冲区大小 */
+
+/*
+ * 多端口模式：在一个进程内用 epoll 同时驱动设备列表中的所有串口，
+ * 每个端口有独立的发送和接收状态，支持 loopback/send/recv 模式
+ * 参数: config - 命令行配置（包含设备列表）
+ * 返回: 0 成功, -1 失败
+ */
+int uart_multi_test(const uart_config_t *config);
+
+#endif /* __MULTIPORT_H__ */
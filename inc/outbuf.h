@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __OUTBUF_H__
+#define __OUTBUF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define OUTBUF_SIZE 65536 /* 输出缓冲区大小 */
+
+/*
+ * 输出缓冲区：在内存中拼好整行后一次 fwrite() 写出。
+ * 字节到 hex、字节到转义序列都使用预先计算好的查找表，
+ * 时间戳只在秒变化时才重新调用 localtime/strftime。
+ */
+typedef struct {
+	FILE *fp;          /* 输出流 */
+	size_t len;        /* 缓冲区中已有的字节数 */
+	time_t ts_sec;     /* 缓存的时间戳对应的秒 */
+	int ts_len;        /* 缓存的时间戳前缀长度 */
+	char ts_str[32];   /* 缓存的时间戳前缀 "[YYYY-mm-dd HH:MM:SS." */
+	char buf[OUTBUF_SIZE];
+} outbuf_t;
+
+/*
+ * 初始化输出缓冲区
+ * 参数: o - 输出缓冲区
+ *       fp - 输出流，如 stdout
+ */
+void outbuf_init(outbuf_t *o, FILE *fp);
+
+/*
+ * 把缓冲区中的内容一次写入输出流
+ * 返回: 0 成功, -1 失败
+ */
+int outbuf_flush(outbuf_t *o);
+
+/*
+ * 追加原样字符串
+ */
+void outbuf_write(outbuf_t *o, const char *s, size_t len);
+
+/*
+ * 追加格式化字符串（用于统计信息等非热点输出）
+ */
+void outbuf_printf(outbuf_t *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/*
+ * 追加时间戳，格式与 print_timestamp() 相同
+ * 参数: realtime_ns - CLOCK_REALTIME 时间（纳秒）
+ */
+void outbuf_timestamp(outbuf_t *o, int64_t realtime_ns);
+
+/*
+ * 按ASCII格式追加数据，输出与 print_ascii() 相同
+ */
+void outbuf_ascii(outbuf_t *o, const char *buf, int len);
+
+/*
+ * 按16进制格式追加数据，输出与 print_hex() 相同
+ */
+void outbuf_hex(outbuf_t *o, const char *buf, int len);
+
+#endif /* __OUTBUF_H__ */
@@ -0,0 +1,29 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __PING_H__
+#define __PING_H__
+
+#include "args_parser.h"
+#include "uartdev.h"
+
+/*
+ * 往返延迟测试模式：发送一个请求，等待对端（或 Tx/Rx 短接）回显相同的数据，
+ * 记录从开始发送到收完最后一个字节的时间，结束时打印 HDR 风格的延迟分布。
+ * 参数: dev - 串口设备
+ *       send_str - 请求数据
+ *       format - 请求数据格式（ASCII/HEX）
+ *       interval_ms - 两次请求开始之间的间隔
+ *       count - 请求次数，0 表示直到 Ctrl+C
+ *       timeout_ms - 等待回显的超时时间
+ * 返回: 0 成功（全部收到正确回显）, -1 失败
+ */
+int uart_ping_test(uartdev_t *dev, const char *send_str, output_format_t format, int interval_ms,
+                   int count, int timeout_ms);
+
+#endif /* __PING_H__ */
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __PRBS_H__
+#define __PRBS_H__
+
+#include "uartdev.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRBS_SYNC_BITS 64     /* 连续无误码多少位后判定同步 */
+#define PRBS_WINDOW_BITS 1024 /* 失步检测窗口（位） */
+#define PRBS_LOSS_ERRORS 128  /* 窗口内误码超过该值判定失步 */
+
+/*
+ * PRBS 发生器，多项式 x^order + x^tap + 1（不取反）：
+ * PRBS7: x^7+x^6+1, PRBS15: x^15+x^14+1, PRBS23: x^23+x^18+1, PRBS31: x^31+x^28+1
+ * state 保存最近 64 位，最新的位在 bit63。按 UART 的 LSB 先发顺序组成字节。
+ */
+typedef struct {
+	int order;      /* 多项式阶数 */
+	int tap;        /* 中间抽头 */
+	uint64_t state; /* 最近生成的 64 位 */
+} prbs_gen_t;
+
+/* 误码统计 */
+typedef struct {
+	uint64_t bits;        /* 比较的位数 */
+	uint64_t bit_errors;  /* 误码位数 */
+	uint64_t bytes;       /* 比较的字节数 */
+	uint64_t byte_errors; /* 误码字节数 */
+} prbs_count_t;
+
+/*
+ * PRBS 接收校验器，自同步后使用本地参考序列逐位比较。
+ * 统计按窗口提交，并保留一个待定窗口：失步时丢弃当前窗口和待定窗口，
+ * 避免把丢字节造成的误码计入误码率。
+ */
+typedef struct {
+	prbs_gen_t ref;       /* 同步后的参考序列 */
+	uint64_t hist;        /* 最近接收的 64 位，最新的位在 bit63 */
+	int locked;           /* 是否已同步 */
+	int sync_bits;        /* 搜索状态下连续无误码的位数 */
+	prbs_count_t window;  /* 当前窗口 */
+	prbs_count_t pending; /* 待定窗口（下一个窗口正常后提交） */
+	prbs_count_t total;   /* 已提交的统计 */
+	uint64_t hunt_bytes;  /* 未同步或失步丢弃的字节数 */
+	uint64_t locks;       /* 同步次数（首次同步 + 重同步） */
+	uint64_t slips;       /* 失步次数 */
+} prbs_check_t;
+
+/*
+ * 初始化 PRBS 发生器
+ * 参数: g - 发生器
+ *       order - 7/15/23/31
+ * 返回: 0 成功, -1 不支持的阶数
+ */
+int prbs_gen_init(prbs_gen_t *g, int order);
+
+/*
+ * 生成 len 字节的 PRBS 序列
+ */
+void prbs_gen_fill(prbs_gen_t *g, uint8_t *buf, size_t len);
+
+/*
+ * 初始化 PRBS 校验器
+ * 返回: 0 成功, -1 不支持的阶数
+ */
+int prbs_check_init(prbs_check_t *c, int order);
+
+/*
+ * 校验接收到的数据，自动同步、检测失步并重同步，结果累计在 c 中
+ */
+void prbs_check_feed(prbs_check_t *c, const uint8_t *buf, size_t len);
+
+/*
+ * 获取当前误码统计（包含尚未提交的窗口）
+ */
+void prbs_check_result(const prbs_check_t *c, prbs_count_t *result);
+
+/*
+ * PRBS 自环压力测试：发送线程持续发送 PRBS 序列，主线程校验接收数据，
+ * 周期性报告误码率（需要 Tx/Rx 短接，仅支持 8 位数据位）
+ * 参数: dev - 串口设备
+ *       order - PRBS 阶数 7/15/23/31
+ *       duration_sec - 持续时间（秒），0 表示直到 Ctrl+C
+ * 返回: 0 成功（已同步且无误码）, -1 失败
+ */
+int uart_prbs_test(uartdev_t *dev, int order, int duration_sec);
+
+#endif /* __PRBS_H__ */
@@ -0,0 +1,24 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "uartdev.h"
+
+/*
+ * 回放模式：把抓包文件（recv --capture 生成）中接收方向的记录重新从串口发出，
+ * 保持记录之间原有的时间间隔。文件以只读方式映射，直接从映射发送，不复制数据。
+ * 参数: dev - 串口设备
+ *       capture_file - 抓包文件
+ *       speed - 时间缩放系数，1 为原速，2 为两倍速，0 表示不等待、以最快速度发送
+ * 返回: 0 成功, -1 失败
+ */
+int uart_replay_test(uartdev_t *dev, const char *capture_file, double speed);
+
+#endif /* __REPLAY_H__ */
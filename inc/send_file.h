@@ -0,0 +1,28 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __SEND_FILE_H__
+#define __SEND_FILE_H__
+
+#include "uartdev.h"
+
+#define SEND_FILE_CHUNK 65536          /* 单次 write() 的最大字节数 */
+#define SEND_FILE_RELEASE (4 << 20)    /* 每发送这么多字节释放一次已发送部分的映射页 */
+#define SEND_FILE_REPORT_MS 500        /* 进度刷新间隔 */
+
+/*
+ * 发送模式 --send-file：以只读方式映射文件，以非阻塞方式分块写入串口。
+ * 部分写入时继续发送剩余部分，发送缓冲区满（EAGAIN）时用 poll(POLLOUT) 等待。
+ * 已发送部分的页会被释放，内存占用与文件大小无关。发送过程中显示速率和剩余时间。
+ * 参数: dev - 串口设备
+ *       path - 要发送的文件，必须是普通文件
+ * 返回: 0 成功, -1 失败
+ */
+int uart_send_file_test(uartdev_t *dev, const char *path);
+
+#endif /* __SEND_FILE_H__ */
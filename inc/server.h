@@ -0,0 +1,33 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "args_parser.h"
+#include "uartdev.h"
+
+#define SERVER_CHUNK 4096            /* 单次读取串口或客户端的字节数 */
+#define SERVER_QUEUE_SIZE (256 << 10) /* 每个客户端待发送队列的大小 */
+#define SERVER_TX_SIZE 65536         /* 待写入串口的缓冲区大小 */
+#define SERVER_BACKLOG 16            /* listen() 的连接队列长度 */
+#define SERVER_MAX_EVENTS 64         /* epoll_wait 单次返回的最大事件数 */
+
+/*
+ * 服务器模式：在 TCP 端口上提供串口（类似 ser2net），客户端个数不限。
+ * 串口收到的数据复制到每个客户端各自的发送队列，客户端接收太慢、队列放不下时
+ * 丢弃该客户端的这一块数据并计数，不会阻塞串口读取和其他客户端。
+ * 客户端发来的数据按到达顺序写入串口，每次读取的一块整体写入，不会与其他客户端的数据交错；
+ * 串口写不进时暂停读取所有客户端，由 TCP 反压。
+ * 参数: dev - 已打开的串口设备
+ *       listen_spec - 监听地址 "[addr:]port"，不指定 addr 时监听所有地址
+ * 返回: 0 成功, -1 失败
+ */
+int uart_server_test(uartdev_t *dev, const char *listen_spec);
+
+#endif /* __SERVER_H__ */
@@ -0,0 +1,152 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SPSC_CACHE_LINE 64
+
+/*
+Lock-free single-producer/single-consumer ring of fixed-size slots.
+The producer reserves a slot, fills it in place and commits it; the consumer
+peeks the oldest slot, uses it in place and releases it. No data is copied
+by the ring itself.
+*/
+typedef struct {
+	/* Written by the producer only */
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t head;
+	atomic_size_t high_water; /* Highest number of used slots seen by the producer */
+	atomic_uint_least64_t drops; /* Number of items discarded via spsc_ring_drop() */
+	/* Written by the consumer only */
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t tail;
+	/* Read only after init */
+	_Alignas(SPSC_CACHE_LINE) size_t mask;
+	size_t slot_size;
+	char *slots;
+} spsc_ring_t;
+
+/*
+Initialize the ring with slot_count slots of slot_size bytes each.
+slot_count must be a power of two.
+If successful return 0, otherwise -1 is returned and errno is set.
+*/
+static inline int spsc_ring_init(spsc_ring_t *r, size_t slot_count, size_t slot_size)
+{
+	if (r == NULL || slot_count == 0 || (slot_count & (slot_count - 1)) != 0 ||
+	    slot_size == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Round slots up to a cache line so neighbours never share one */
+	slot_size = (slot_size + SPSC_CACHE_LINE - 1) & ~(size_t)(SPSC_CACHE_LINE - 1);
+	r->slots = aligned_alloc(SPSC_CACHE_LINE, slot_count * slot_size);
+	if (r->slots == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->high_water, 0);
+	atomic_init(&r->drops, 0);
+	r->mask = slot_count - 1;
+	r->slot_size = slot_size;
+
+	return 0;
+}
+
+static inline void spsc_ring_free(spsc_ring_t *r)
+{
+	if (r == NULL)
+		return;
+
+	free(r->slots);
+	r->slots = NULL;
+}
+
+/* Counters, safe to read from any thread */
+static inline size_t spsc_ring_high_water(spsc_ring_t *r)
+{
+	return atomic_load_explicit(&r->high_water, memory_order_relaxed);
+}
+
+static inline uint64_t spsc_ring_drops(spsc_ring_t *r)
+{
+	return atomic_load_explicit(&r->drops, memory_order_relaxed);
+}
+
+/* Number of slots */
+static inline size_t spsc_ring_capacity(const spsc_ring_t *r)
+{
+	return r->mask + 1;
+}
+
+/*
+Producer: get the next free slot, or NULL if the ring is full.
+The slot becomes visible to the consumer after spsc_ring_commit().
+A NULL return is not counted; call spsc_ring_drop() if data was actually lost.
+*/
+static inline void *spsc_ring_reserve(spsc_ring_t *r)
+{
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+	if (head - tail > r->mask) {
+		return NULL;
+	}
+
+	return r->slots + (head & r->mask) * r->slot_size;
+}
+
+/* Producer: count an item discarded because spsc_ring_reserve() found the ring full */
+static inline void spsc_ring_drop(spsc_ring_t *r)
+{
+	atomic_fetch_add_explicit(&r->drops, 1, memory_order_relaxed);
+}
+
+/* Producer: publish the slot returned by spsc_ring_reserve() */
+static inline void spsc_ring_commit(spsc_ring_t *r)
+{
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed) + 1;
+	size_t used = head - atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+	if (used > atomic_load_explicit(&r->high_water, memory_order_relaxed)) {
+		atomic_store_explicit(&r->high_water, used, memory_order_relaxed);
+	}
+	atomic_store_explicit(&r->head, head, memory_order_release);
+}
+
+/* Consumer: get the oldest committed slot, or NULL if the ring is empty */
+static inline void *spsc_ring_peek(spsc_ring_t *r)
+{
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+	if (tail == head) {
+		return NULL;
+	}
+
+	return r->slots + (tail & r->mask) * r->slot_size;
+}
+
+/* Consumer: return the slot returned by spsc_ring_peek() to the producer */
+static inline void spsc_ring_release(spsc_ring_t *r)
+{
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+	atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+#endif /* __SPSC_RING_H__ */
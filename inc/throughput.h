@@ -0,0 +1,27 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __THROUGHPUT_H__
+#define __THROUGHPUT_H__
+
+#include "uartdev.h"
+
+#define BENCH_TX_CHUNK 4096      /* 发送线程单次写入的字节数 */
+#define BENCH_RX_BUF_SIZE 65536  /* 接收缓冲区大小 */
+#define BENCH_DRAIN_IDLE_MS 500  /* 发送结束后，接收端空闲多久视为收完 */
+
+/*
+ * 吞吐量测试模式：发送线程持续写满 TX FIFO，主线程同时读空 RX，
+ * 结束后报告实际速率、理论速率、效率和丢失字节数（需要 Tx/Rx 短接）
+ * 参数: dev - 串口设备
+ *       duration_sec - 发送持续时间（秒），0 表示直到 Ctrl+C
+ * 返回: 0 成功（无丢失和错误）, -1 失败
+ */
+int uart_bench_test(uartdev_t *dev, int duration_sec);
+
+#endif /* __THROUGHPUT_H__ */
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_USEC 1000LL
+
+/*
+ * 获取 CLOCK_MONOTONIC 时间
+ * 返回: 纳秒
+ */
+static inline int64_t timing_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * 睡眠到 CLOCK_MONOTONIC 绝对时间 deadline_ns，不会因为调用者自身的
+ * 耗时而累积误差。deadline 已过时立即返回。
+ * 返回: 0 到期, -1 被信号中断（errno 为 EINTR）
+ */
+static inline int timing_sleep_until(int64_t deadline_ns)
+{
+	struct timespec ts;
+	int ret;
+
+	ts.tv_sec = deadline_ns / NSEC_PER_SEC;
+	ts.tv_nsec = deadline_ns % NSEC_PER_SEC;
+	ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	if (ret != 0) {
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * 睡眠到 deadline_ns 前 spin_ns 处，之后忙等到 deadline，
+ * 用于微秒级的延时，避免调度器唤醒延迟。spin_ns 为 0 时与 timing_sleep_until() 相同
+ * 返回: 0 到期, -1 被信号中断（errno 为 EINTR）
+ */
+static inline int timing_wait_until(int64_t deadline_ns, int64_t spin_ns)
+{
+	if (spin_ns <= 0) {
+		return timing_sleep_until(deadline_ns);
+	}
+
+	if (timing_sleep_until(deadline_ns - spin_ns) < 0) {
+		return -1;
+	}
+	while (timing_now_ns() < deadline_ns) {
+	}
+
+	return 0;
+}
+
+/*
+ * 按固定周期推进 deadline：下一个 deadline 已经过去时跳过错过的周期，
+ * 保持与起始时间对齐，而不是连续补发
+ * 参数: deadline_ns - 当前 deadline
+ *       period_ns - 周期
+ *       now_ns - 当前时间
+ *       missed - 累加跳过的周期数，可以为 NULL
+ * 返回: 下一个 deadline
+ */
+static inline int64_t timing_next_deadline(int64_t deadline_ns, int64_t period_ns, int64_t now_ns,
+                                           long *missed)
+{
+	int64_t n;
+
+	deadline_ns += period_ns;
+	if (deadline_ns < now_ns && period_ns > 0) {
+		n = (now_ns - deadline_ns) / period_ns + 1;
+		deadline_ns += n * period_ns;
+		if (missed != NULL) {
+			*missed += (long)n;
+		}
+	}
+
+	return deadline_ns;
+}
+
+#endif /* __TIMING_H__ */
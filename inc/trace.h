@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+#define TRACE_BUF_EVENTS 262144 /* 每个线程最多记录的事件数，写满后丢弃并计数 */
+#define TRACE_NAME_LEN 16
+
+/*
+ * 开始记录跟踪事件，为当前线程分配事件缓冲区。编译时没有定义 __TRACE__
+ * （cmake -DENABLE_TRACE=ON）时打印错误并失败
+ * 参数: path - 退出时写入的 Chrome trace JSON 文件，可用 chrome://tracing 或 Perfetto 打开
+ * 返回: 0 成功, -1 失败
+ */
+int trace_open(const char *path);
+
+/*
+ * 停止记录，把所有线程的事件写入文件并释放缓冲区。
+ * 调用前其他记录事件的线程应已退出。没有调用 trace_open() 时无操作
+ */
+void trace_close(void);
+
+/*
+ * 跟踪点：
+ *   TRACE_BEGIN(var);          记录开始时间到局部变量
+ *   TRACE_END(var, "name");    记录一个从开始到现在的事件，name 必须是字符串常量
+ *   TRACE_THREAD("name");      设置当前线程在跟踪文件中显示的名字
+ * 没有定义 __TRACE__ 时都展开为空，不产生任何代码。定义后没有 --trace 时只多一次
+ * 分支判断；打开时每个事件是两次 clock_gettime()（vDSO）和一次写入线程自己的缓冲区，
+ * 不加锁、不分配内存，格式化推迟到 trace_close()
+ */
+#ifdef __TRACE__
+
+#include "timing.h"
+
+typedef struct {
+	const char *name;
+	int64_t start_ns;
+	int64_t dur_ns;
+} trace_event_t;
+
+typedef struct trace_buf {
+	trace_event_t *events;
+	uint32_t count;
+	uint64_t dropped;
+	int tid;
+	char name[TRACE_NAME_LEN];
+	struct trace_buf *next;
+} trace_buf_t;
+
+extern int g_trace_enabled;
+extern __thread trace_buf_t *g_trace_buf;
+
+/* 分配当前线程的缓冲区，没有打开跟踪或分配失败时返回 NULL */
+trace_buf_t *trace_thread_buf(void);
+void trace_thread_name(const char *name);
+
+static inline int64_t trace_now_ns(void)
+{
+	return g_trace_enabled ? timing_now_ns() : 0;
+}
+
+static inline void trace_span(const char *name, int64_t start_ns)
+{
+	trace_buf_t *b = g_trace_buf;
+	trace_event_t *e;
+
+	if (!g_trace_enabled) {
+		return;
+	}
+	if (b == NULL && (b = trace_thread_buf()) == NULL) {
+		return;
+	}
+	if (b->count >= TRACE_BUF_EVENTS) {
+		b->dropped++;
+		return;
+	}
+
+	e = &b->events[b->count++];
+	e->name = name;
+	e->start_ns = start_ns;
+	e->dur_ns = timing_now_ns() - start_ns;
+}
+
+#define TRACE_BEGIN(var) int64_t trace_##var##_ns = trace_now_ns()
+#define TRACE_END(var, name) trace_span(name, trace_##var##_ns)
+#define TRACE_THREAD(name) trace_thread_name(name)
+
+#else
+
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, name)
+#define TRACE_THREAD(name)
+
+#endif /* __TRACE__ */
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#ifndef __TRIGGER_H__
+#define __TRIGGER_H__
+
+#include "outbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define TRIGGER_MAX_PATTERNS 32     /* 最多的模式个数 */
+#define TRIGGER_MAX_PATTERN_LEN 256 /* 单个模式最大长度 */
+#define TRIGGER_MAX_STATES 4096     /* 自动机最大状态数，即所有模式的总长度 + 1 */
+#define TRIGGER_SNAPSHOT_DEFAULT 64 /* snapshot 默认前后各保存的字节数 */
+#define TRIGGER_SNAPSHOT_MAX 4096   /* snapshot 前后各保存的最大字节数 */
+#define TRIGGER_MAX_PENDING 16      /* 同时等待后续数据的 snapshot 个数 */
+
+typedef struct {
+	uint8_t data[TRIGGER_MAX_PATTERN_LEN];
+	int len;
+	char label[TRIGGER_MAX_PATTERN_LEN + 8]; /* 用于打印，如 "ERROR" 或 "hex:0d0a" */
+	uint64_t matches;
+} trigger_pattern_t;
+
+/* 等待后续数据的 snapshot */
+typedef struct {
+	int pattern;
+	uint64_t start;   /* 快照在数据流中的起始偏移 */
+	uint64_t end;     /* 快照在数据流中的结束偏移（不含） */
+	uint64_t match;   /* 匹配结束的偏移 */
+	int64_t ts_ns;    /* 匹配时间（CLOCK_REALTIME） */
+	long number;
+} trigger_pending_t;
+
+/*
+ * 多模式触发器：用 Aho-Corasick 自动机扫描接收数据，状态跨数据块保存，
+ * 跨 read() 边界的模式也能匹配。自动机展开为完整的 256 路转移表，
+ * 每个字节只查一次表。
+ */
+typedef struct {
+	trigger_pattern_t patterns[TRIGGER_MAX_PATTERNS];
+	int pattern_count;
+
+	/* 动作 */
+	int do_log;
+	int do_exit;
+	int exit_code;
+	char *hook;        /* 匹配时执行的 shell 命令，NULL 表示不执行 */
+	int snapshot;      /* 前后各保存的字节数，0 表示不保存 */
+	const char *port;  /* 传给 hook 的端口名 */
+
+	/* 自动机 */
+	uint16_t *delta;   /* delta[state * 256 + byte] */
+	int16_t *out;      /* 在该状态结束的模式，-1 表示无 */
+	uint16_t *dict;    /* 沿失败链最近的有输出的状态，0 表示无 */
+	uint8_t *flag;     /* 该状态或其失败链上有输出 */
+	int state_count;
+	int state;         /* 当前状态 */
+
+	/* 数据流 */
+	uint64_t offset;   /* 已扫描的字节数 */
+	uint8_t *history;  /* 最近的数据，大小为 history_size（2 的幂） */
+	size_t history_size;
+	trigger_pending_t pending[TRIGGER_MAX_PENDING];
+	int pending_count;
+
+	/* 统计和状态 */
+	long matches;
+	long snapshots_dropped; /* 等待中的 snapshot 太多时丢弃的个数 */
+	long hooks_started;
+	long hooks_skipped;     /* 上一个 hook 还没结束时跳过的次数 */
+	pid_t hook_pid;
+	int fired_exit;         /* 已因 exit 动作请求退出 */
+	outbuf_t *out_buf;
+} trigger_t;
+
+/*
+ * 初始化触发器
+ * 参数: port - 端口名，传给 hook
+ * 返回: 0 成功, -1 失败
+ */
+int trigger_init(trigger_t *t, const char *port);
+
+/*
+ * 添加一个模式
+ * 参数: spec - ASCII 字符串，或 "hex:" 开头的 16 进制字节，如 hex:0d0a
+ * 返回: 0 成功, -1 失败
+ */
+int trigger_add_pattern(trigger_t *t, const char *spec);
+
+/*
+ * 添加一个匹配动作
+ * 参数: spec - log / exit[:code] / hook:<cmd> / snapshot[:N]
+ *       hook 命令通过 /bin/sh -c 执行，环境变量 UART_TRIGGER_PATTERN、UART_TRIGGER_OFFSET、
+ *       UART_TRIGGER_TIME、UART_PORT 描述匹配；上一个 hook 未结束时跳过本次
+ * 返回: 0 成功, -1 失败
+ */
+int trigger_add_action(trigger_t *t, const char *spec);
+
+/*
+ * 根据已添加的模式生成自动机，没有添加动作时默认为 log
+ * 返回: 0 成功, -1 失败
+ */
+int trigger_compile(trigger_t *t);
+
+/*
+ * 依次添加模式和动作并生成自动机，失败时释放已分配的资源
+ * 参数: patterns, pattern_count - --trigger 参数
+ *       actions, action_count - --on-match 参数
+ * 返回: 0 成功, -1 失败
+ */
+int trigger_setup(trigger_t *t, const char *port, char *const *patterns, int pattern_count,
+                  char *const *actions, int action_count);
+
+/*
+ * 扫描一个数据块
+ * 参数: data, len - 数据块
+ *       realtime_ns - 收到数据块的时间（CLOCK_REALTIME），用于打印和 hook
+ * 返回: 1 exit 动作请求退出, 0 继续
+ */
+int trigger_push(trigger_t *t, const char *data, size_t len, int64_t realtime_ns);
+
+/*
+ * 输出尚未收齐后续数据的 snapshot，等待 hook 结束，打印统计
+ */
+void trigger_finish(trigger_t *t);
+
+/*
+ * 释放触发器
+ */
+void trigger_free(trigger_t *t);
+
+#endif /* __TRIGGER_H__ */
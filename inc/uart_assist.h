@@ -10,9 +10,21 @@ Free Software Foundation.
 #define __UART_ASSIST_H__
 
 #include "args_parser.h"
+#include "trigger.h"
 #include "uartdev.h"
+#include <stdint.h>
 
-#define RECV_TIMEOUT_SEC 2 /* 接收超时时间（秒） */
+#define RECV_TIMEOUT_SEC 2   /* 接收超时时间（秒） */
+#define RECV_CHUNK_SIZE 4096 /* 接收线程单次读取的最大字节数 */
+#define RECV_RING_SLOTS 256  /* 接收环形缓冲区的块数（2 的幂） */
+#define UART_BAUD_TOLERANCE 2.0 /* 实际波特率误差超过该百分比时报警 */
+
+/* 接收线程放入环形缓冲区的数据块 */
+typedef struct {
+	int64_t ts_ns; /* 收到数据的时间（CLOCK_MONOTONIC，纳秒） */
+	int len;       /* 数据长度，0 表示接收超时事件 */
+	char data[RECV_CHUNK_SIZE];
+} recv_chunk_t;
 
 /*
  * 解析hex字符串并转换为字节数组
@@ -39,26 +51,42 @@ int uart_loopback_test(uartdev_t *dev, const char *send_str, output_format_t for
  *       interval_ms - 发送间隔（毫秒）
  *       count - 发送次数（0=无限）
  *       format - 发送格式（ASCII/HEX）
+ *       checksum_spec - 校验算法（见 checksum.h），不为 NULL 时在数据后追加校验值
  * 返回: 0 成功, -1 失败
  */
 int uart_send_test(uartdev_t *dev, const char *send_str, int interval_ms, int count,
-                   output_format_t format);
+                   output_format_t format, const char *checksum_spec);
 
 /*
- * 接收模式：持续接收并打印数据
+ * 接收模式：接收线程把带时间戳的数据块放入无锁 SPSC 环形缓冲区，
+ * 主线程负责格式化和打印，输出慢时不会阻塞接收。
+ * 缓冲区满时丢弃数据并计数，退出时报告缓冲区高水位和丢弃统计。
  * 参数: dev - 串口设备
  *       format - 打印格式（ASCII/HEX）
+ *       capture_file - 抓包文件，不为 NULL 时数据写入该文件（见 capture.h），
+ *                      终端只每秒打印一次统计
+ *       frame_spec - 分帧规则（见 framer.h），不为 NULL 时按帧打印，否则按每次读到的数据打印
+ *       checksum_spec - 校验算法（见 checksum.h），不为 NULL 时检查每帧末尾的校验值，
+ *                       需要同时指定 frame_spec，否则返回 -1 并设置 errno 为 EINVAL
+ *       trigger - 已生成的触发器（见 trigger.h），不为 NULL 时在打印、分帧或抓包之后扫描
+ *                 每个原始数据块，exit 动作匹配时停止接收，由调用者根据
+ *                 trigger->fired_exit 决定退出码
  * 返回: 0 成功, -1 失败
  */
-int uart_recv_test(uartdev_t *dev, output_format_t format);
+int uart_recv_test(uartdev_t *dev, output_format_t format, const char *capture_file,
+                   const char *frame_spec, const char *checksum_spec, trigger_t *trigger);
 
 /*
  * 文件模式：根据JSON配置文件发送数据
  * 参数: dev - 串口设备
  *       json_file - JSON配置文件路径
- * 返回: 0 成功, -1 失败
+ *       spin_us - 每次延时最后忙等的微秒数，0 表示只睡眠
+ *       checksum_spec - 校验算法（见 checksum.h），不为 NULL 时在每项数据后追加校验值
+ *       timeout_ms - 未设置 Timeout 的项等待响应（ExpectHex）的超时，见 expect.h
+ * 返回: 0 成功, -1 失败或有项未收到期望的响应
  */
-int uart_file_test(uartdev_t *dev, const char *json_file);
+int uart_file_test(uartdev_t *dev, const char *json_file, int spin_us,
+                   const char *checksum_spec, int timeout_ms);
 
 /*
  * 带超时的接收数据
@@ -71,7 +99,7 @@ int uart_file_test(uartdev_t *dev, const char *json_file);
 int uart_recv_with_timeout(uartdev_t *dev, char *buf, int len, int timeout_sec);
 
 /*
- * 打印时间戳
+ * 打印当前时间戳
  */
 void print_timestamp(void);
 
@@ -85,4 +113,10 @@ void print_ascii(const char *buf, int len);
  */
 void print_hex(const char *buf, int len);
 
+/*
+ * 打印驱动实际设置的波特率及其与请求值的误差，
+ * 只在请求非标准波特率或实际值与请求值不同时打印
+ */
+void print_baud_info(const uartdev_t *dev);
+
 #endif /* __UART_ASSIST_H__ */
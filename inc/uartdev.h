@@ -12,6 +12,7 @@ Free Software Foundation.
 #include "mydebug.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,6 +22,8 @@ Free Software Foundation.
 #include <unistd.h>
 
 #define UARTDEV_INVALID_FD -1
+/* Interval at which uartdev_send_all() rechecks its run flag while the port cannot accept data */
+#define UARTDEV_SEND_POLL_MS 100
 
 typedef struct _uartdev_t {
 	/* Device descriptor, the return value of open the serial port */
@@ -35,9 +38,43 @@ typedef struct _uartdev_t {
 	char parity;
 	/* Stop bit: 1, 2 */
 	uint8_t stop_bit;
+	/* Rate granted by the driver, read back after uartdev_setup(), 0 if unknown */
+	int actual_baud;
 
 } uartdev_t;
 
+/*
+Linux termios2 interface for arbitrary integer baud rates (BOTHER).
+<asm/termbits.h> cannot be included together with <termios.h>, so the
+generic kernel layout is declared here. Architectures with a different
+termios2 layout (alpha, mips, powerpc, sparc) only get the Bxxx rates.
+*/
+#if defined(__linux__) &&                                                                          \
+    (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__arm__) ||      \
+     defined(__riscv) || defined(__loongarch__))
+#include <sys/ioctl.h>
+#define UARTDEV_HAVE_TERMIOS2 1
+
+struct uartdev_termios2 {
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+
+#define UARTDEV_TCGETS2 _IOR('T', 0x2A, struct uartdev_termios2)
+#define UARTDEV_TCSETS2 _IOW('T', 0x2B, struct uartdev_termios2)
+#define UARTDEV_CBAUD 0010017
+#define UARTDEV_BOTHER 0010000
+#define UARTDEV_IBSHIFT 16
+#else
+#define UARTDEV_HAVE_TERMIOS2 0
+#endif
+
 /* Converts integer baud to Linux define */
 static inline int _get_baud(int baud)
 {
@@ -105,6 +142,30 @@ static inline int _get_baud(int baud)
 	}
 }
 
+/*
+Number of bits on the line for one character: start bit, data bits,
+optional parity bit and stop bits. For example 10 for 8N1.
+*/
+static inline int uartdev_frame_bits(const uartdev_t *dev)
+{
+	int bits = 1 + dev->data_bit + dev->stop_bit;
+
+	if (dev->parity != 'N' && dev->parity != 'n') {
+		bits++;
+	}
+
+	return bits;
+}
+
+/* Time to transmit one character at the current baud rate, in nanoseconds */
+static inline int64_t uartdev_char_time_ns(const uartdev_t *dev)
+{
+	if (dev->baud <= 0)
+		return 0;
+
+	return (int64_t)uartdev_frame_bits(dev) * 1000000000LL / dev->baud;
+}
+
 /* Free UART device memory */
 static inline void _uartdev_free(uartdev_t *dev)
 {
@@ -123,7 +184,7 @@ Create a new UART device structure , allocate memory and initialize it.
 If the creation fails, it will return a null pointer，and set the errno.
 
 arguments : const char *port , UART device file name ,"/dev/ttyS1",
-"/dev/ttyUSB0" int baud , 1200 ~ 4000000 char parity , 'N'/'n', 'O'/'o', 'E'/'e'
+"/dev/ttyUSB0" int baud , 1200 ~ 4000000, or any rate with termios2 char parity , 'N'/'n', 'O'/'o', 'E'/'e'
           int data_bit , data bit , 5, 6, 7, 8
           int stop_bit , stop bit , 1 or 2
 */
@@ -140,8 +201,8 @@ static inline uartdev_t *uartdev_new(const char *port, int baud, int data_bit, c
 		return NULL;
 	}
 
-	/* Check baud argument */
-	if (_get_baud(baud) < 0) {
+	/* Check baud argument, any positive rate is accepted with termios2 */
+	if (baud <= 0 || (!UARTDEV_HAVE_TERMIOS2 && _get_baud(baud) < 0)) {
 		errno = EINVAL;
 		return NULL;
 	}
@@ -209,6 +270,7 @@ static inline uartdev_t *uartdev_new(const char *port, int baud, int data_bit, c
 
 	/* fd init */
 	dev->fd = UARTDEV_INVALID_FD;
+	dev->actual_baud = 0;
 
 	pr_debug("new uartdev_t, %s, %d, %d%c%d\n", dev->port, dev->baud, dev->data_bit,
 	         dev->parity, dev->stop_bit);
@@ -237,6 +299,54 @@ static inline int uartdev_del(uartdev_t *dev)
 	return 0;
 }
 
+/*
+Set a non-standard rate with termios2/BOTHER, then read back the rate the
+driver actually granted into dev->actual_baud. For standard rates a driver
+without TCGETS2 support just leaves actual_baud at 0.
+If successful return 0, otherwise a negative errno.
+*/
+static inline int _uartdev_set_speed2(uartdev_t *dev)
+{
+#if UARTDEV_HAVE_TERMIOS2
+	struct uartdev_termios2 tio2;
+
+	if (ioctl(dev->fd, UARTDEV_TCGETS2, &tio2) < 0) {
+		return _get_baud(dev->baud) < 0 ? -errno : 0;
+	}
+
+	if (_get_baud(dev->baud) < 0) {
+		tio2.c_cflag &= ~(UARTDEV_CBAUD | (UARTDEV_CBAUD << UARTDEV_IBSHIFT));
+		tio2.c_cflag |= UARTDEV_BOTHER | (UARTDEV_BOTHER << UARTDEV_IBSHIFT);
+		tio2.c_ispeed = dev->baud;
+		tio2.c_ospeed = dev->baud;
+		if (ioctl(dev->fd, UARTDEV_TCSETS2, &tio2) < 0) {
+			return -errno;
+		}
+		if (ioctl(dev->fd, UARTDEV_TCGETS2, &tio2) < 0) {
+			return -errno;
+		}
+	}
+
+	dev->actual_baud = (int)tio2.c_ospeed;
+#else
+	(void)dev;
+#endif
+
+	return 0;
+}
+
+/*
+Relative error of the granted rate against the requested one, in percent.
+Returns 0 if the granted rate is unknown.
+*/
+static inline double uartdev_baud_error(const uartdev_t *dev)
+{
+	if (dev->actual_baud <= 0 || dev->baud <= 0)
+		return 0.0;
+
+	return (dev->actual_baud - dev->baud) * 100.0 / dev->baud;
+}
+
 /*
 Open serial port and set the attributes use uartdev_t *dev。
 If successful return 0, otherwise errno is returned.
@@ -293,8 +403,9 @@ static inline int uartdev_setup(uartdev_t *dev)
 	}
 	*/
 
-	/* Stores baud speed to c_ispeed and c_ospeed of newtio*/
-	cfsetspeed(&newtio, _get_baud(dev->baud));
+	/* Stores baud speed to c_ispeed and c_ospeed of newtio.
+	    Non-standard rates are set with termios2 below, B38400 is a placeholder */
+	cfsetspeed(&newtio, _get_baud(dev->baud) < 0 ? B38400 : _get_baud(dev->baud));
 
 	/*
 	CLOCAL       Local line - do not change "owner" of port
@@ -436,6 +547,11 @@ static inline int uartdev_setup(uartdev_t *dev)
 		return -errno;
 	}
 
+	ret = _uartdev_set_speed2(dev);
+	if (ret) {
+		return ret;
+	}
+
 	/* Clear O_NDELAY flag to allow poll() to work correctly */
 	flags = fcntl(dev->fd, F_GETFL, 0);
 	if (flags < 0) {
@@ -463,6 +579,55 @@ static inline int uartdev_send(uartdev_t *dev, const char *buf, int len)
 	return write(dev->fd, buf, len);
 }
 
+/*
+Send all len bytes, retrying on partial writes and EINTR. When the output buffer
+is full, wait with poll() for up to UARTDEV_SEND_POLL_MS at a time and give up
+once *running is cleared, so a flow-controlled or stalled port can be
+interrupted. running may be NULL to wait indefinitely.
+If successful return len, otherwise -1 is returned and errno is set
+(EINTR when stopped through running).
+*/
+static inline int uartdev_send_all(uartdev_t *dev, const char *buf, int len,
+                                   const volatile int *running)
+{
+	struct pollfd pfd;
+	int done = 0;
+	int n;
+
+	if (dev == NULL || buf == NULL || len < 0 || dev->fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	while (done < len) {
+		n = write(dev->fd, buf + done, len - done);
+		if (n == len - done) {
+			return len;
+		}
+		if (n > 0) {
+			done += n;
+		} else if (n == 0) {
+			errno = EIO;
+			return -1;
+		} else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+			return -1;
+		}
+
+		/* Short write, full buffer or signal: check the run flag, then wait for room */
+		if (running != NULL && !*running) {
+			errno = EINTR;
+			return -1;
+		}
+		pfd.fd = dev->fd;
+		pfd.events = POLLOUT;
+		if (poll(&pfd, 1, UARTDEV_SEND_POLL_MS) < 0 && errno != EINTR) {
+			return -1;
+		}
+	}
+
+	return len;
+}
+
 /*
 Receive data of specified length
 */
@@ -476,6 +641,33 @@ static inline int uartdev_recv(uartdev_t *dev, char *buf, int len)
 	return read(dev->fd, buf, len);
 }
 
+/*
+Enable or disable non-blocking I/O on the opened serial port.
+If successful return 0, otherwise -1 is returned and errno is set.
+*/
+static inline int uartdev_set_nonblock(uartdev_t *dev, int enable)
+{
+	int flags;
+
+	if (dev == NULL || dev->fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	flags = fcntl(dev->fd, F_GETFL, 0);
+	if (flags < 0) {
+		return -1;
+	}
+
+	if (enable) {
+		flags |= O_NONBLOCK;
+	} else {
+		flags &= ~O_NONBLOCK;
+	}
+
+	return fcntl(dev->fd, F_SETFL, flags);
+}
+
 /*
 Clear the data buffer of serial port, both receiving and sending
 */
@@ -8,7 +8,10 @@ Free Software Foundation.
 
 #include "args_parser.h"
 #include "Config.h"
+#include "checksum.h"
+#include "framer.h"
 #include "mydebug.h"
+#include "trigger.h"
 #include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
@@ -25,6 +28,33 @@ Free Software Foundation.
 #define DEFAULT_SEND_INTERVAL 1000
 #define DEFAULT_SEND_COUNT 0
 #define DEFAULT_FORMAT OUTPUT_ASCII
+#define DEFAULT_DURATION 10
+#define DEFAULT_PRBS_ORDER 7
+#define MAX_SPIN_US 10000
+#define DEFAULT_TIMEOUT 1000
+#define MAX_LATENCY_TIMER 255
+
+/* 只有长选项的参数，取值避开短选项字符 */
+enum {
+	OPT_SPIN = 256,
+	OPT_CAPTURE,
+	OPT_SPEED,
+	OPT_SEND_FILE,
+	OPT_LOW_LATENCY,
+	OPT_LATENCY_TIMER,
+	OPT_TIMEOUT,
+	OPT_FRAME,
+	OPT_CHECKSUM,
+	OPT_TRIGGER,
+	OPT_ON_MATCH,
+	OPT_PEER,
+	OPT_TAP,
+	OPT_LISTEN,
+	OPT_METRICS,
+	OPT_METRICS_FORMAT,
+	OPT_METRICS_INTERVAL,
+	OPT_TRACE,
+};
 
 static const struct option long_options[] = {{"device", required_argument, 0, 'd'},
                                              {"baud", required_argument, 0, 'b'},
@@ -35,9 +65,139 @@ static const struct option long_options[] = {{"device", required_argument, 0, 'd
                                              {"count", required_argument, 0, 'n'},
                                              {"format", required_argument, 0, 'f'},
                                              {"file", required_argument, 0, 'F'},
+                                             {"port-list", required_argument, 0, 'l'},
+                                             {"duration", required_argument, 0, 't'},
+                                             {"prbs", required_argument, 0, 'p'},
+                                             {"spin", required_argument, 0, OPT_SPIN},
+                                             {"capture", required_argument, 0, OPT_CAPTURE},
+                                             {"speed", required_argument, 0, OPT_SPEED},
+                                             {"send-file", required_argument, 0, OPT_SEND_FILE},
+                                             {"low-latency", no_argument, 0, OPT_LOW_LATENCY},
+                                             {"latency-timer", required_argument, 0,
+                                              OPT_LATENCY_TIMER},
+                                             {"timeout", required_argument, 0, OPT_TIMEOUT},
+                                             {"frame", required_argument, 0, OPT_FRAME},
+                                             {"checksum", required_argument, 0, OPT_CHECKSUM},
+                                             {"trigger", required_argument, 0, OPT_TRIGGER},
+                                             {"on-match", required_argument, 0, OPT_ON_MATCH},
+                                             {"peer", required_argument, 0, OPT_PEER},
+                                             {"tap", no_argument, 0, OPT_TAP},
+                                             {"listen", required_argument, 0, OPT_LISTEN},
+                                             {"quiet", no_argument, 0, 'q'},
+                                             {"metrics", required_argument, 0, OPT_METRICS},
+                                             {"metrics-format", required_argument, 0,
+                                              OPT_METRICS_FORMAT},
+                                             {"metrics-interval", required_argument, 0,
+                                              OPT_METRICS_INTERVAL},
+                                             {"trace", required_argument, 0, OPT_TRACE},
                                              {"help", no_argument, 0, 'h'},
                                              {0, 0, 0, 0}};
 
+/* 向设备列表追加一个设备名 */
+static int add_device(uart_config_t *config, const char *name, int len)
+{
+	char **devices;
+	char *dev;
+
+	if (len <= 0) {
+		return 0;
+	}
+
+	devices = realloc(config->devices, (config->device_count + 1) * sizeof(char *));
+	if (devices == NULL) {
+		pr_error("Failed to allocate memory for device list\n");
+		return -1;
+	}
+	config->devices = devices;
+
+	dev = strndup(name, len);
+	if (dev == NULL) {
+		pr_error("Failed to allocate memory for device name\n");
+		return -1;
+	}
+	config->devices[config->device_count++] = dev;
+	config->device = config->devices[0];
+
+	return 0;
+}
+
+/* 向字符串列表追加一项，用于可重复的选项 */
+static int add_string(char ***list, int *count, const char *str)
+{
+	char **items;
+
+	items = realloc(*list, (*count + 1) * sizeof(char *));
+	if (items == NULL) {
+		pr_error("Failed to allocate memory for option list\n");
+		return -1;
+	}
+	*list = items;
+
+	items[*count] = strdup(str);
+	if (items[*count] == NULL) {
+		pr_error("Failed to allocate memory for option list\n");
+		return -1;
+	}
+	(*count)++;
+
+	return 0;
+}
+
+/* 解析逗号分隔的设备列表，如 "/dev/ttyUSB0,/dev/ttyUSB1" */
+static int parse_device_list(uart_config_t *config, const char *str)
+{
+	const char *p = str;
+	const char *sep;
+
+	while (*p) {
+		sep = strchr(p, ',');
+		if (sep == NULL) {
+			return add_device(config, p, strlen(p));
+		}
+		if (add_device(config, p, sep - p) < 0) {
+			return -1;
+		}
+		p = sep + 1;
+	}
+
+	return 0;
+}
+
+/* 从端口列表文件读取设备，每行一个设备，'#' 开头为注释 */
+static int parse_port_list_file(uart_config_t *config, const char *filename)
+{
+	FILE *fp;
+	char line[256];
+	char *start, *end;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		pr_error("Failed to open port list file: %s\n", filename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		start = line;
+		while (isspace((unsigned char)*start)) {
+			start++;
+		}
+		if (*start == '#' || *start == '\0') {
+			continue;
+		}
+		end = start + strlen(start);
+		while (end > start && isspace((unsigned char)end[-1])) {
+			end--;
+		}
+		if (add_device(config, start, end - start) < 0) {
+			fclose(fp);
+			return -1;
+		}
+	}
+
+	fclose(fp);
+	return 0;
+}
+
 int parse_uart_config(const char *str, int *data_bit, char *parity, int *stop_bit)
 {
 	int len;
@@ -103,15 +263,37 @@ void print_usage(const char *program_name)
 	printf("\n");
 	printf("Common Options (all modes):\n");
 	printf("  -m, --mode <mode>          Working mode: "
-	       "loopback/send/recv/file (required)\n");
+	       "loopback/send/recv/file/bench/prbs/replay/ping/modbus/bridge/server (required)\n");
 	printf("  -d, --device <device>       Serial port device (default: %s)\n", DEFAULT_DEVICE);
-	printf("  -b, --baud <baudrate>      Baud rate (default: %d)\n", DEFAULT_BAUD);
+	printf("                            Comma separated list for multi-port, "
+	       "e.g. /dev/ttyUSB0,/dev/ttyUSB1\n");
+	printf("  -l, --port-list <file>     Read serial port devices from file, "
+	       "one per line\n");
+	printf("  -b, --baud <baudrate>      Baud rate, any integer such as 250000 "
+	       "(default: %d)\n",
+	       DEFAULT_BAUD);
 	printf("  -c, --config <config>      UART config, format: databits "
 	       "parity stopbits (default: %d%c%d)\n",
 	       DEFAULT_DATA_BIT, DEFAULT_PARITY, DEFAULT_STOP_BIT);
 	printf("                            Examples: 8N1, 7E1, 8O2\n");
+	printf("      --low-latency          Set ASYNC_LOW_LATENCY on the port driver\n");
+	printf("      --latency-timer <ms>   Set latency_timer of FTDI-style USB adapters, "
+	       "1-%d\n",
+	       MAX_LATENCY_TIMER);
 	printf("  -h, --help                 Show this help message\n");
 	printf("\n");
+	printf("Quiet Mode and Metrics (send, recv and file modes):\n");
+	printf("  -q, --quiet                Do not print every packet, only summaries\n");
+	printf("      --metrics <file>       Export per-port counters periodically to <file>\n");
+	printf("      --metrics-format <fmt> json (one line appended per export) or prom\n");
+	printf("                            (Prometheus textfile, replaced atomically) "
+	       "(default: json)\n");
+	printf("      --metrics-interval <s> Export interval in seconds, 1-%d (default: %d)\n",
+	       METRICS_MAX_INTERVAL, METRICS_DEFAULT_INTERVAL);
+	printf("      --trace <file>         Record hot-path spans and write Chrome trace JSON "
+	       "at exit\n");
+	printf("                            (needs a build with -DENABLE_TRACE=ON)\n");
+	printf("\n");
 	printf("Loopback Mode Options:\n");
 	printf("  -s, --send <string>        Send string for loopback test "
 	       "(default: %s)\n",
@@ -133,21 +315,149 @@ void print_usage(const char *program_name)
 	       "ascii)\n");
 	printf("                            If hex, string is parsed as hex "
 	       "(e.g., af37126b4A = 5 bytes)\n");
+	printf("      --send-file <file>     Stream a file of any size once, "
+	       "-s/-i/-n/-f are ignored\n");
+	printf("      --checksum <alg>       Append a checksum to the data, see below\n");
 	printf("\n");
 	printf("Receive Mode Options:\n");
 	printf("  -f, --format <format>      Output format: ascii/hex "
 	       "(default: ascii)\n");
+	printf("      --capture <file>       Write received data to a binary capture file "
+	       "with ns timestamps\n");
+	printf("                            instead of printing it\n");
+	printf("      --frame <rule>         Split the stream into frames before printing:\n");
+	printf("                              idle:<chars>  gap of <chars> character times, "
+	       "e.g. idle:3.5\n");
+	printf("                              delim:<hex>   delimiter, kept in the frame, "
+	       "e.g. delim:0d0a\n");
+	printf("                              len:<off>:<1|2|4>[be|le][:<extra>]  length field "
+	       "at <off>,\n");
+	printf("                                            frame = off + size + value + extra "
+	       "(default be)\n");
+	printf("                              fixed:<n>     <n> bytes per frame\n");
+	printf("      --checksum <alg>       Verify the checksum at the end of every frame "
+	       "(needs --frame)\n");
+	printf("      --trigger <pattern>    Watch the stream for a pattern, repeatable (max %d), "
+	       "text or\n",
+	       TRIGGER_MAX_PATTERNS);
+	printf("                            hex:<bytes>, e.g. --trigger ERROR --trigger hex:0d0a\n");
+	printf("      --on-match <action>    Action on every match, repeatable (default: log):\n");
+	printf("                              log           print the pattern, timestamp and "
+	       "offset\n");
+	printf("                              exit[:code]   stop receiving and exit with code "
+	       "(default 0)\n");
+	printf("                              hook:<cmd>    run <cmd> with sh, env UART_TRIGGER_* "
+	       "and UART_PORT\n");
+	printf("                              snapshot[:N]  hex dump of N bytes before and after "
+	       "(default %d)\n",
+	       TRIGGER_SNAPSHOT_DEFAULT);
 	printf("\n");
 	printf("File Mode Options:\n");
 	printf("  -F, --file <json file>     JSON configuration file "
 	       "(required)\n");
+	printf("      --spin <us>            Busy-wait the last <us> of each delay for "
+	       "accurate short delays, 0-%d (default: 0)\n",
+	       MAX_SPIN_US);
+	printf("      --checksum <alg>       Append a checksum to every item\n");
+	printf("      --timeout <ms>         Response timeout for items with ExpectHex and no "
+	       "Timeout (default: %d)\n",
+	       DEFAULT_TIMEOUT);
+	printf("\n");
+	printf("Checksum algorithms (--checksum):\n");
+	printf("  crc8, crc8-maxim, crc16-modbus, crc16-ccitt, crc16-xmodem, crc32, crc32c,\n");
+	printf("  sum8, sum16, xor8, or crc<8|16|32>:<poly>[:<init>[:<xorout>[:r]]] "
+	       "(r = reflected)\n");
+	printf("  Reflected CRCs are sent low byte first, others high byte first\n");
+	printf("\n");
+	printf("Replay Mode Options:\n");
+	printf("  -F, --file <capture file>  Capture file written by recv --capture "
+	       "(required)\n");
+	printf("      --speed <factor>       Time scale, 1 = original timing, 2 = twice as "
+	       "fast,\n");
+	printf("                            0 = as fast as possible (default: 1)\n");
+	printf("\n");
+	printf("Ping Mode Options (Tx and Rx shorted, or remote echo):\n");
+	printf("  -s, --send <string>        Request payload (default: %s)\n", DEFAULT_SEND_STRING);
+	printf("  -f, --format <format>      Payload format: ascii/hex (default: ascii)\n");
+	printf("  -i, --interval <ms>        Interval between requests, 1-10000 "
+	       "(default: %d)\n",
+	       DEFAULT_SEND_INTERVAL);
+	printf("  -n, --count <count>        Request count, 0 means infinite (default: %d)\n",
+	       DEFAULT_SEND_COUNT);
+	printf("      --timeout <ms>         Echo timeout in milliseconds (default: %d)\n",
+	       DEFAULT_TIMEOUT);
+	printf("\n");
+	printf("Modbus Mode Options (RTU master):\n");
+	printf("  -s, --send <requests>      Requests to poll in turn, comma separated "
+	       "slave:function:address:count,\n");
+	printf("                            function 1-4, e.g. 1:3:0:10,2:4:100:2 (required)\n");
+	printf("  -t, --duration <sec>       Test duration in seconds, 0 means until "
+	       "Ctrl+C (default: %d)\n",
+	       DEFAULT_DURATION);
+	printf("      --timeout <ms>         Response timeout in milliseconds (default: %d)\n",
+	       DEFAULT_TIMEOUT);
+	printf("\n");
+	printf("Bridge Mode Options (forward data between the port and a peer until Ctrl+C):\n");
+	printf("      --peer <peer>          Other end of the bridge (required):\n");
+	printf("                              <device>      another serial port, opened with "
+	       "the same -b/-c\n");
+	printf("                              pty[:<link>]  a new pty for legacy programs, "
+	       "optionally\n");
+	printf("                                            symlinked as <link>\n");
+	printf("      --tap                  Print the forwarded data in -f format\n");
+	printf("  -f, --format <format>      Tap output format: ascii/hex (default: ascii)\n");
+	printf("      --capture <file>       Write both directions to a capture file, "
+	       "port Rx as rx\n");
+	printf("                            and data sent to the port as tx\n");
+	printf("\n");
+	printf("Server Mode Options (serial port over TCP until Ctrl+C):\n");
+	printf("      --listen <[addr:]port> TCP address to listen on, all addresses if addr "
+	       "is omitted (required)\n");
+	printf("                            Port data goes to every client, client data is "
+	       "written to the port\n");
+	printf("\n");
+	printf("Bench Mode Options (Tx and Rx shorted):\n");
+	printf("  -t, --duration <sec>       Test duration in seconds, 0 means until "
+	       "Ctrl+C (default: %d)\n",
+	       DEFAULT_DURATION);
+	printf("\n");
+	printf("PRBS Mode Options (Tx and Rx shorted, 8 data bits):\n");
+	printf("  -p, --prbs <order>         PRBS pattern: 7/15/23/31 (default: %d)\n",
+	       DEFAULT_PRBS_ORDER);
+	printf("  -t, --duration <sec>       Test duration in seconds, 0 means until "
+	       "Ctrl+C (default: %d)\n",
+	       DEFAULT_DURATION);
 	printf("\n");
 	printf("Examples:\n");
 	printf("  %s -m loopback -d /dev/ttyUSB0 -s \"Hello\"\n", program_name);
 	printf("  %s -m loopback -d /dev/ttyUSB0 -s \"af37126b4A\" -f hex\n", program_name);
 	printf("  %s -m send -d /dev/ttyUSB0 -s \"Hello\" -i 500 -n 10\n", program_name);
 	printf("  %s -m send -d /dev/ttyUSB0 -s \"af37126b4A\" -f hex -i 1000\n", program_name);
+	printf("  %s -m send -d /dev/ttyUSB0 -s \"010300000001\" -f hex --checksum "
+	       "crc16-modbus\n",
+	       program_name);
+	printf("  %s -m send -d /dev/ttyUSB0 -b 921600 --send-file firmware.bin\n", program_name);
 	printf("  %s -m recv -d /dev/ttyUSB0 -f hex\n", program_name);
+	printf("  %s -m recv -d /dev/ttyUSB0 -b 921600 --capture rx.cap\n", program_name);
+	printf("  %s -m recv -d /dev/ttyUSB0 -b 9600 -f hex --frame idle:3.5\n", program_name);
+	printf("  %s -m recv -d /dev/ttyUSB0 --trigger \"Kernel panic\" --on-match snapshot:256 "
+	       "--on-match exit:1\n",
+	       program_name);
+	printf("  %s -m recv -d /dev/ttyUSB0,/dev/ttyUSB1,/dev/ttyUSB2\n", program_name);
+	printf("  %s -m replay -d /dev/ttyUSB1 -b 921600 -F rx.cap --speed 1\n", program_name);
+	printf("  %s -m ping -d /dev/ttyUSB0 -b 921600 -i 10 -n 1000 --low-latency "
+	       "--latency-timer 1\n",
+	       program_name);
+	printf("  %s -m modbus -d /dev/ttyUSB0 -b 19200 -c 8E1 -s 1:3:0:10,2:4:100:2 "
+	       "--timeout 100\n",
+	       program_name);
+	printf("  %s -m bridge -d /dev/ttyUSB0 -b 115200 --peer pty:/tmp/ttyV0\n", program_name);
+	printf("  %s -m server -d /dev/ttyUSB0 -b 115200 --listen 0.0.0.0:4001\n", program_name);
+	printf("  %s -m recv -d /dev/ttyUSB0 -b 921600 -q --metrics /var/lib/node_exporter/uart.prom "
+	       "--metrics-format prom\n",
+	       program_name);
+	printf("  %s -m bench -d /dev/ttyUSB0 -b 921600 -t 30\n", program_name);
+	printf("  %s -m prbs -d /dev/ttyUSB0 -b 4000000 -p 23 -t 0\n", program_name);
 }
 
 int parse_args(int argc, char *argv[], uart_config_t *config)
@@ -159,6 +469,9 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 	char parity = DEFAULT_PARITY;
 	int stop_bit = DEFAULT_STOP_BIT;
 	int mode_set = 0;
+	frame_rule_t rule;
+	checksum_t *cs;
+	trigger_t *trig;
 
 	if (config == NULL) {
 		errno = EINVAL;
@@ -167,6 +480,8 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 
 	/* 初始化默认值 */
 	config->device = NULL;
+	config->devices = NULL;
+	config->device_count = 0;
 	config->baud = DEFAULT_BAUD;
 	config->data_bit = DEFAULT_DATA_BIT;
 	config->parity = DEFAULT_PARITY;
@@ -177,15 +492,41 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 	config->send_count = DEFAULT_SEND_COUNT;
 	config->format = DEFAULT_FORMAT;
 	config->json_file = NULL;
+	config->duration = DEFAULT_DURATION;
+	config->prbs_order = DEFAULT_PRBS_ORDER;
+	config->spin_us = 0;
+	config->capture_file = NULL;
+	config->speed = 1.0;
+	config->send_file = NULL;
+	config->low_latency = 0;
+	config->latency_timer = 0;
+	config->timeout_ms = DEFAULT_TIMEOUT;
+	config->frame_spec = NULL;
+	config->checksum_spec = NULL;
+	config->triggers = NULL;
+	config->trigger_count = 0;
+	config->actions = NULL;
+	config->action_count = 0;
+	config->peer = NULL;
+	config->tap = 0;
+	config->listen = NULL;
+	config->quiet = 0;
+	config->metrics_file = NULL;
+	config->metrics_format = METRICS_JSON;
+	config->metrics_interval = METRICS_DEFAULT_INTERVAL;
+	config->trace_file = NULL;
 
-	while ((opt = getopt_long(argc, argv, "d:b:c:m:s:i:n:f:F:h", long_options,
+	while ((opt = getopt_long(argc, argv, "d:b:c:m:s:i:n:f:F:l:t:p:qh", long_options,
 	                          &option_index)) != -1) {
 		switch (opt) {
 		case 'd':
-			config->device = strdup(optarg);
-			if (config->device == NULL) {
-				pr_error("Failed to allocate memory for device "
-				         "name\n");
+			if (parse_device_list(config, optarg) < 0) {
+				return -1;
+			}
+			break;
+
+		case 'l':
+			if (parse_port_list_file(config, optarg) < 0) {
 				return -1;
 			}
 			break;
@@ -216,9 +557,23 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 				config->mode = MODE_RECV;
 			} else if (strcmp(optarg, "file") == 0) {
 				config->mode = MODE_FILE;
+			} else if (strcmp(optarg, "bench") == 0) {
+				config->mode = MODE_BENCH;
+			} else if (strcmp(optarg, "prbs") == 0) {
+				config->mode = MODE_PRBS;
+			} else if (strcmp(optarg, "replay") == 0) {
+				config->mode = MODE_REPLAY;
+			} else if (strcmp(optarg, "ping") == 0) {
+				config->mode = MODE_PING;
+			} else if (strcmp(optarg, "modbus") == 0) {
+				config->mode = MODE_MODBUS;
+			} else if (strcmp(optarg, "bridge") == 0) {
+				config->mode = MODE_BRIDGE;
+			} else if (strcmp(optarg, "server") == 0) {
+				config->mode = MODE_SERVER;
 			} else {
 				pr_error("Invalid mode: %s (should be "
-				         "loopback/send/recv/file)\n",
+				         "loopback/send/recv/file/bench/prbs/replay/ping/modbus/bridge/server)\n",
 				         optarg);
 				return -1;
 			}
@@ -266,6 +621,185 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 			}
 			break;
 
+		case 't':
+			config->duration = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' || config->duration < 0) {
+				pr_error("Invalid duration: %s (should be >= 0)\n", optarg);
+				return -1;
+			}
+			break;
+
+		case 'p':
+			config->prbs_order = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' ||
+			    (config->prbs_order != 7 && config->prbs_order != 15 &&
+			     config->prbs_order != 23 && config->prbs_order != 31)) {
+				pr_error("Invalid PRBS order: %s (should be 7/15/23/31)\n", optarg);
+				return -1;
+			}
+			break;
+
+		case OPT_SPIN:
+			config->spin_us = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' || config->spin_us < 0 || config->spin_us > MAX_SPIN_US) {
+				pr_error("Invalid spin time: %s (should be 0-%d us)\n", optarg,
+				         MAX_SPIN_US);
+				return -1;
+			}
+			break;
+
+		case OPT_CAPTURE:
+			free(config->capture_file);
+			config->capture_file = strdup(optarg);
+			if (config->capture_file == NULL) {
+				pr_error("Failed to allocate memory for capture file name\n");
+				return -1;
+			}
+			break;
+
+		case OPT_SEND_FILE:
+			free(config->send_file);
+			config->send_file = strdup(optarg);
+			if (config->send_file == NULL) {
+				pr_error("Failed to allocate memory for send file name\n");
+				return -1;
+			}
+			break;
+
+		case OPT_LOW_LATENCY:
+			config->low_latency = 1;
+			break;
+
+		case OPT_LATENCY_TIMER:
+			config->latency_timer = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' || config->latency_timer < 1 ||
+			    config->latency_timer > MAX_LATENCY_TIMER) {
+				pr_error("Invalid latency timer: %s (should be 1-%d ms)\n", optarg,
+				         MAX_LATENCY_TIMER);
+				return -1;
+			}
+			break;
+
+		case OPT_TIMEOUT:
+			config->timeout_ms = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' || config->timeout_ms < 1) {
+				pr_error("Invalid timeout: %s (should be >= 1 ms)\n", optarg);
+				return -1;
+			}
+			break;
+
+		case OPT_FRAME:
+			if (framer_parse_rule(&rule, optarg) < 0) {
+				return -1;
+			}
+			free(config->frame_spec);
+			config->frame_spec = strdup(optarg);
+			if (config->frame_spec == NULL) {
+				pr_error("Failed to allocate memory for frame rule\n");
+				return -1;
+			}
+			break;
+
+		case OPT_CHECKSUM:
+			cs = malloc(sizeof(checksum_t));
+			if (cs == NULL || checksum_init(cs, optarg) < 0) {
+				free(cs);
+				return -1;
+			}
+			free(cs);
+			free(config->checksum_spec);
+			config->checksum_spec = strdup(optarg);
+			if (config->checksum_spec == NULL) {
+				pr_error("Failed to allocate memory for checksum name\n");
+				return -1;
+			}
+			break;
+
+		case OPT_TRIGGER:
+			if (add_string(&config->triggers, &config->trigger_count, optarg) < 0) {
+				return -1;
+			}
+			break;
+
+		case OPT_ON_MATCH:
+			if (add_string(&config->actions, &config->action_count, optarg) < 0) {
+				return -1;
+			}
+			break;
+
+		case OPT_PEER:
+			free(config->peer);
+			config->peer = strdup(optarg);
+			if (config->peer == NULL) {
+				pr_error("Failed to allocate memory for peer name\n");
+				return -1;
+			}
+			break;
+
+		case OPT_TAP:
+			config->tap = 1;
+			break;
+
+		case 'q':
+			config->quiet = 1;
+			break;
+
+		case OPT_METRICS:
+			free(config->metrics_file);
+			config->metrics_file = strdup(optarg);
+			if (config->metrics_file == NULL) {
+				pr_error("Failed to allocate memory for metrics file name\n");
+				return -1;
+			}
+			break;
+
+		case OPT_METRICS_FORMAT:
+			if (strcmp(optarg, "json") == 0) {
+				config->metrics_format = METRICS_JSON;
+			} else if (strcmp(optarg, "prom") == 0) {
+				config->metrics_format = METRICS_PROM;
+			} else {
+				pr_error("Invalid metrics format: %s (should be json/prom)\n", optarg);
+				return -1;
+			}
+			break;
+
+		case OPT_METRICS_INTERVAL:
+			config->metrics_interval = (int)strtol(optarg, &endptr, 10);
+			if (*endptr != '\0' || config->metrics_interval < 1 ||
+			    config->metrics_interval > METRICS_MAX_INTERVAL) {
+				pr_error("Invalid metrics interval: %s (should be 1-%d)\n", optarg,
+				         METRICS_MAX_INTERVAL);
+				return -1;
+			}
+			break;
+
+		case OPT_TRACE:
+			free(config->trace_file);
+			config->trace_file = strdup(optarg);
+			if (config->trace_file == NULL) {
+				pr_error("Failed to allocate memory for trace file name\n");
+				return -1;
+			}
+			break;
+
+		case OPT_LISTEN:
+			free(config->listen);
+			config->listen = strdup(optarg);
+			if (config->listen == NULL) {
+				pr_error("Failed to allocate memory for listen address\n");
+				return -1;
+			}
+			break;
+
+		case OPT_SPEED:
+			config->speed = strtod(optarg, &endptr);
+			if (*endptr != '\0' || endptr == optarg || config->speed < 0) {
+				pr_error("Invalid speed: %s (should be >= 0)\n", optarg);
+				return -1;
+			}
+			break;
+
 		case 'F':
 			config->json_file = strdup(optarg);
 			if (config->json_file == NULL) {
@@ -287,7 +821,7 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 
 	/* 检查必需参数 */
 	if (!mode_set) {
-		pr_error("Mode is required (-m loopback/send/recv/file)\n");
+		pr_error("Mode is required (-m loopback/send/recv/file/bench/prbs/replay/ping/modbus/bridge/server)\n");
 		print_usage(argv[0]);
 		return -1;
 	}
@@ -299,11 +833,131 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 		return -1;
 	}
 
+	/* 检查 replay 模式是否需要抓包文件 */
+	if (config->mode == MODE_REPLAY && config->json_file == NULL) {
+		pr_error("Capture file is required for replay mode (-F <capture file>)\n");
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	/* modbus 模式没有默认请求 */
+	if (config->mode == MODE_MODBUS && config->send_string == NULL) {
+		pr_error("Requests are required for modbus mode (-s slave:function:address:count)\n");
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	/* 发送文件只支持单端口发送模式 */
+	if (config->send_file != NULL &&
+	    (config->mode != MODE_SEND || config->device_count > 1)) {
+		pr_error("--send-file is only supported in send mode with a single port\n");
+		return -1;
+	}
+
+	/* 抓包只支持单端口的接收和桥接模式 */
+	if (config->capture_file != NULL &&
+	    ((config->mode != MODE_RECV && config->mode != MODE_BRIDGE) ||
+	     config->device_count > 1)) {
+		pr_error("--capture is only supported in recv and bridge modes with a single port\n");
+		return -1;
+	}
+
+	/* 桥接模式连接一个串口和 --peer 指定的另一端 */
+	if (config->mode == MODE_BRIDGE) {
+		if (config->peer == NULL) {
+			pr_error("Peer is required for bridge mode (--peer <device|pty[:link]>)\n");
+			return -1;
+		}
+		if (config->device_count > 1) {
+			pr_error("Bridge mode supports a single port, use --peer for the other end\n");
+			return -1;
+		}
+		if (config->device_count == 1 && strcmp(config->peer, config->device) == 0) {
+			pr_error("Peer must be different from the device: %s\n", config->peer);
+			return -1;
+		}
+	} else if (config->peer != NULL || config->tap) {
+		pr_error("--peer and --tap are only supported in bridge mode\n");
+		return -1;
+	}
+
+	/* 服务器模式在 TCP 端口上提供一个串口 */
+	if (config->mode == MODE_SERVER) {
+		if (config->listen == NULL) {
+			pr_error("Listen address is required for server mode (--listen [addr:]port)\n");
+			return -1;
+		}
+		if (config->device_count > 1) {
+			pr_error("Server mode supports a single port\n");
+			return -1;
+		}
+	} else if (config->listen != NULL) {
+		pr_error("--listen is only supported in server mode\n");
+		return -1;
+	}
+
+	/* 多端口只支持 loopback/send/recv 模式 */
+	if (config->device_count > 1 && config->mode != MODE_LOOPBACK &&
+	    config->mode != MODE_SEND && config->mode != MODE_RECV) {
+		pr_error("Multi-port only supports loopback/send/recv mode\n");
+		return -1;
+	}
+
+	/* 分帧只支持单端口接收模式，且不能与抓包同时使用 */
+	if (config->frame_spec != NULL &&
+	    (config->mode != MODE_RECV || config->device_count > 1 ||
+	     config->capture_file != NULL)) {
+		pr_error("--frame is only supported in recv mode with a single port and without "
+		         "--capture\n");
+		return -1;
+	}
+
+	/* 校验值在单端口的 send/file 模式追加，在 recv 模式按帧检查 */
+	if (config->checksum_spec != NULL) {
+		if (config->device_count > 1 || config->send_file != NULL ||
+		    (config->mode != MODE_SEND && config->mode != MODE_FILE &&
+		     config->mode != MODE_RECV)) {
+			pr_error("--checksum is only supported in send (without --send-file), file "
+			         "and recv modes with a single port\n");
+			return -1;
+		}
+		if (config->mode == MODE_RECV && config->frame_spec == NULL) {
+			pr_error("--checksum in recv mode needs --frame to find the end of each "
+			         "frame\n");
+			return -1;
+		}
+	}
+
+	/* 触发器只支持单端口接收模式，可与分帧、抓包同时使用 */
+	if (config->action_count > 0 && config->trigger_count == 0) {
+		pr_error("--on-match needs at least one --trigger pattern\n");
+		return -1;
+	}
+	if (config->trigger_count > 0) {
+		if (config->mode != MODE_RECV || config->device_count > 1) {
+			pr_error("--trigger is only supported in recv mode with a single port\n");
+			return -1;
+		}
+		trig = malloc(sizeof(trigger_t));
+		if (trig == NULL || trigger_setup(trig, NULL, config->triggers, config->trigger_count,
+		                                  config->actions, config->action_count) < 0) {
+			free(trig);
+			return -1;
+		}
+		trigger_free(trig);
+		free(trig);
+	}
+
+	/* 安静模式和指标导出只用于按包收发的模式 */
+	if ((config->quiet || config->metrics_file != NULL) && config->mode != MODE_SEND &&
+	    config->mode != MODE_RECV && config->mode != MODE_FILE) {
+		pr_error("-q and --metrics are only supported in send, recv and file modes\n");
+		return -1;
+	}
+
 	/* 设置默认设备名 */
-	if (config->device == NULL) {
-		config->device = strdup(DEFAULT_DEVICE);
-		if (config->device == NULL) {
-			pr_error("Failed to allocate memory for device name\n");
+	if (config->device_count == 0) {
+		if (add_device(config, DEFAULT_DEVICE, strlen(DEFAULT_DEVICE)) < 0) {
 			return -1;
 		}
 	}
@@ -322,15 +976,56 @@ int parse_args(int argc, char *argv[], uart_config_t *config)
 
 void free_config(uart_config_t *config)
 {
+	int i;
+
 	if (config == NULL)
 		return;
 
-	if (config->device)
-		free(config->device);
+	if (config->devices) {
+		for (i = 0; i < config->device_count; i++)
+			free(config->devices[i]);
+		free(config->devices);
+	}
 
 	if (config->send_string)
 		free(config->send_string);
 
 	if (config->json_file)
 		free(config->json_file);
+
+	if (config->capture_file)
+		free(config->capture_file);
+
+	if (config->send_file)
+		free(config->send_file);
+
+	if (config->frame_spec)
+		free(config->frame_spec);
+
+	if (config->checksum_spec)
+		free(config->checksum_spec);
+
+	if (config->peer)
+		free(config->peer);
+
+	if (config->listen)
+		free(config->listen);
+
+	if (config->metrics_file)
+		free(config->metrics_file);
+
+	if (config->trace_file)
+		free(config->trace_file);
+
+	if (config->triggers) {
+		for (i = 0; i < config->trigger_count; i++)
+			free(config->triggers[i]);
+		free(config->triggers);
+	}
+
+	if (config->actions) {
+		for (i = 0; i < config->action_count; i++)
+			free(config->actions[i]);
+		free(config->actions);
+	}
 }
@@ -0,0 +1,594 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#define _GNU_SOURCE /* splice(), F_SETPIPE_SZ, pipe2(), ptsname_r() */
+
+#include "bridge.h"
+#include "capture.h"
+#include "lowlat.h"
+#include "mydebug.h"
+#include "outbuf.h"
+#include "timing.h"
+#include "uart_assist.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+#define BRIDGE_SPLICE_FLAGS (SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+
+/* 桥接的一端 */
+typedef struct {
+	const char *name;    /* 打印用的名字 */
+	int fd;
+	unsigned int events; /* 当前注册到 epoll 的事件 */
+} endpoint_t;
+
+/* 一个转发方向，数据从 ep[from] 读出，写入 ep[to] */
+typedef struct {
+	int from;
+	int to;
+	int pipe_fd[2];      /* splice 中转管道，拷贝模式下为 -1 */
+	char *buf;           /* 拷贝模式的缓冲区 */
+	size_t off;          /* 拷贝模式下缓冲区中下一个待写出的字节 */
+	size_t pending;      /* 已读出但还没写入目的端的字节数 */
+	size_t max_pending;  /* pending 的最大值 */
+	int cap_dir;         /* 抓包记录的方向 */
+	uint64_t bytes;      /* 已写入目的端的字节数 */
+	uint64_t reads;      /* 从源端读取的次数 */
+	uint64_t stalls;     /* 目的端写不进（EAGAIN）的次数 */
+	uint64_t last_bytes; /* 上次打印统计时的 bytes */
+} bridge_dir_t;
+
+typedef struct {
+	const uart_config_t *config;
+	uartdev_t *peer_dev;   /* 对端为串口时 */
+	int pty_fd;            /* 对端为伪终端时的主设备 */
+	int pty_hold;          /* 一直打开的从设备，旧程序关闭从设备后主设备不会读到 EIO */
+	char pty_name[64];     /* 伪终端从设备路径 */
+	const char *pty_link;  /* 指向从设备的符号链接，NULL 表示不创建 */
+	endpoint_t ep[2];      /* ep[0]: 串口, ep[1]: 对端 */
+	bridge_dir_t dir[2];   /* dir[0]: 串口 -> 对端, dir[1]: 对端 -> 串口 */
+	int epfd;
+	int tap;               /* 是否需要拿到数据（打印或抓包），此时只能用拷贝模式 */
+	capture_t cap;
+	int capturing;
+	outbuf_t *out;         /* --tap 打印用 */
+	int64_t realtime_offset; /* CLOCK_REALTIME - CLOCK_MONOTONIC */
+	uint64_t packets;      /* 已打印的数据块数 */
+} bridge_t;
+
+/* 创建伪终端，设置为原始模式，返回主设备 fd */
+static int bridge_open_pty(bridge_t *b)
+{
+	struct termios tio;
+	struct stat st;
+
+	b->pty_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (b->pty_fd < 0) {
+		pr_error("Failed to create pty: %s\n", strerror(errno));
+		return -1;
+	}
+	if (grantpt(b->pty_fd) < 0 || unlockpt(b->pty_fd) < 0 ||
+	    ptsname_r(b->pty_fd, b->pty_name, sizeof(b->pty_name)) != 0) {
+		pr_error("Failed to unlock pty: %s\n", strerror(errno));
+		return -1;
+	}
+
+	b->pty_hold = open(b->pty_name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (b->pty_hold < 0) {
+		pr_error("Failed to open %s: %s\n", b->pty_name, strerror(errno));
+		return -1;
+	}
+
+	/* 原始模式：不回显、不转换换行、不处理控制字符，旧程序打开后可以再自行设置 */
+	if (tcgetattr(b->pty_hold, &tio) < 0) {
+		pr_error("Failed to get attributes of %s: %s\n", b->pty_name, strerror(errno));
+		return -1;
+	}
+	cfmakeraw(&tio);
+	if (tcsetattr(b->pty_hold, TCSANOW, &tio) < 0) {
+		pr_error("Failed to set attributes of %s: %s\n", b->pty_name, strerror(errno));
+		return -1;
+	}
+
+	if (b->pty_link != NULL) {
+		/* 只替换已有的符号链接，不覆盖普通文件 */
+		if (lstat(b->pty_link, &st) == 0) {
+			if (!S_ISLNK(st.st_mode)) {
+				pr_error("%s exists and is not a symlink\n", b->pty_link);
+				b->pty_link = NULL;
+				return -1;
+			}
+			unlink(b->pty_link);
+		}
+		if (symlink(b->pty_name, b->pty_link) < 0) {
+			pr_error("Failed to create symlink %s: %s\n", b->pty_link, strerror(errno));
+			b->pty_link = NULL;
+			return -1;
+		}
+	}
+
+	pr_info("Pty created: %s%s%s\n", b->pty_name, b->pty_link ? " <- " : "",
+	        b->pty_link ? b->pty_link : "");
+	b->ep[1].name = b->pty_link ? b->pty_link : b->pty_name;
+	b->ep[1].fd = b->pty_fd;
+	return 0;
+}
+
+/* 用与主串口相同的参数打开对端串口 */
+static int bridge_open_uart(bridge_t *b)
+{
+	const uart_config_t *config = b->config;
+
+	b->peer_dev = uartdev_new(config->peer, config->baud, config->data_bit, config->parity,
+	                          config->stop_bit);
+	if (b->peer_dev == NULL) {
+		pr_error("Failed to create uart device: %s\n", strerror(errno));
+		return -1;
+	}
+	if (uartdev_setup(b->peer_dev) < 0) {
+		pr_error("Failed to setup uart device %s: %s\n", config->peer, strerror(errno));
+		return -1;
+	}
+
+	pr_info("UART device opened: %s, %d, %d%c%d\n", config->peer, config->baud,
+	        config->data_bit, config->parity, config->stop_bit);
+	print_baud_info(b->peer_dev);
+
+	if (lowlat_apply(b->peer_dev, config->low_latency, config->latency_timer) < 0) {
+		return -1;
+	}
+
+	b->ep[1].name = config->peer;
+	b->ep[1].fd = b->peer_dev->fd;
+	return 0;
+}
+
+/* 切换到拷贝模式，把管道中尚未写出的数据移到缓冲区 */
+static int dir_to_copy(bridge_dir_t *d)
+{
+	ssize_t n;
+
+	d->buf = malloc(BRIDGE_BUF_SIZE);
+	if (d->buf == NULL) {
+		pr_error("Failed to allocate memory for bridge buffer\n");
+		return -1;
+	}
+	d->off = 0;
+
+	if (d->pipe_fd[0] >= 0) {
+		if (d->pending > 0) {
+			n = read(d->pipe_fd[0], d->buf, d->pending);
+			if (n != (ssize_t)d->pending) {
+				pr_error("Failed to drain bridge pipe: %s\n", strerror(errno));
+				return -1;
+			}
+		}
+		close(d->pipe_fd[0]);
+		close(d->pipe_fd[1]);
+		d->pipe_fd[0] = d->pipe_fd[1] = -1;
+	}
+	return 0;
+}
+
+static int dir_init(bridge_dir_t *d, int from, int to, int cap_dir, int copy)
+{
+	memset(d, 0, sizeof(*d));
+	d->from = from;
+	d->to = to;
+	d->cap_dir = cap_dir;
+	d->pipe_fd[0] = d->pipe_fd[1] = -1;
+
+	if (!copy) {
+		if (pipe2(d->pipe_fd, O_NONBLOCK | O_CLOEXEC) == 0) {
+			/* 失败时保持默认容量即可 */
+			fcntl(d->pipe_fd[1], F_SETPIPE_SZ, BRIDGE_BUF_SIZE);
+			return 0;
+		}
+		pr_info("pipe2() failed (%s), using buffered copy\n", strerror(errno));
+	}
+	return dir_to_copy(d);
+}
+
+static void dir_free(bridge_dir_t *d)
+{
+	if (d->pipe_fd[0] >= 0) {
+		close(d->pipe_fd[0]);
+		close(d->pipe_fd[1]);
+	}
+	free(d->buf);
+}
+
+/* 按转发状态更新端点关注的事件：没有积压时读源端，有积压时等目的端可写 */
+static int bridge_update_events(bridge_t *b, int idx)
+{
+	endpoint_t *ep = &b->ep[idx];
+	struct epoll_event ev;
+	unsigned int events = 0;
+
+	if (b->dir[idx].pending == 0) {
+		events |= EPOLLIN;
+	}
+	if (b->dir[1 - idx].pending > 0) {
+		events |= EPOLLOUT;
+	}
+	if (events == ep->events) {
+		return 0;
+	}
+
+	ev.events = events;
+	ev.data.u32 = idx;
+	if (epoll_ctl(b->epfd, EPOLL_CTL_MOD, ep->fd, &ev) < 0) {
+		pr_error("epoll_ctl() failed on %s: %s\n", ep->name, strerror(errno));
+		return -1;
+	}
+	ep->events = events;
+	return 0;
+}
+
+/* 打印或抓包一份刚读出的数据 */
+static void bridge_tap(bridge_t *b, const bridge_dir_t *d, const char *data, size_t len)
+{
+	int64_t now = timing_now_ns();
+
+	if (b->capturing && b->cap.error == 0 &&
+	    capture_write(&b->cap, now, d->cap_dir, data, len) < 0) {
+		pr_error("Failed to write capture file: %s\n", strerror(errno));
+	}
+	if (!b->config->tap) {
+		return;
+	}
+
+	b->packets++;
+	outbuf_timestamp(b->out, now + b->realtime_offset);
+	if (b->config->format == OUTPUT_ASCII) {
+		outbuf_printf(b->out, "%s -> %s [%llu] : \"", b->ep[d->from].name,
+		              b->ep[d->to].name, (unsigned long long)b->packets);
+		outbuf_ascii(b->out, data, (int)len);
+		outbuf_printf(b->out, "\" (%zu bytes)\n", len);
+	} else {
+		outbuf_printf(b->out, "%s -> %s [%llu] : (%zu bytes)\n", b->ep[d->from].name,
+		              b->ep[d->to].name, (unsigned long long)b->packets, len);
+		outbuf_hex(b->out, data, (int)len);
+	}
+	outbuf_flush(b->out);
+}
+
+/* 把积压的数据写入目的端，写不进时保留，等待 EPOLLOUT */
+static int dir_flush(bridge_t *b, bridge_dir_t *d)
+{
+	int fd = b->ep[d->to].fd;
+	ssize_t n;
+
+	while (d->pending > 0) {
+		if (d->buf == NULL) {
+			n = splice(d->pipe_fd[0], NULL, fd, NULL, d->pending, BRIDGE_SPLICE_FLAGS);
+			if (n < 0 && errno == EINVAL) {
+				/* 目的端驱动不支持 splice */
+				pr_info("%s: splice not supported, using buffered copy\n",
+				        b->ep[d->to].name);
+				if (dir_to_copy(d) < 0) {
+					return -1;
+				}
+				continue;
+			}
+		} else {
+			n = write(fd, d->buf + d->off, d->pending);
+		}
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				d->stalls++;
+				break;
+			}
+			pr_error("Failed to write to %s: %s\n", b->ep[d->to].name, strerror(errno));
+			return -1;
+		}
+
+		d->bytes += n;
+		d->pending -= n;
+		d->off = d->pending > 0 ? d->off + n : 0;
+	}
+
+	return 0;
+}
+
+/* 从源端读一次数据并尽量写出 */
+static int dir_pump(bridge_t *b, bridge_dir_t *d)
+{
+	int fd = b->ep[d->from].fd;
+	ssize_t n;
+
+	for (;;) {
+		if (d->buf == NULL) {
+			n = splice(fd, NULL, d->pipe_fd[1], NULL, BRIDGE_BUF_SIZE,
+			           BRIDGE_SPLICE_FLAGS);
+			if (n < 0 && errno == EINVAL) {
+				/* 源端驱动不支持 splice */
+				pr_info("%s: splice not supported, using buffered copy\n",
+				        b->ep[d->from].name);
+				if (dir_to_copy(d) < 0) {
+					return -1;
+				}
+				continue;
+			}
+		} else {
+			n = read(fd, d->buf, BRIDGE_BUF_SIZE);
+		}
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				return 0;
+			}
+			pr_error("Failed to read from %s: %s\n", b->ep[d->from].name, strerror(errno));
+			return -1;
+		}
+		if (n == 0) {
+			pr_error("%s closed\n", b->ep[d->from].name);
+			errno = EPIPE;
+			return -1;
+		}
+		break;
+	}
+
+	d->reads++;
+	d->pending = n;
+	if ((size_t)n > d->max_pending) {
+		d->max_pending = n;
+	}
+	if (d->buf != NULL && b->tap) {
+		bridge_tap(b, d, d->buf, n);
+	}
+
+	return dir_flush(b, d);
+}
+
+static int bridge_open(bridge_t *b, uartdev_t *dev)
+{
+	struct epoll_event ev;
+	struct timespec rt;
+	const char *link;
+	int i;
+
+	b->ep[0].name = dev->port;
+	b->ep[0].fd = dev->fd;
+
+	/* --peer pty 或 pty:<链接路径> 创建伪终端，其他值作为串口打开 */
+	if (strcmp(b->config->peer, BRIDGE_PEER_PTY) == 0 ||
+	    strncmp(b->config->peer, BRIDGE_PEER_PTY ":", strlen(BRIDGE_PEER_PTY) + 1) == 0) {
+		link = b->config->peer + strlen(BRIDGE_PEER_PTY);
+		b->pty_link = *link == ':' ? link + 1 : NULL;
+		if (bridge_open_pty(b) < 0) {
+			return -1;
+		}
+	} else if (bridge_open_uart(b) < 0) {
+		return -1;
+	}
+
+	/* 两端都用非阻塞读写，由 epoll 驱动 */
+	for (i = 0; i < 2; i++) {
+		if (fcntl(b->ep[i].fd, F_SETFL, fcntl(b->ep[i].fd, F_GETFL) | O_NONBLOCK) < 0) {
+			pr_error("Failed to set %s non-blocking: %s\n", b->ep[i].name,
+			         strerror(errno));
+			return -1;
+		}
+	}
+	uartdev_flush(dev);
+	if (b->peer_dev != NULL) {
+		uartdev_flush(b->peer_dev);
+	}
+
+	if (b->config->capture_file != NULL) {
+		if (capture_open(&b->cap, b->config->capture_file, dev) < 0) {
+			pr_error("Failed to open capture file %s: %s\n", b->config->capture_file,
+			         strerror(errno));
+			return -1;
+		}
+		b->capturing = 1;
+	}
+	if (b->config->tap) {
+		b->out = malloc(sizeof(outbuf_t));
+		if (b->out == NULL) {
+			pr_error("Failed to allocate memory for output buffer\n");
+			return -1;
+		}
+		outbuf_init(b->out, stdout);
+		clock_gettime(CLOCK_REALTIME, &rt);
+		b->realtime_offset = (int64_t)rt.tv_sec * NSEC_PER_SEC + rt.tv_nsec - timing_now_ns();
+	}
+	b->tap = b->capturing || b->config->tap;
+
+	/* 串口收到的数据记为 RX，发往串口的数据记为 TX */
+	if (dir_init(&b->dir[0], 0, 1, CAPTURE_DIR_RX, b->tap) < 0 ||
+	    dir_init(&b->dir[1], 1, 0, CAPTURE_DIR_TX, b->tap) < 0) {
+		return -1;
+	}
+
+	b->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (b->epfd < 0) {
+		pr_error("epoll_create1() failed: %s\n", strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < 2; i++) {
+		b->ep[i].events = EPOLLIN;
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, b->ep[i].fd, &ev) < 0) {
+			pr_error("epoll_ctl() failed on %s: %s\n", b->ep[i].name, strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void bridge_close(bridge_t *b)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		dir_free(&b->dir[i]);
+	}
+	if (b->epfd >= 0) {
+		close(b->epfd);
+	}
+	if (b->capturing) {
+		if (capture_close(&b->cap) < 0) {
+			pr_error("Failed to write capture file: %s\n", strerror(errno));
+		}
+		pr_info("Capture saved: %s, %llu records, %llu bytes\n", b->config->capture_file,
+		        (unsigned long long)b->cap.records, (unsigned long long)b->cap.bytes);
+	}
+	if (b->out != NULL) {
+		outbuf_flush(b->out);
+		free(b->out);
+	}
+	if (b->pty_link != NULL) {
+		unlink(b->pty_link);
+	}
+	if (b->pty_hold >= 0) {
+		close(b->pty_hold);
+	}
+	if (b->pty_fd >= 0) {
+		close(b->pty_fd);
+	}
+	if (b->peer_dev != NULL) {
+		uartdev_del(b->peer_dev);
+	}
+}
+
+static void bridge_report(const bridge_t *b, int64_t elapsed_ns)
+{
+	const bridge_dir_t *d;
+	double sec = elapsed_ns / 1e9;
+	int i;
+
+	pr_info("Bridge completed in %.1f s\n", sec);
+	for (i = 0; i < 2; i++) {
+		d = &b->dir[i];
+		printf("  %s -> %s: %llu bytes (%.0f bytes/s), %llu reads, max backlog %zu bytes, "
+		       "%llu stalls, %s\n",
+		       b->ep[d->from].name, b->ep[d->to].name, (unsigned long long)d->bytes,
+		       sec > 0 ? d->bytes / sec : 0.0, (unsigned long long)d->reads,
+		       d->max_pending, (unsigned long long)d->stalls,
+		       d->buf == NULL ? "splice" : "copy");
+	}
+}
+
+int uart_bridge_test(uartdev_t *dev, const uart_config_t *config)
+{
+	struct epoll_event events[BRIDGE_MAX_EVENTS];
+	bridge_t *b;
+	bridge_dir_t *d;
+	int64_t start_ns, now, next_report_ns;
+	int i, n, idx, timeout;
+	int ret = 0;
+
+	if (dev == NULL || config == NULL || config->peer == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	b = calloc(1, sizeof(bridge_t));
+	if (b == NULL) {
+		pr_error("Failed to allocate memory for bridge\n");
+		return -1;
+	}
+	b->config = config;
+	b->pty_fd = b->pty_hold = b->epfd = -1;
+	b->dir[0].pipe_fd[0] = b->dir[0].pipe_fd[1] = -1;
+	b->dir[1].pipe_fd[0] = b->dir[1].pipe_fd[1] = -1;
+
+	if (bridge_open(b, dev) < 0) {
+		bridge_close(b);
+		free(b);
+		return -1;
+	}
+
+	pr_info("Bridge: %s <-> %s (%s), press Ctrl+C to stop\n", b->ep[0].name, b->ep[1].name,
+	        b->tap ? "buffered copy with tap" : "splice");
+
+	start_ns = timing_now_ns();
+	next_report_ns = start_ns + NSEC_PER_SEC;
+
+	while (g_running) {
+		now = timing_now_ns();
+		if (now >= next_report_ns) {
+			/* 有数据流动时每秒打印一次各方向的字节数 */
+			if (b->dir[0].bytes != b->dir[0].last_bytes ||
+			    b->dir[1].bytes != b->dir[1].last_bytes) {
+				printf("Bridge [%llds] : %s -> %s %llu bytes, %s -> %s %llu bytes\n",
+				       (long long)((now - start_ns) / NSEC_PER_SEC), b->ep[0].name,
+				       b->ep[1].name,
+				       (unsigned long long)(b->dir[0].bytes - b->dir[0].last_bytes),
+				       b->ep[1].name, b->ep[0].name,
+				       (unsigned long long)(b->dir[1].bytes - b->dir[1].last_bytes));
+				b->dir[0].last_bytes = b->dir[0].bytes;
+				b->dir[1].last_bytes = b->dir[1].bytes;
+			}
+			next_report_ns += NSEC_PER_SEC * ((now - next_report_ns) / NSEC_PER_SEC + 1);
+		}
+
+		timeout = (int)((next_report_ns - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+		n = epoll_wait(b->epfd, events, BRIDGE_MAX_EVENTS, timeout);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_error("epoll_wait() failed: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+
+		for (i = 0; i < n && ret == 0; i++) {
+			idx = events[i].data.u32;
+			if (events[i].events & EPOLLOUT) {
+				/* 另一个方向积压的数据可以继续写入此端 */
+				ret = dir_flush(b, &b->dir[1 - idx]);
+			}
+			d = &b->dir[idx];
+			if (ret == 0 && d->pending == 0 &&
+			    (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+				ret = dir_pump(b, d);
+			} else if (ret == 0 && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+				pr_error("%s closed or failed\n", b->ep[idx].name);
+				ret = -1;
+			}
+			if (ret == 0) {
+				ret = bridge_update_events(b, 0);
+			}
+			if (ret == 0) {
+				ret = bridge_update_events(b, 1);
+			}
+		}
+		if (ret < 0) {
+			break;
+		}
+	}
+
+	bridge_report(b, timing_now_ns() - start_ns);
+	bridge_close(b);
+	free(b);
+	return ret;
+}
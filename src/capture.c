@@ -0,0 +1,300 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "capture.h"
+#include "timing.h"
+#include <ctype.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+	v = htole16(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+	v = htole32(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le16toh(v);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le32toh(v);
+}
+
+static inline int64_t get_i64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return (int64_t)le64toh(v);
+}
+
+static inline void put_i64(uint8_t *p, int64_t v)
+{
+	uint64_t u = htole64((uint64_t)v);
+
+	memcpy(p, &u, sizeof(u));
+}
+
+/* 写出全部数据，处理被信号中断和部分写 */
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int capture_open(capture_t *c, const char *path, const uartdev_t *dev)
+{
+	uint8_t *h;
+	struct timespec rt;
+
+	if (c == NULL || path == NULL || dev == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(c, 0, sizeof(*c));
+	c->buf = malloc(CAPTURE_BUF_SIZE);
+	if (c->buf == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	c->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (c->fd < 0) {
+		free(c->buf);
+		c->buf = NULL;
+		return -1;
+	}
+
+	h = c->buf;
+	memset(h, 0, CAPTURE_HEADER_SIZE);
+	memcpy(h, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+	put_u16(h + 8, CAPTURE_VERSION);
+	put_u16(h + 10, CAPTURE_HEADER_SIZE);
+	put_u32(h + 12, (uint32_t)dev->baud);
+	h[16] = dev->data_bit;
+	h[17] = (uint8_t)toupper((unsigned char)dev->parity);
+	h[18] = dev->stop_bit;
+	clock_gettime(CLOCK_REALTIME, &rt);
+	put_i64(h + 24, (int64_t)rt.tv_sec * NSEC_PER_SEC + rt.tv_nsec);
+	put_i64(h + 32, timing_now_ns());
+	if (dev->port != NULL) {
+		strncpy((char *)h + 40, dev->port, CAPTURE_PORT_LEN - 1);
+	}
+	c->len = CAPTURE_HEADER_SIZE;
+
+	/* 文件头立即写出，即使之后没有数据也是有效的抓包文件 */
+	if (capture_flush(c) < 0) {
+		capture_close(c);
+		return -1;
+	}
+
+	return 0;
+}
+
+int capture_flush(capture_t *c)
+{
+	if (c->error) {
+		c->len = 0;
+		errno = c->error;
+		return -1;
+	}
+
+	if (c->len > 0 && write_all(c->fd, c->buf, c->len) < 0) {
+		c->error = errno;
+		c->len = 0;
+		return -1;
+	}
+	c->len = 0;
+
+	return 0;
+}
+
+int capture_write(capture_t *c, int64_t ts_ns, int dir, const void *data, size_t len)
+{
+	uint8_t *p;
+
+	if (c->len + CAPTURE_RECORD_SIZE + len > CAPTURE_BUF_SIZE && capture_flush(c) < 0) {
+		return -1;
+	}
+
+	p = c->buf + c->len;
+	put_i64(p, ts_ns);
+	p[8] = (uint8_t)dir;
+	p[9] = p[10] = p[11] = 0;
+	put_u32(p + 12, (uint32_t)len);
+	c->len += CAPTURE_RECORD_SIZE;
+
+	/* 比缓冲区还大的数据直接写文件 */
+	if (len > CAPTURE_BUF_SIZE - c->len) {
+		if (capture_flush(c) < 0) {
+			return -1;
+		}
+		if (write_all(c->fd, data, len) < 0) {
+			c->error = errno;
+			return -1;
+		}
+	} else {
+		memcpy(c->buf + c->len, data, len);
+		c->len += len;
+	}
+
+	c->records++;
+	c->bytes += len;
+
+	return 0;
+}
+
+int capture_close(capture_t *c)
+{
+	int ret;
+
+	if (c == NULL || c->buf == NULL) {
+		return 0;
+	}
+
+	ret = capture_flush(c);
+	if (close(c->fd) < 0 && ret == 0) {
+		ret = -1;
+	}
+	free(c->buf);
+	c->buf = NULL;
+	c->fd = -1;
+
+	return ret;
+}
+
+int capture_reader_open(capture_reader_t *r, const char *path)
+{
+	struct stat st;
+	const uint8_t *h;
+	void *map;
+	int header_size;
+	int fd;
+
+	if (r == NULL || path == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(r, 0, sizeof(*r));
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t)st.st_size < CAPTURE_HEADER_SIZE) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	h = map;
+	header_size = get_u16(h + 10);
+	if (memcmp(h, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 ||
+	    get_u16(h + 8) != CAPTURE_VERSION || header_size < CAPTURE_HEADER_SIZE ||
+	    (size_t)header_size > (size_t)st.st_size) {
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	r->map = map;
+	r->size = st.st_size;
+	r->off = header_size;
+	r->baud = (int)get_u32(h + 12);
+	r->data_bit = h[16];
+	r->parity = (char)h[17];
+	r->stop_bit = h[18];
+	r->start_realtime_ns = get_i64(h + 24);
+	r->start_mono_ns = get_i64(h + 32);
+	memcpy(r->port, h + 40, CAPTURE_PORT_LEN - 1);
+
+	return 0;
+}
+
+int capture_reader_next(capture_reader_t *r, capture_record_t *rec)
+{
+	const uint8_t *p;
+
+	if (r->off == r->size) {
+		return 0;
+	}
+
+	if (r->size - r->off < CAPTURE_RECORD_SIZE) {
+		return -1;
+	}
+
+	p = r->map + r->off;
+	rec->ts_ns = get_i64(p);
+	rec->dir = p[8];
+	rec->len = get_u32(p + 12);
+	if (r->size - r->off - CAPTURE_RECORD_SIZE < rec->len) {
+		return -1;
+	}
+	rec->data = p + CAPTURE_RECORD_SIZE;
+	r->off += CAPTURE_RECORD_SIZE + rec->len;
+
+	return 1;
+}
+
+void capture_reader_close(capture_reader_t *r)
+{
+	if (r == NULL || r->map == NULL) {
+		return;
+	}
+
+	munmap((void *)r->map, r->size);
+	r->map = NULL;
+}
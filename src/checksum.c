@@ -0,0 +1,427 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "checksum.h"
+#include "mydebug.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_SSE42
+#include <nmmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define CHECKSUM_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+#define CRC32_POLY 0x04C11DB7
+#define CRC32C_POLY 0x1EDC6F41
+
+typedef struct {
+	const char *name;
+	checksum_type_t type;
+	int width;
+	uint32_t poly;
+	uint32_t init;
+	uint32_t xorout;
+	int reflect;
+} checksum_preset_t;
+
+static const checksum_preset_t presets[] = {
+    {"crc8", CHECKSUM_CRC, 8, 0x07, 0x00, 0x00, 0},
+    {"crc8-maxim", CHECKSUM_CRC, 8, 0x31, 0x00, 0x00, 1},
+    {"crc16-modbus", CHECKSUM_CRC, 16, 0x8005, 0xFFFF, 0x0000, 1},
+    {"crc16-ccitt", CHECKSUM_CRC, 16, 0x1021, 0xFFFF, 0x0000, 0},
+    {"crc16-xmodem", CHECKSUM_CRC, 16, 0x1021, 0x0000, 0x0000, 0},
+    {"crc32", CHECKSUM_CRC, 32, CRC32_POLY, 0xFFFFFFFF, 0xFFFFFFFF, 1},
+    {"crc32c", CHECKSUM_CRC, 32, CRC32C_POLY, 0xFFFFFFFF, 0xFFFFFFFF, 1},
+    {"sum8", CHECKSUM_SUM, 8, 0, 0, 0, 0},
+    {"sum16", CHECKSUM_SUM, 16, 0, 0, 0, 0},
+    {"xor8", CHECKSUM_XOR, 8, 0, 0, 0, 0},
+};
+
+#define PRESET_COUNT ((int)(sizeof(presets) / sizeof(presets[0])))
+
+static inline uint32_t width_mask(int width)
+{
+	return width == 32 ? 0xFFFFFFFF : (1u << width) - 1;
+}
+
+static uint32_t reflect_bits(uint32_t v, int width)
+{
+	uint32_t r = 0;
+	int i;
+
+	for (i = 0; i < width; i++) {
+		r = (r << 1) | ((v >> i) & 1);
+	}
+	return r;
+}
+
+static inline uint32_t load_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t load_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/*
+ * 反射 CRC：寄存器在低 width 位，table[k][b] 为字节 b 之后再经过 k 个零字节的余数。
+ * 寄存器不足 32 位时高位为 0，与前 4 个字节异或后高位就是数据本身，所以各宽度通用。
+ */
+static uint32_t update_reflected(const checksum_t *c, uint32_t crc, const uint8_t *p, size_t len)
+{
+	const uint32_t(*t)[256] = c->table;
+	uint32_t x;
+
+	while (len >= 8) {
+		x = crc ^ load_le32(p);
+		crc = t[7][x & 0xFF] ^ t[6][(x >> 8) & 0xFF] ^ t[5][(x >> 16) & 0xFF] ^ t[4][x >> 24] ^
+		      t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+	}
+
+	return crc;
+}
+
+/* 不反射的 CRC：寄存器左对齐到 32 位，低位始终为 0 */
+static uint32_t update_normal(const checksum_t *c, uint32_t crc, const uint8_t *p, size_t len)
+{
+	const uint32_t(*t)[256] = c->table;
+	uint32_t x;
+
+	while (len >= 8) {
+		x = crc ^ load_be32(p);
+		crc = t[7][x >> 24] ^ t[6][(x >> 16) & 0xFF] ^ t[5][(x >> 8) & 0xFF] ^ t[4][x & 0xFF] ^
+		      t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		crc = (crc << 8) ^ t[0][(crc >> 24) ^ *p++];
+	}
+
+	return crc;
+}
+
+static uint32_t update_sum(const checksum_t *c, uint32_t sum, const uint8_t *p, size_t len)
+{
+	size_t i;
+
+	(void)c;
+	for (i = 0; i < len; i++) {
+		sum += p[i];
+	}
+	return sum;
+}
+
+static uint32_t update_xor(const checksum_t *c, uint32_t x, const uint8_t *p, size_t len)
+{
+	size_t i;
+
+	(void)c;
+	for (i = 0; i < len; i++) {
+		x ^= p[i];
+	}
+	return x;
+}
+
+#ifdef CHECKSUM_SSE42
+/* SSE4.2 的 crc32 指令计算的就是反射的 CRC-32C */
+__attribute__((target("sse4.2"))) static uint32_t update_crc32c_sse42(const checksum_t *c,
+                                                                      uint32_t crc,
+                                                                      const uint8_t *p,
+                                                                      size_t len)
+{
+	(void)c;
+#ifdef __x86_64__
+	uint64_t v;
+	uint64_t crc64 = crc;
+
+	while (len >= 8) {
+		memcpy(&v, p, 8);
+		crc64 = _mm_crc32_u64(crc64, v);
+		p += 8;
+		len -= 8;
+	}
+	crc = (uint32_t)crc64;
+#endif
+	while (len-- > 0) {
+		crc = _mm_crc32_u8(crc, *p++);
+	}
+
+	return crc;
+}
+#endif /* CHECKSUM_SSE42 */
+
+#ifdef CHECKSUM_ARMV8
+__attribute__((target("+crc"))) static uint32_t update_crc32_armv8(const checksum_t *c,
+                                                                   uint32_t crc, const uint8_t *p,
+                                                                   size_t len)
+{
+	uint64_t v;
+
+	(void)c;
+	while (len >= 8) {
+		memcpy(&v, p, 8);
+		crc = __crc32d(crc, v);
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		crc = __crc32b(crc, *p++);
+	}
+
+	return crc;
+}
+
+__attribute__((target("+crc"))) static uint32_t update_crc32c_armv8(const checksum_t *c,
+                                                                    uint32_t crc, const uint8_t *p,
+                                                                    size_t len)
+{
+	uint64_t v;
+
+	(void)c;
+	while (len >= 8) {
+		memcpy(&v, p, 8);
+		crc = __crc32cd(crc, v);
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0) {
+		crc = __crc32cb(crc, *p++);
+	}
+
+	return crc;
+}
+#endif /* CHECKSUM_ARMV8 */
+
+static void build_tables(checksum_t *c)
+{
+	uint32_t crc, poly;
+	int i, j, k;
+
+	if (c->reflect) {
+		poly = reflect_bits(c->poly, c->width);
+		for (i = 0; i < 256; i++) {
+			crc = i;
+			for (j = 0; j < 8; j++) {
+				crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+			}
+			c->table[0][i] = crc;
+		}
+		for (k = 1; k < 8; k++) {
+			for (i = 0; i < 256; i++) {
+				crc = c->table[k - 1][i];
+				c->table[k][i] = (crc >> 8) ^ c->table[0][crc & 0xFF];
+			}
+		}
+	} else {
+		poly = c->poly << (32 - c->width);
+		for (i = 0; i < 256; i++) {
+			crc = (uint32_t)i << 24;
+			for (j = 0; j < 8; j++) {
+				crc = (crc & 0x80000000) ? (crc << 1) ^ poly : crc << 1;
+			}
+			c->table[0][i] = crc;
+		}
+		for (k = 1; k < 8; k++) {
+			for (i = 0; i < 256; i++) {
+				crc = c->table[k - 1][i];
+				c->table[k][i] = (crc << 8) ^ c->table[0][crc >> 24];
+			}
+		}
+	}
+}
+
+/* 选择实现，硬件指令只覆盖特定多项式 */
+static void select_impl(checksum_t *c)
+{
+	if (c->type == CHECKSUM_SUM) {
+		c->update = update_sum;
+		c->impl = "bytewise";
+		return;
+	}
+	if (c->type == CHECKSUM_XOR) {
+		c->update = update_xor;
+		c->impl = "bytewise";
+		return;
+	}
+
+	build_tables(c);
+	c->update = c->reflect ? update_reflected : update_normal;
+	c->impl = "slicing-by-8";
+
+	if (c->width != 32 || !c->reflect) {
+		return;
+	}
+#ifdef CHECKSUM_SSE42
+	__builtin_cpu_init();
+	if (c->poly == CRC32C_POLY && __builtin_cpu_supports("sse4.2")) {
+		c->update = update_crc32c_sse42;
+		c->impl = "sse4.2";
+	}
+#endif
+#ifdef CHECKSUM_ARMV8
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		if (c->poly == CRC32_POLY) {
+			c->update = update_crc32_armv8;
+			c->impl = "armv8-crc";
+		} else if (c->poly == CRC32C_POLY) {
+			c->update = update_crc32c_armv8;
+			c->impl = "armv8-crc";
+		}
+	}
+#endif
+}
+
+/* 解析自定义 CRC：crc<8|16|32>:<poly>[:<init>[:<xorout>[:r]]] */
+static int parse_custom(checksum_t *c, const char *spec)
+{
+	uint32_t *fields[3] = {&c->poly, &c->init, &c->xorout};
+	unsigned long val;
+	const char *p;
+	char *end;
+	int i;
+
+	c->type = CHECKSUM_CRC;
+	c->width = strtol(spec + 3, &end, 10);
+	if ((c->width != 8 && c->width != 16 && c->width != 32) || *end != ':') {
+		return -1;
+	}
+
+	p = end;
+	for (i = 0; i < 3 && *p == ':' && p[1] != 'r'; i++) {
+		errno = 0;
+		val = strtoul(p + 1, &end, 0);
+		if (end == p + 1 || errno != 0 || val > width_mask(c->width)) {
+			return -1;
+		}
+		*fields[i] = val;
+		p = end;
+	}
+	if (i == 0 || c->poly == 0) {
+		return -1;
+	}
+	if (strcmp(p, ":r") == 0) {
+		c->reflect = 1;
+	} else if (*p != '\0') {
+		return -1;
+	}
+
+	snprintf(c->name, sizeof(c->name), "crc%d:0x%X:0x%X:0x%X%s", c->width, c->poly, c->init,
+	         c->xorout, c->reflect ? ":r" : "");
+	return 0;
+}
+
+int checksum_init(checksum_t *c, const char *spec)
+{
+	const checksum_preset_t *p;
+	int i;
+
+	if (c == NULL || spec == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(c, 0, sizeof(*c));
+	for (i = 0; i < PRESET_COUNT; i++) {
+		p = &presets[i];
+		if (strcmp(spec, p->name) == 0) {
+			snprintf(c->name, sizeof(c->name), "%s", p->name);
+			c->type = p->type;
+			c->width = p->width;
+			c->poly = p->poly;
+			c->init = p->init;
+			c->xorout = p->xorout;
+			c->reflect = p->reflect;
+			break;
+		}
+	}
+
+	if (i == PRESET_COUNT &&
+	    (strncmp(spec, "crc", 3) != 0 || strchr(spec, ':') == NULL || parse_custom(c, spec) < 0)) {
+		pr_error("Invalid checksum: %s (should be one of %s, or "
+		         "crc<8|16|32>:<poly>[:<init>[:<xorout>[:r]]])\n",
+		         spec, checksum_names());
+		return -1;
+	}
+
+	c->little_endian = c->reflect;
+	select_impl(c);
+
+	return 0;
+}
+
+const char *checksum_names(void)
+{
+	return "crc8, crc8-maxim, crc16-modbus, crc16-ccitt, crc16-xmodem, crc32, crc32c, "
+	       "sum8, sum16, xor8";
+}
+
+uint32_t checksum_compute(const checksum_t *c, const void *data, size_t len)
+{
+	uint32_t state;
+
+	if (c->type != CHECKSUM_CRC) {
+		return c->update(c, 0, data, len) & width_mask(c->width);
+	}
+
+	if (c->reflect) {
+		state = c->update(c, reflect_bits(c->init, c->width), data, len);
+	} else {
+		state = c->update(c, c->init << (32 - c->width), data, len) >> (32 - c->width);
+	}
+
+	return (state ^ c->xorout) & width_mask(c->width);
+}
+
+int checksum_append(const checksum_t *c, const void *data, size_t len, uint8_t *out)
+{
+	uint32_t value = checksum_compute(c, data, len);
+	int size = checksum_size(c);
+	int i;
+
+	for (i = 0; i < size; i++) {
+		if (c->little_endian) {
+			out[i] = value >> (8 * i);
+		} else {
+			out[i] = value >> (8 * (size - 1 - i));
+		}
+	}
+
+	return size;
+}
+
+int checksum_verify(const checksum_t *c, const void *frame, size_t len)
+{
+	uint8_t want[CHECKSUM_MAX_SIZE];
+	int size = checksum_size(c);
+
+	if (len < (size_t)size) {
+		return 0;
+	}
+
+	checksum_append(c, frame, len - size, want);
+	return memcmp(want, (const uint8_t *)frame + len - size, size) == 0;
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "crc.h"
+#include <pthread.h>
+#include <string.h>
+
+#define CRC16_MODBUS_POLY 0xA001 /* 0x8005 的位反转 */
+
+/* crc16_table[k][b]：字节 b 之后再经过 k 个零字节的 CRC 余数 */
+static uint16_t crc16_table[8][256];
+static pthread_once_t crc16_once = PTHREAD_ONCE_INIT;
+
+static void crc16_table_init(void)
+{
+	uint16_t crc;
+	int i, j, k;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++) {
+			crc = (crc & 1) ? (crc >> 1) ^ CRC16_MODBUS_POLY : crc >> 1;
+		}
+		crc16_table[0][i] = crc;
+	}
+
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			crc = crc16_table[k - 1][i];
+			crc16_table[k][i] = (crc >> 8) ^ crc16_table[0][crc & 0xFF];
+		}
+	}
+}
+
+uint16_t crc16_modbus_update(uint16_t crc, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	uint32_t lo;
+
+	pthread_once(&crc16_once, crc16_table_init);
+
+	/* 反射 CRC 只有低 16 位与前两个字节相关，后 6 个字节直接查表 */
+	while (len >= 8) {
+		lo = (p[0] | (p[1] << 8)) ^ crc;
+		crc = crc16_table[7][lo & 0xFF] ^ crc16_table[6][lo >> 8] ^ crc16_table[5][p[2]] ^
+		      crc16_table[4][p[3]] ^ crc16_table[3][p[4]] ^ crc16_table[2][p[5]] ^
+		      crc16_table[1][p[6]] ^ crc16_table[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+
+	while (len-- > 0) {
+		crc = (crc >> 8) ^ crc16_table[0][(crc ^ *p++) & 0xFF];
+	}
+
+	return crc;
+}
@@ -0,0 +1,413 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "expect.h"
+#include "hex_codec.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+extern int g_quiet;            /* 安静模式，不打印逐包输出 */
+
+#define EXPECT_SHOW_MAX 32 /* 失败和多余数据最多打印的字节数 */
+
+/* expect_run() 的结束条件 */
+enum {
+	WAIT_TIME,  /* 到达指定时间 */
+	WAIT_SLOT,  /* 等待中的请求数小于 MaxOutstanding */
+	WAIT_EMPTY  /* 没有等待中的请求 */
+};
+
+int expect_init(expect_t *e, uartdev_t *dev, const json_config_t *config, int timeout_ms)
+{
+	int i;
+
+	if (e == NULL || dev == NULL || config == NULL || timeout_ms <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(e, 0, sizeof(*e));
+	e->dev = dev;
+	e->config = config;
+	e->default_timeout_ns = (int64_t)timeout_ms * NSEC_PER_MSEC;
+	e->metrics = metrics_port(dev->port);
+
+	e->steps = calloc(config->record_count, sizeof(expect_step_t));
+	if (e->steps == NULL) {
+		pr_error("Failed to allocate memory for response statistics\n");
+		return -1;
+	}
+	for (i = 0; i < config->record_count; i++) {
+		if (config->records[i].expect == NULL) {
+			continue;
+		}
+		e->steps[i].latency = malloc(sizeof(histogram_t));
+		if (e->steps[i].latency == NULL) {
+			pr_error("Failed to allocate memory for latency histogram\n");
+			expect_free(e);
+			return -1;
+		}
+		hist_init(e->steps[i].latency);
+	}
+
+	return 0;
+}
+
+static expect_step_t *expect_step(expect_t *e, const send_record_t *rec)
+{
+	return &e->steps[rec - e->config->records];
+}
+
+static void expect_push(expect_t *e, const send_record_t *rec, int64_t sent_ns, int attempt)
+{
+	expect_req_t *req = &e->queue[(e->head + e->count) % MAX_OUTSTANDING_LIMIT];
+
+	req->rec = rec;
+	req->sent_ns = sent_ns;
+	req->deadline_ns = sent_ns + (rec->timeout_ns ? rec->timeout_ns : e->default_timeout_ns);
+	req->rx_mark = e->rx_total;
+	req->attempt = attempt;
+	e->count++;
+}
+
+static void expect_pop(expect_t *e)
+{
+	e->head = (e->head + 1) % MAX_OUTSTANDING_LIMIT;
+	e->count--;
+}
+
+void expect_sent(expect_t *e, const send_record_t *rec, int64_t sent_ns)
+{
+	if (rec->expect == NULL) {
+		return;
+	}
+
+	expect_step(e, rec)->sent++;
+	expect_push(e, rec, sent_ns, 0);
+}
+
+static void expect_print_hex(const uint8_t *data, size_t len, size_t max)
+{
+	char buf[2 * EXPECT_MAX_LEN + 1];
+	size_t n = len < max ? len : max;
+
+	hex_encode(data, n, buf);
+	buf[2 * n] = '\0';
+	printf("hex=\"%s%s\"", buf, n < len ? "..." : "");
+}
+
+static void expect_consume(expect_t *e, size_t n)
+{
+	memmove(e->rx, e->rx + n, e->rx_len - n);
+	e->rx_len -= n;
+}
+
+/* 丢弃缓冲区开头不属于任何响应的字节 */
+static void expect_discard(expect_t *e, size_t n)
+{
+	if (n == 0) {
+		return;
+	}
+
+	/* 安静模式只计数，汇总时报告 */
+	if (!g_quiet) {
+		printf("Recv : unexpected ");
+		expect_print_hex(e->rx, n, EXPECT_SHOW_MAX);
+		printf(" (%zu bytes)\n", n);
+	}
+	metrics_error(e->metrics);
+	e->unexpected += n;
+	expect_consume(e, n);
+}
+
+/* 按掩码在接收缓冲区中查找期望的响应，返回位置，-1 表示没有 */
+static long expect_find(const expect_t *e, const send_record_t *rec)
+{
+	const uint8_t *x = rec->expect;
+	const uint8_t *m = rec->expect_mask;
+	size_t len = rec->expect_len;
+	size_t pos, i;
+
+	for (pos = 0; pos + len <= e->rx_len; pos++) {
+		if (m == NULL) {
+			if (memcmp(e->rx + pos, x, len) == 0) {
+				return pos;
+			}
+			continue;
+		}
+		for (i = 0; i < len && ((e->rx[pos + i] ^ x[i]) & m[i]) == 0; i++) {
+		}
+		if (i == len) {
+			return pos;
+		}
+	}
+
+	return -1;
+}
+
+/* 用缓冲区中的数据按顺序匹配等待中的请求 */
+static void expect_match(expect_t *e)
+{
+	expect_req_t *req;
+	expect_step_t *step;
+	int64_t latency;
+	long pos;
+
+	while (e->count > 0) {
+		req = &e->queue[e->head];
+		pos = expect_find(e, req->rec);
+		if (pos < 0) {
+			break;
+		}
+
+		expect_discard(e, pos);
+		latency = e->rx_ns - req->sent_ns;
+		step = expect_step(e, req->rec);
+		step->ok++;
+		hist_add(step->latency, latency);
+		e->ok++;
+
+		if (!g_quiet) {
+			printf("Recv [%d] : ", req->rec->item->number);
+			expect_print_hex(e->rx, req->rec->expect_len, EXPECT_MAX_LEN);
+			printf(" OK (%.3f ms", latency / 1e6);
+			if (req->attempt > 0) {
+				printf(", retry %d", req->attempt);
+			}
+			printf(")\n");
+		}
+
+		expect_consume(e, req->rec->expect_len);
+		expect_pop(e);
+	}
+
+	if (e->count == 0) {
+		/* 没有等待中的请求时，收到的数据都是多余的 */
+		expect_discard(e, e->rx_len);
+	} else if (e->rx_len == EXPECT_RX_SIZE) {
+		/* 缓冲区满仍未匹配，只保留可能是响应开头的部分 */
+		expect_discard(e, e->rx_len - (e->queue[e->head].rec->expect_len - 1));
+	}
+}
+
+static int expect_resend(expect_t *e, const expect_req_t *req)
+{
+	const send_record_t *rec = req->rec;
+	int64_t now = timing_now_ns();
+
+	if (uartdev_send_all(e->dev, (const char *)e->config->arena + rec->offset, rec->len,
+	                     &g_running) < 0) {
+		/* 被 Ctrl+C 中断时由调用者的循环正常退出 */
+		if (!g_running) {
+			return 0;
+		}
+		e->error = errno;
+		metrics_error(e->metrics);
+		pr_error("Failed to send data: %s\n", strerror(errno));
+		return -1;
+	}
+
+	expect_step(e, rec)->retries++;
+	e->retries++;
+	metrics_tx(e->metrics, rec->len);
+	if (!g_quiet) {
+		printf("Send [%d] : retry %d/%d (%d bytes)\n", rec->item->number, req->attempt + 1,
+		       rec->retries, rec->len);
+	}
+	expect_push(e, rec, now, req->attempt + 1);
+	return 0;
+}
+
+/* 处理已超时的队首请求 */
+static void expect_check_timeouts(expect_t *e, int64_t now)
+{
+	expect_req_t req;
+	expect_step_t *step;
+	int mismatch;
+
+	while (e->count > 0 && now >= e->queue[e->head].deadline_ns && !e->stop && !e->error) {
+		req = e->queue[e->head];
+		expect_pop(e);
+
+		step = expect_step(e, req.rec);
+		mismatch = e->rx_total - req.rx_mark >= (uint64_t)req.rec->expect_len;
+		if (mismatch) {
+			step->mismatches++;
+		} else {
+			step->timeouts++;
+		}
+		metrics_timeout(e->metrics);
+
+		printf("Recv [%d] : FAIL, %s in %lld ms", req.rec->item->number,
+		       mismatch ? "no matching response" : "timeout",
+		       (long long)((req.deadline_ns - req.sent_ns) / NSEC_PER_MSEC));
+		if (e->rx_len > 0) {
+			printf(", buffered ");
+			expect_print_hex(e->rx, e->rx_len, EXPECT_SHOW_MAX);
+		}
+		printf("\n");
+
+		if (req.rec->on_fail == ON_FAIL_RETRY && req.attempt < req.rec->retries) {
+			expect_resend(e, &req);
+			continue;
+		}
+
+		e->failed++;
+		metrics_error(e->metrics);
+		if (req.rec->on_fail == ON_FAIL_STOP) {
+			pr_error("Item %d failed, stop sending (OnFail=stop)\n", req.rec->item->number);
+			e->stop = 1;
+		}
+	}
+
+	/* 剩余的请求都已出队时，缓冲区中的数据不再属于任何响应 */
+	if (e->count == 0 && e->rx_len > 0) {
+		expect_discard(e, e->rx_len);
+	}
+}
+
+static int expect_read(expect_t *e)
+{
+	ssize_t n;
+
+	n = read(e->dev->fd, e->rx + e->rx_len, EXPECT_RX_SIZE - e->rx_len);
+	if (n < 0) {
+		if (errno == EINTR || errno == EAGAIN) {
+			return 0;
+		}
+		e->error = errno;
+		metrics_error(e->metrics);
+		pr_error("Failed to receive data: %s\n", strerror(errno));
+		return -1;
+	}
+
+	e->rx_len += n;
+	e->rx_total += n;
+	metrics_rx(e->metrics, n);
+	e->rx_ns = timing_now_ns();
+	expect_match(e);
+	return 0;
+}
+
+static int expect_run(expect_t *e, int mode, int64_t until_ns)
+{
+	struct pollfd pfd;
+	int64_t now, wake;
+	int ret, timeout;
+
+	pfd.fd = e->dev->fd;
+	pfd.events = POLLIN;
+
+	while (g_running) {
+		now = timing_now_ns();
+		expect_check_timeouts(e, now);
+		if (e->stop || e->error) {
+			return -1;
+		}
+		if ((mode == WAIT_TIME && now >= until_ns) ||
+		    (mode == WAIT_SLOT && e->count < e->config->max_outstanding) ||
+		    (mode == WAIT_EMPTY && e->count == 0)) {
+			break;
+		}
+
+		/* 睡到结束时间和队首请求超时中较早的一个，等待期间有数据立即读取 */
+		wake = mode == WAIT_TIME ? until_ns : INT64_MAX;
+		if (e->count > 0 && e->queue[e->head].deadline_ns < wake) {
+			wake = e->queue[e->head].deadline_ns;
+		}
+		timeout = (int)((wake - now) / NSEC_PER_MSEC);
+
+		ret = poll(&pfd, 1, timeout);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			e->error = errno;
+			return -1;
+		}
+		if (ret > 0) {
+			if (!(pfd.revents & POLLIN)) {
+				e->error = EIO;
+				pr_error("Serial port closed or failed\n");
+				return -1;
+			}
+			if (expect_read(e) < 0) {
+				return -1;
+			}
+		} else if (timeout == 0) {
+			/* 不足 1 毫秒，poll 无法表示，直接睡到 wake */
+			timing_sleep_until(wake);
+		}
+	}
+
+	return 0;
+}
+
+int expect_poll_until(expect_t *e, int64_t until_ns)
+{
+	return expect_run(e, WAIT_TIME, until_ns);
+}
+
+int expect_wait_slot(expect_t *e)
+{
+	return expect_run(e, WAIT_SLOT, 0);
+}
+
+int expect_drain(expect_t *e)
+{
+	return expect_run(e, WAIT_EMPTY, 0);
+}
+
+void expect_report(const expect_t *e)
+{
+	const expect_step_t *step;
+	char name[48];
+	int i;
+
+	pr_info("Expect: %ld OK, %ld failed, %ld retries, %llu unexpected bytes\n", e->ok,
+	        e->failed, e->retries, (unsigned long long)e->unexpected);
+	printf("  Number      Sent        OK  Timeouts  Mismatch   Retries\n");
+	for (i = 0; i < e->config->record_count; i++) {
+		step = &e->steps[i];
+		if (step->latency == NULL) {
+			continue;
+		}
+		printf("  %6d  %8ld  %8ld  %8ld  %8ld  %8ld\n", e->config->records[i].item->number,
+		       step->sent, step->ok, step->timeouts, step->mismatches, step->retries);
+	}
+	for (i = 0; i < e->config->record_count; i++) {
+		step = &e->steps[i];
+		if (step->latency == NULL) {
+			continue;
+		}
+		snprintf(name, sizeof(name), "Item %d latency", e->config->records[i].item->number);
+		hist_report_us(step->latency, name);
+	}
+}
+
+void expect_free(expect_t *e)
+{
+	int i;
+
+	if (e == NULL || e->steps == NULL) {
+		return;
+	}
+
+	for (i = 0; i < e->config->record_count; i++) {
+		free(e->steps[i].latency);
+	}
+	free(e->steps);
+	e->steps = NULL;
+}
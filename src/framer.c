@@ -0,0 +1,370 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "framer.h"
+#include "hex_codec.h"
+#include "mydebug.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_IDLE_MAX_CHARS 10000.0 /* 空闲时间上限（字符时间） */
+
+static int parse_int(const char *str, char **end, long min, long max, long *val)
+{
+	errno = 0;
+	*val = strtol(str, end, 10);
+	if (*end == str || errno != 0 || *val < min || *val > max) {
+		return -1;
+	}
+	return 0;
+}
+
+int framer_parse_rule(frame_rule_t *rule, const char *spec)
+{
+	const char *arg;
+	char *end;
+	size_t err_pos, len;
+	long val;
+
+	if (rule == NULL || spec == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(rule, 0, sizeof(*rule));
+	rule->max_size = FRAME_MAX_SIZE;
+	rule->len_big_endian = 1;
+
+	if (strncmp(spec, "idle:", 5) == 0) {
+		arg = spec + 5;
+		rule->mode = FRAME_IDLE;
+		rule->idle_chars = strtod(arg, &end);
+		if (end == arg || *end != '\0' || rule->idle_chars <= 0 ||
+		    rule->idle_chars > FRAME_IDLE_MAX_CHARS) {
+			pr_error("Invalid idle time: %s (should be 0-%.0f character times)\n", arg,
+			         FRAME_IDLE_MAX_CHARS);
+			return -1;
+		}
+	} else if (strncmp(spec, "delim:", 6) == 0) {
+		arg = spec + 6;
+		rule->mode = FRAME_DELIM;
+		len = strlen(arg);
+		if (len == 0 || len % 2 != 0 || len / 2 > FRAME_DELIM_MAX ||
+		    hex_decode(arg, len, (uint8_t *)rule->delim, &err_pos) < 0) {
+			pr_error("Invalid delimiter: %s (should be 1-%d bytes of hex, e.g. 0d0a)\n",
+			         arg, FRAME_DELIM_MAX);
+			return -1;
+		}
+		rule->delim_len = len / 2;
+	} else if (strncmp(spec, "len:", 4) == 0) {
+		arg = spec + 4;
+		rule->mode = FRAME_LEN;
+		if (parse_int(arg, &end, 0, FRAME_MAX_SIZE - 1, &val) < 0 || *end != ':') {
+			goto bad_len;
+		}
+		rule->len_offset = val;
+		if (parse_int(end + 1, &end, 1, 4, &val) < 0 || val == 3) {
+			goto bad_len;
+		}
+		rule->len_size = val;
+		if (strncmp(end, "be", 2) == 0) {
+			end += 2;
+		} else if (strncmp(end, "le", 2) == 0) {
+			rule->len_big_endian = 0;
+			end += 2;
+		}
+		if (*end == ':') {
+			if (parse_int(end + 1, &end, -FRAME_MAX_SIZE, FRAME_MAX_SIZE, &val) < 0) {
+				goto bad_len;
+			}
+			rule->len_extra = val;
+		}
+		if (*end != '\0') {
+			goto bad_len;
+		}
+	} else if (strncmp(spec, "fixed:", 6) == 0) {
+		arg = spec + 6;
+		rule->mode = FRAME_FIXED;
+		if (parse_int(arg, &end, 1, 16 * FRAME_MAX_SIZE, &val) < 0 || *end != '\0') {
+			pr_error("Invalid frame size: %s (should be 1-%d)\n", arg,
+			         16 * FRAME_MAX_SIZE);
+			return -1;
+		}
+		rule->fixed_size = val;
+		if (rule->fixed_size > rule->max_size) {
+			rule->max_size = rule->fixed_size;
+		}
+	} else {
+		pr_error("Invalid frame rule: %s (should be idle:<chars>, delim:<hex>, "
+		         "len:<offset>:<size>[le|be][:<extra>] or fixed:<size>)\n",
+		         spec);
+		return -1;
+	}
+
+	return 0;
+
+bad_len:
+	pr_error("Invalid length rule: %s (should be len:<offset>:<1|2|4>[le|be][:<extra>])\n",
+	         spec);
+	return -1;
+}
+
+void framer_describe(const frame_rule_t *rule, char *buf, size_t len)
+{
+	char hex[FRAME_DELIM_MAX * 2 + 1];
+
+	switch (rule->mode) {
+	case FRAME_IDLE:
+		snprintf(buf, len, "idle gap >= %.1f chars", rule->idle_chars);
+		break;
+	case FRAME_DELIM:
+		hex_encode((const uint8_t *)rule->delim, rule->delim_len, hex);
+		hex[rule->delim_len * 2] = '\0';
+		snprintf(buf, len, "delimiter %s", hex);
+		break;
+	case FRAME_LEN:
+		snprintf(buf, len, "%d-byte %s length at offset %d, extra %d", rule->len_size,
+		         rule->len_big_endian ? "big-endian" : "little-endian", rule->len_offset,
+		         rule->len_extra);
+		break;
+	case FRAME_FIXED:
+		snprintf(buf, len, "fixed %d bytes", rule->fixed_size);
+		break;
+	}
+}
+
+int framer_init(framer_t *f, const frame_rule_t *rule, int64_t char_ns, frame_cb_t cb,
+                void *arg)
+{
+	if (f == NULL || rule == NULL || cb == NULL || rule->max_size <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(f, 0, sizeof(*f));
+	f->rule = *rule;
+	f->char_ns = char_ns;
+	f->idle_ns = (int64_t)(rule->idle_chars * char_ns);
+	f->cb = cb;
+	f->arg = arg;
+	f->carry = malloc(rule->max_size);
+	if (f->carry == NULL) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void framer_set_checksum(framer_t *f, const checksum_t *cs)
+{
+	f->checksum = cs;
+}
+
+void framer_free(framer_t *f)
+{
+	if (f == NULL) {
+		return;
+	}
+	free(f->carry);
+	f->carry = NULL;
+}
+
+static void emit(framer_t *f, const char *data, size_t len, int64_t first_ns, int64_t last_ns,
+                 int flags)
+{
+	frame_t frame;
+
+	frame.data = data;
+	frame.len = len;
+	frame.first_ns = first_ns;
+	frame.last_ns = last_ns;
+	frame.flags = flags;
+
+	if (f->checksum != NULL && !(flags & (FRAME_FLAG_OVERFLOW | FRAME_FLAG_INCOMPLETE)) &&
+	    !checksum_verify(f->checksum, data, len)) {
+		frame.flags |= FRAME_FLAG_BAD_CHECKSUM;
+		f->checksum_errors++;
+	}
+
+	f->frames++;
+	f->bytes += len;
+	if (flags & FRAME_FLAG_OVERFLOW) {
+		f->overflows++;
+	}
+	f->cb(f->arg, &frame);
+}
+
+/* 输出拼接缓冲区中的帧 */
+static void emit_carry(framer_t *f, int64_t last_ns, int flags)
+{
+	f->copied++;
+	emit(f, f->carry, f->carry_len, f->carry_ns, last_ns, flags);
+	f->carry_len = 0;
+}
+
+/* 把数据追加到拼接缓冲区，满了还有数据时先把已有内容作为截断帧输出 */
+static void carry_append(framer_t *f, const char *data, size_t len, int64_t ts_ns)
+{
+	size_t n;
+
+	while (len > 0) {
+		if (f->carry_len == (size_t)f->rule.max_size) {
+			emit_carry(f, ts_ns, FRAME_FLAG_OVERFLOW);
+		}
+		if (f->carry_len == 0) {
+			f->carry_ns = ts_ns;
+		}
+		n = f->rule.max_size - f->carry_len;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(f->carry + f->carry_len, data, n);
+		f->carry_len += n;
+		data += n;
+		len -= n;
+	}
+}
+
+/* 拼接缓冲区和新数据块合起来看作一段连续数据 */
+static inline uint8_t byte_at(const framer_t *f, const char *data, size_t i)
+{
+	return i < f->carry_len ? (uint8_t)f->carry[i] : (uint8_t)data[i - f->carry_len];
+}
+
+/*
+ * 在 data 中查找当前帧的结尾，当前帧从拼接缓冲区的开头开始（拼接缓冲区为空时从 data 开头）。
+ * 返回: >0 当前帧在 data 中的字节数, 0 data 中没有帧尾, -1 长度字段非法
+ */
+static long frame_end(const framer_t *f, const char *data, size_t len)
+{
+	const frame_rule_t *r = &f->rule;
+	const char *p, *end;
+	size_t have = f->carry_len + len;
+	size_t hdr, total, k;
+	uint32_t val;
+	int i;
+
+	switch (r->mode) {
+	case FRAME_FIXED:
+		total = r->fixed_size;
+		return have >= total ? (long)(total - f->carry_len) : 0;
+
+	case FRAME_LEN:
+		hdr = r->len_offset + r->len_size;
+		if (have < hdr) {
+			return 0;
+		}
+		val = 0;
+		for (i = 0; i < r->len_size; i++) {
+			if (r->len_big_endian) {
+				val = (val << 8) | byte_at(f, data, r->len_offset + i);
+			} else {
+				val |= (uint32_t)byte_at(f, data, r->len_offset + i) << (8 * i);
+			}
+		}
+		if ((int64_t)hdr + val + r->len_extra < (int64_t)hdr ||
+		    (int64_t)hdr + val + r->len_extra > r->max_size) {
+			return -1;
+		}
+		total = hdr + val + r->len_extra;
+		return have >= total ? (long)(total - f->carry_len) : 0;
+
+	case FRAME_DELIM:
+		/* 分隔符跨在拼接缓冲区和 data 之间 */
+		for (k = r->delim_len - 1; k > 0; k--) {
+			if (f->carry_len >= k && len >= r->delim_len - k &&
+			    memcmp(f->carry + f->carry_len - k, r->delim, k) == 0 &&
+			    memcmp(data, r->delim + k, r->delim_len - k) == 0) {
+				return r->delim_len - k;
+			}
+		}
+		p = data;
+		end = data + len;
+		while (end - p >= r->delim_len) {
+			p = memchr(p, r->delim[0], end - p - r->delim_len + 1);
+			if (p == NULL) {
+				break;
+			}
+			if (memcmp(p, r->delim, r->delim_len) == 0) {
+				return p - data + r->delim_len;
+			}
+			p++;
+		}
+		return 0;
+
+	case FRAME_IDLE:
+		break;
+	}
+
+	return 0;
+}
+
+void framer_push(framer_t *f, const char *data, size_t len, int64_t ts_ns)
+{
+	int64_t gap;
+	long n;
+
+	if (f->rule.mode == FRAME_IDLE) {
+		/* 数据块的时间是最后一个字节到达的时间，减去本块的传输时间得到第一个字节的时间 */
+		gap = ts_ns - (int64_t)len * f->char_ns - f->last_ns;
+		if (f->carry_len > 0 && gap >= f->idle_ns) {
+			emit_carry(f, f->last_ns, 0);
+		}
+		carry_append(f, data, len, ts_ns);
+		f->last_ns = ts_ns;
+		return;
+	}
+
+	f->last_ns = ts_ns;
+	while (len > 0) {
+		n = frame_end(f, data, len);
+		if (n < 0) {
+			/* 长度字段非法，丢弃一个字节后重新同步 */
+			f->discarded++;
+			if (f->carry_len > 0) {
+				memmove(f->carry, f->carry + 1, --f->carry_len);
+			} else {
+				data++;
+				len--;
+			}
+			continue;
+		}
+		if (n == 0) {
+			carry_append(f, data, len, ts_ns);
+			return;
+		}
+
+		if (f->carry_len == 0) {
+			/* 整帧都在当前数据块中，不复制 */
+			emit(f, data, n, ts_ns, ts_ns, 0);
+		} else {
+			carry_append(f, data, n, ts_ns);
+			if (f->carry_len > 0) {
+				emit_carry(f, ts_ns, 0);
+			}
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+void framer_poll(framer_t *f, int64_t now_ns)
+{
+	if (f->rule.mode == FRAME_IDLE && f->carry_len > 0 && now_ns - f->last_ns >= f->idle_ns) {
+		emit_carry(f, f->last_ns, 0);
+	}
+}
+
+void framer_flush(framer_t *f)
+{
+	if (f->carry_len > 0) {
+		emit_carry(f, f->last_ns, f->rule.mode == FRAME_IDLE ? 0 : FRAME_FLAG_INCOMPLETE);
+	}
+}
@@ -0,0 +1,395 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "hex_codec.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HEX_CODEC_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define HEX_CODEC_NEON
+#include <arm_neon.h>
+#endif
+
+static const char hex_upper[16] = "0123456789ABCDEF";
+
+/* hex 字符到数值的查找表，0xFF 表示非法字符 */
+static const uint8_t hex_value[256] = {
+    ['0'] = 0x0,  ['1'] = 0x1,  ['2'] = 0x2,  ['3'] = 0x3,  ['4'] = 0x4,  ['5'] = 0x5,
+    ['6'] = 0x6,  ['7'] = 0x7,  ['8'] = 0x8,  ['9'] = 0x9,  ['a'] = 0xA,  ['b'] = 0xB,
+    ['c'] = 0xC,  ['d'] = 0xD,  ['e'] = 0xE,  ['f'] = 0xF,  ['A'] = 0xA,  ['B'] = 0xB,
+    ['C'] = 0xC,  ['D'] = 0xD,  ['E'] = 0xE,  ['F'] = 0xF,
+};
+
+/* 表中未列出的字符为 0，需要单独判断是否为 '0' */
+static inline int hex_nibble(uint8_t c)
+{
+	uint8_t v = hex_value[c];
+
+	if (v == 0 && c != '0') {
+		return -1;
+	}
+
+	return v;
+}
+
+static int decode_scalar(const char *src, size_t src_len, uint8_t *dst, size_t *err_pos)
+{
+	size_t i;
+	int hi, lo;
+
+	for (i = 0; i + 1 < src_len; i += 2) {
+		hi = hex_nibble((uint8_t)src[i]);
+		lo = hex_nibble((uint8_t)src[i + 1]);
+		if ((hi | lo) < 0) {
+			*err_pos = hi < 0 ? i : i + 1;
+			return -1;
+		}
+		dst[i / 2] = (uint8_t)(hi << 4 | lo);
+	}
+
+	return 0;
+}
+
+static void encode_scalar(const uint8_t *src, size_t len, char *dst)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		dst[0] = hex_upper[src[i] >> 4];
+		dst[1] = hex_upper[src[i] & 0x0F];
+		dst += 2;
+	}
+}
+
+static void encode_spaced_scalar(const uint8_t *src, size_t len, char *dst)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		dst[0] = hex_upper[src[i] >> 4];
+		dst[1] = hex_upper[src[i] & 0x0F];
+		dst[2] = ' ';
+		dst += 3;
+	}
+}
+
+/* SIMD 实现发现非法字符时，从该块开始用标量实现定位具体位置 */
+static int decode_tail(const char *src, size_t src_len, uint8_t *dst, size_t *err_pos,
+                       size_t done)
+{
+	if (decode_scalar(src + done, src_len - done, dst + done / 2, err_pos) < 0) {
+		*err_pos += done;
+		return -1;
+	}
+
+	return 0;
+}
+
+static const hex_codec_t codec_scalar = {
+    "scalar",
+    decode_scalar,
+    encode_scalar,
+    encode_spaced_scalar,
+};
+
+#ifdef HEX_CODEC_X86
+
+/*
+ * 16 个 hex 字符转换为 16 个半字节，valid 返回每个字符是否合法。
+ * '0'-'9' 减 '0' 后 <= 9；字母或上 0x20 转为小写，减 'a' 后 <= 5。
+ */
+__attribute__((target("sse2"))) static inline __m128i nibbles_sse2(__m128i v, __m128i *valid)
+{
+	__m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+	__m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i is_d = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+	__m128i is_l = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+
+	*valid = _mm_or_si128(is_d, is_l);
+	l = _mm_add_epi8(l, _mm_set1_epi8(10));
+
+	return _mm_or_si128(_mm_and_si128(is_d, d), _mm_andnot_si128(is_d, l));
+}
+
+/* 半字节转换为大写 hex 字符 */
+__attribute__((target("sse2"))) static inline __m128i hexchars_sse2(__m128i n)
+{
+	__m128i gt9 = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')),
+	                    _mm_and_si128(gt9, _mm_set1_epi8('A' - '0' - 10)));
+}
+
+__attribute__((target("sse2"))) static int decode_sse2(const char *src, size_t src_len,
+                                                       uint8_t *dst, size_t *err_pos)
+{
+	__m128i v, n, valid, w;
+	size_t i;
+
+	for (i = 0; i + 16 <= src_len; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(src + i));
+		n = nibbles_sse2(v, &valid);
+		if (_mm_movemask_epi8(valid) != 0xFFFF) {
+			return decode_tail(src, src_len, dst, err_pos, i);
+		}
+		/* 每 16 位中低字节为高半字节，高字节为低半字节 */
+		w = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, _mm_set1_epi16(0x00FF)), 4),
+		                 _mm_srli_epi16(n, 8));
+		_mm_storel_epi64((__m128i *)(dst + i / 2), _mm_packus_epi16(w, w));
+	}
+
+	return decode_tail(src, src_len, dst, err_pos, i);
+}
+
+__attribute__((target("sse2"))) static void encode_sse2(const uint8_t *src, size_t len, char *dst)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	__m128i v, hi, lo;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(src + i));
+		hi = hexchars_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		lo = hexchars_sse2(_mm_and_si128(v, mask));
+		_mm_storeu_si128((__m128i *)(dst + i * 2), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dst + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+
+	encode_scalar(src + i, len - i, dst + i * 2);
+}
+
+static const hex_codec_t codec_sse2 = {
+    "sse2",
+    decode_sse2,
+    encode_sse2,
+    encode_spaced_scalar,
+};
+
+__attribute__((target("avx2"))) static int decode_avx2(const char *src, size_t src_len,
+                                                       uint8_t *dst, size_t *err_pos)
+{
+	const __m256i c0 = _mm256_set1_epi8('0');
+	const __m256i ca = _mm256_set1_epi8('a');
+	__m256i v, d, l, is_d, is_l, n, w;
+	size_t i;
+
+	for (i = 0; i + 32 <= src_len; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(src + i));
+		d = _mm256_sub_epi8(v, c0);
+		l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), ca);
+		is_d = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+		is_l = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+		if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(is_d, is_l)) != 0xFFFFFFFFu) {
+			return decode_tail(src, src_len, dst, err_pos, i);
+		}
+		n = _mm256_blendv_epi8(_mm256_add_epi8(l, _mm256_set1_epi8(10)), d, is_d);
+		w = _mm256_or_si256(
+		    _mm256_slli_epi16(_mm256_and_si256(n, _mm256_set1_epi16(0x00FF)), 4),
+		    _mm256_srli_epi16(n, 8));
+		/* packus 在每个 128 位通道内打包，再把两个通道的结果拼到低 128 位 */
+		w = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0x08);
+		_mm_storeu_si128((__m128i *)(dst + i / 2), _mm256_castsi256_si128(w));
+	}
+
+	return decode_tail(src, src_len, dst, err_pos, i);
+}
+
+__attribute__((target("avx2"))) static void encode_avx2(const uint8_t *src, size_t len, char *dst)
+{
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	const __m256i table = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+	                                       'A', 'B', 'C', 'D', 'E', 'F', '0', '1', '2', '3',
+	                                       '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D',
+	                                       'E', 'F');
+	__m256i v, hi, lo, a, b;
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(src + i));
+		hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, mask));
+		/* unpack 在每个 128 位通道内交织，再按通道重新排列 */
+		a = _mm256_unpacklo_epi8(hi, lo);
+		b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i *)(dst + i * 2), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst + i * 2 + 32),
+		                    _mm256_permute2x128_si256(a, b, 0x31));
+	}
+
+	encode_sse2(src + i, len - i, dst + i * 2);
+}
+
+/*
+ * 每 16 字节输入生成 48 字符 "XX XX ..."：先交织出 32 个 hex 字符，
+ * 再用 pshufb 把字符搬到输出位置，空格位置的索引为 -128（结果为 0）后或上空格。
+ */
+__attribute__((target("avx2"))) static void encode_spaced_avx2(const uint8_t *src, size_t len,
+                                                               char *dst)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i table = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A',
+	                                    'B', 'C', 'D', 'E', 'F');
+	const __m128i s0 = _mm_setr_epi8(0, 1, -128, 2, 3, -128, 4, 5, -128, 6, 7, -128, 8, 9,
+	                                 -128, 10);
+	const __m128i s1a = _mm_setr_epi8(11, -128, 12, 13, -128, 14, 15, -128, -128, -128, -128,
+	                                  -128, -128, -128, -128, -128);
+	const __m128i s1b = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, 0, 1,
+	                                  -128, 2, 3, -128, 4, 5);
+	const __m128i s2 = _mm_setr_epi8(-128, 6, 7, -128, 8, 9, -128, 10, 11, -128, 12, 13, -128,
+	                                 14, 15, -128);
+	const __m128i sp0 = _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+	const __m128i sp1 = _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0);
+	const __m128i sp2 = _mm_setr_epi8(' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ');
+	__m128i v, hi, lo, a, b;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(src + i));
+		hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		lo = _mm_shuffle_epi8(table, _mm_and_si128(v, mask));
+		a = _mm_unpacklo_epi8(hi, lo);
+		b = _mm_unpackhi_epi8(hi, lo);
+		_mm_storeu_si128((__m128i *)(dst + i * 3),
+		                 _mm_or_si128(_mm_shuffle_epi8(a, s0), sp0));
+		_mm_storeu_si128((__m128i *)(dst + i * 3 + 16),
+		                 _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, s1a),
+		                                           _mm_shuffle_epi8(b, s1b)),
+		                              sp1));
+		_mm_storeu_si128((__m128i *)(dst + i * 3 + 32),
+		                 _mm_or_si128(_mm_shuffle_epi8(b, s2), sp2));
+	}
+
+	encode_spaced_scalar(src + i, len - i, dst + i * 3);
+}
+
+static const hex_codec_t codec_avx2 = {
+    "avx2",
+    decode_avx2,
+    encode_avx2,
+    encode_spaced_avx2,
+};
+
+#endif /* HEX_CODEC_X86 */
+
+#ifdef HEX_CODEC_NEON
+
+/* 16 个 hex 字符转换为半字节，valid 返回每个字符是否合法 */
+static inline uint8x16_t nibbles_neon(uint8x16_t v, uint8x16_t *valid)
+{
+	uint8x16_t d = vsubq_u8(v, vdupq_n_u8('0'));
+	uint8x16_t l = vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+	uint8x16_t is_d = vcleq_u8(d, vdupq_n_u8(9));
+	uint8x16_t is_l = vcleq_u8(l, vdupq_n_u8(5));
+
+	*valid = vorrq_u8(is_d, is_l);
+
+	return vbslq_u8(is_d, d, vaddq_u8(l, vdupq_n_u8(10)));
+}
+
+static int decode_neon(const char *src, size_t src_len, uint8_t *dst, size_t *err_pos)
+{
+	uint8x16x2_t v;
+	uint8x16_t hi, lo, vhi, vlo;
+	size_t i;
+
+	for (i = 0; i + 32 <= src_len; i += 32) {
+		/* vld2 把偶数位置（高半字节）和奇数位置（低半字节）分开 */
+		v = vld2q_u8((const uint8_t *)(src + i));
+		hi = nibbles_neon(v.val[0], &vhi);
+		lo = nibbles_neon(v.val[1], &vlo);
+		if (vminvq_u8(vandq_u8(vhi, vlo)) != 0xFF) {
+			return decode_tail(src, src_len, dst, err_pos, i);
+		}
+		vst1q_u8(dst + i / 2, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+	}
+
+	return decode_tail(src, src_len, dst, err_pos, i);
+}
+
+static void encode_neon(const uint8_t *src, size_t len, char *dst)
+{
+	const uint8x16_t table = vld1q_u8((const uint8_t *)hex_upper);
+	uint8x16x2_t out;
+	uint8x16_t v;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		v = vld1q_u8(src + i);
+		out.val[0] = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+		out.val[1] = vqtbl1q_u8(table, vandq_u8(v, vdupq_n_u8(0x0F)));
+		vst2q_u8((uint8_t *)dst + i * 2, out);
+	}
+
+	encode_scalar(src + i, len - i, dst + i * 2);
+}
+
+static void encode_spaced_neon(const uint8_t *src, size_t len, char *dst)
+{
+	const uint8x16_t table = vld1q_u8((const uint8_t *)hex_upper);
+	uint8x16x3_t out;
+	uint8x16_t v;
+	size_t i;
+
+	out.val[2] = vdupq_n_u8(' ');
+	for (i = 0; i + 16 <= len; i += 16) {
+		v = vld1q_u8(src + i);
+		out.val[0] = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+		out.val[1] = vqtbl1q_u8(table, vandq_u8(v, vdupq_n_u8(0x0F)));
+		vst3q_u8((uint8_t *)dst + i * 3, out);
+	}
+
+	encode_spaced_scalar(src + i, len - i, dst + i * 3);
+}
+
+static const hex_codec_t codec_neon = {
+    "neon",
+    decode_neon,
+    encode_neon,
+    encode_spaced_neon,
+};
+
+#endif /* HEX_CODEC_NEON */
+
+/* 按从快到慢排列的可用实现 */
+static const hex_codec_t *codec_list[3];
+static int codec_count;
+static pthread_once_t codec_once = PTHREAD_ONCE_INIT;
+
+static void codec_detect(void)
+{
+#ifdef HEX_CODEC_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		codec_list[codec_count++] = &codec_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		codec_list[codec_count++] = &codec_sse2;
+	}
+#endif
+#ifdef HEX_CODEC_NEON
+	codec_list[codec_count++] = &codec_neon;
+#endif
+	codec_list[codec_count++] = &codec_scalar;
+}
+
+const hex_codec_t *hex_codec_best(void)
+{
+	pthread_once(&codec_once, codec_detect);
+
+	return codec_list[0];
+}
+
+int hex_codec_list(const hex_codec_t *const **list)
+{
+	pthread_once(&codec_once, codec_detect);
+	*list = codec_list;
+
+	return codec_count;
+}
@@ -0,0 +1,143 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "histogram.h"
+#include "mydebug.h"
+#include <stdio.h>
+#include <string.h>
+
+void hist_init(histogram_t *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+/* 值到桶序号 */
+static inline int hist_index(uint64_t v)
+{
+	int msb, shift;
+
+	if (v < 2 * HIST_SUB_COUNT) {
+		return (int)v;
+	}
+
+	msb = 63 - __builtin_clzll(v);
+	if (msb >= HIST_MAX_BITS) {
+		return HIST_BUCKETS - 1;
+	}
+
+	/* v >> shift 落在 [HIST_SUB_COUNT, 2 * HIST_SUB_COUNT) */
+	shift = msb - HIST_SUB_BITS;
+	return shift * HIST_SUB_COUNT + (int)(v >> shift);
+}
+
+/* 桶序号到该桶的上界 */
+static inline int64_t hist_upper(int idx)
+{
+	int shift;
+
+	if (idx < 2 * HIST_SUB_COUNT) {
+		return idx;
+	}
+
+	shift = idx / HIST_SUB_COUNT - 1;
+	return ((int64_t)(idx - shift * HIST_SUB_COUNT + 1) << shift) - 1;
+}
+
+void hist_add(histogram_t *h, int64_t value)
+{
+	if (value < 0) {
+		value = 0;
+	}
+
+	if (h->count == 0 || value < h->min) {
+		h->min = value;
+	}
+	if (h->count == 0 || value > h->max) {
+		h->max = value;
+	}
+	h->count++;
+	h->sum += (double)value;
+	h->buckets[hist_index((uint64_t)value)]++;
+}
+
+int64_t hist_percentile(const histogram_t *h, double pct)
+{
+	uint64_t target, seen = 0;
+	int64_t v;
+	int i;
+
+	if (h->count == 0) {
+		return 0;
+	}
+
+	target = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+	if (target < 1) {
+		target = 1;
+	}
+	if (target > h->count) {
+		target = h->count;
+	}
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			break;
+		}
+	}
+
+	v = hist_upper(i);
+	if (v > h->max) {
+		v = h->max;
+	}
+	if (v < h->min) {
+		v = h->min;
+	}
+
+	return v;
+}
+
+double hist_mean(const histogram_t *h)
+{
+	return h->count ? h->sum / (double)h->count : 0.0;
+}
+
+void hist_report_us(const histogram_t *h, const char *name)
+{
+	if (h->count == 0) {
+		pr_info("%s: no samples\n", name);
+		return;
+	}
+
+	pr_info("%s: min %.1f, avg %.1f, p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f us (n=%llu)\n",
+	        name, h->min / 1e3, hist_mean(h) / 1e3, hist_percentile(h, 50) / 1e3,
+	        hist_percentile(h, 99) / 1e3, hist_percentile(h, 99.9) / 1e3, h->max / 1e3,
+	        (unsigned long long)h->count);
+}
+
+void hist_print_table_us(const histogram_t *h)
+{
+	static const double pcts[] = {0, 10, 25, 50, 75, 90, 95, 99, 99.9, 99.99, 100};
+	uint64_t seen;
+	int64_t v;
+	int i, j;
+
+	if (h->count == 0) {
+		return;
+	}
+
+	printf("%12s %12s %12s\n", "Percentile", "Value(us)", "TotalCount");
+	for (i = 0; i < (int)(sizeof(pcts) / sizeof(pcts[0])); i++) {
+		v = pcts[i] == 0 ? h->min : hist_percentile(h, pcts[i]);
+		/* 不超过该值的样本数 */
+		seen = 0;
+		for (j = 0; j <= hist_index((uint64_t)v); j++) {
+			seen += h->buckets[j];
+		}
+		printf("%12.3f %12.1f %12llu\n", pcts[i], v / 1e3, (unsigned long long)seen);
+	}
+}
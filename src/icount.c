@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "icount.h"
+#include "mydebug.h"
+#include <errno.h>
+#include <linux/serial.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+int icount_read(const uartdev_t *dev, icount_counts_t *c)
+{
+	struct serial_icounter_struct ic;
+
+	if (dev == NULL || dev->fd < 0 || c == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&ic, 0, sizeof(ic));
+	if (ioctl(dev->fd, TIOCGICOUNT, &ic) < 0) {
+		return -1;
+	}
+
+	c->rx = ic.rx;
+	c->tx = ic.tx;
+	c->frame = ic.frame;
+	c->parity = ic.parity;
+	c->overrun = ic.overrun;
+	c->buf_overrun = ic.buf_overrun;
+	c->brk = ic.brk;
+	return 0;
+}
+
+int icount_start(icount_t *ic, const uartdev_t *dev)
+{
+	memset(ic, 0, sizeof(*ic));
+	ic->dev = dev;
+
+	if (icount_read(dev, &ic->start) < 0) {
+		pr_info("%s: driver error counters not supported (TIOCGICOUNT: %s)\n", dev->port,
+		        strerror(errno));
+		return 0;
+	}
+
+	ic->supported = 1;
+	ic->last = ic->start;
+	return 1;
+}
+
+/* 计数按无符号数相减，驱动中的 int 回绕后增量仍然正确 */
+static void icount_delta(const icount_counts_t *from, const icount_counts_t *to,
+                         icount_counts_t *d)
+{
+	d->rx = to->rx - from->rx;
+	d->tx = to->tx - from->tx;
+	d->frame = to->frame - from->frame;
+	d->parity = to->parity - from->parity;
+	d->overrun = to->overrun - from->overrun;
+	d->buf_overrun = to->buf_overrun - from->buf_overrun;
+	d->brk = to->brk - from->brk;
+}
+
+static long icount_errors(const icount_counts_t *d)
+{
+	return (long)d->frame + d->parity + d->overrun + d->buf_overrun;
+}
+
+void icount_poll(icount_t *ic, int errors_only)
+{
+	icount_counts_t now, d;
+
+	if (!ic->supported || icount_read(ic->dev, &now) < 0) {
+		return;
+	}
+
+	icount_delta(&ic->last, &now, &d);
+	ic->last = now;
+	if (errors_only && icount_errors(&d) == 0 && d.brk == 0) {
+		return;
+	}
+
+	printf("  Driver: rx +%u, tx +%u, frame +%u, parity +%u, overrun +%u, buf_overrun +%u, "
+	       "brk +%u\n",
+	       d.rx, d.tx, d.frame, d.parity, d.overrun, d.buf_overrun, d.brk);
+}
+
+long icount_report(icount_t *ic, long long rx_bytes, long long tx_bytes)
+{
+	icount_counts_t now, d;
+
+	if (!ic->supported) {
+		return 0;
+	}
+	if (icount_read(ic->dev, &now) < 0) {
+		pr_error("%s: failed to read driver counters: %s\n", ic->dev->port, strerror(errno));
+		return 0;
+	}
+
+	icount_delta(&ic->start, &now, &d);
+	pr_info("Driver counters: rx %u, tx %u, frame %u, parity %u, overrun %u, buf_overrun %u, "
+	        "brk %u\n",
+	        d.rx, d.tx, d.frame, d.parity, d.overrun, d.buf_overrun, d.brk);
+	if (rx_bytes >= 0) {
+		pr_info("  rx: driver %u bytes, read by uart_assist %lld bytes\n", d.rx, rx_bytes);
+	}
+	if (tx_bytes >= 0) {
+		pr_info("  tx: driver %u bytes, written by uart_assist %lld bytes\n", d.tx, tx_bytes);
+	}
+
+	if (d.frame > 0 || d.parity > 0) {
+		pr_error("  %u frame and %u parity errors: check baud rate, data format and wiring\n",
+		         d.frame, d.parity);
+	}
+	if (d.overrun > 0) {
+		pr_error("  %u UART FIFO overruns: the driver did not empty the hardware FIFO in "
+		         "time (interrupt latency)\n",
+		         d.overrun);
+	}
+	if (d.buf_overrun > 0) {
+		pr_error("  %u tty buffer overruns: data was not read from the port fast enough\n",
+		         d.buf_overrun);
+	}
+
+	ic->last = now;
+	return icount_errors(&d);
+}
@@ -8,12 +8,65 @@ Free Software Foundation.
 
 #include "json_config.h"
 #include "../third_party/cjson/cJSON.h"
+#include "hex_codec.h"
 #include "mydebug.h"
+#include "timing.h"
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* 解析发送项中可选的字符串字段，不存在时 *out 为 NULL */
+static int parse_optional_string(cJSON *obj, const char *name, int index, char **out)
+{
+	cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, name);
+
+	*out = NULL;
+	if (item == NULL) {
+		return 0;
+	}
+	if (!cJSON_IsString(item) || item->valuestring == NULL) {
+		pr_error("SendList[%d].%s is invalid\n", index, name);
+		return -1;
+	}
+
+	*out = strdup(item->valuestring);
+	if (*out == NULL) {
+		pr_error("Failed to allocate memory for %s\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+/* 解析 OnFail：continue、stop、retry 或 retry:N */
+static int parse_on_fail(const char *str, on_fail_t *on_fail, int *retries)
+{
+	char *end;
+	long n;
+
+	*retries = 0;
+	if (str == NULL || strcmp(str, "continue") == 0) {
+		*on_fail = ON_FAIL_CONTINUE;
+	} else if (strcmp(str, "stop") == 0) {
+		*on_fail = ON_FAIL_STOP;
+	} else if (strcmp(str, "retry") == 0) {
+		*on_fail = ON_FAIL_RETRY;
+		*retries = 1;
+	} else if (strncmp(str, "retry:", 6) == 0) {
+		errno = 0;
+		n = strtol(str + 6, &end, 10);
+		if (end == str + 6 || *end != '\0' || errno != 0 || n < 1 ||
+		    n > EXPECT_MAX_RETRIES) {
+			return -1;
+		}
+		*on_fail = ON_FAIL_RETRY;
+		*retries = n;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
 json_config_t *parse_json_file(const char *filename)
 {
 	FILE *fp;
@@ -23,6 +76,7 @@ json_config_t *parse_json_file(const char *filename)
 	int i;
 	json_config_t *config;
 	send_item_t *send_items;
+	int delay_fields;
 
 	if (filename == NULL) {
 		errno = EINVAL;
@@ -113,6 +167,19 @@ json_config_t *parse_json_file(const char *filename)
 		return NULL;
 	}
 
+	/* 解析可选的 MaxOutstanding */
+	config->max_outstanding = 1;
+	item = cJSON_GetObjectItemCaseSensitive(json, "MaxOutstanding");
+	if (cJSON_IsNumber(item)) {
+		config->max_outstanding = item->valueint;
+	} else if (item != NULL) {
+		pr_error("MaxOutstanding is invalid\n");
+		cJSON_Delete(json);
+		free(config->group_name);
+		free(config);
+		return NULL;
+	}
+
 	/* 解析 SendList */
 	send_list = cJSON_GetObjectItemCaseSensitive(json, "SendList");
 	if (!cJSON_IsArray(send_list)) {
@@ -143,9 +210,9 @@ json_config_t *parse_json_file(const char *filename)
 	}
 	config->send_list = send_items;
 
-	/* 解析每个发送项 */
-	for (i = 0; i < config->send_list_count; i++) {
-		send_item = cJSON_GetArrayItem(send_list, i);
+	/* 解析每个发送项，沿链表顺序访问，cJSON_GetArrayItem() 每次从头查找 */
+	send_item = send_list->child;
+	for (i = 0; i < config->send_list_count; i++, send_item = send_item->next) {
 		if (!cJSON_IsObject(send_item)) {
 			pr_error("SendList[%d] is not an object\n", i);
 			cJSON_Delete(json);
@@ -181,12 +248,48 @@ json_config_t *parse_json_file(const char *filename)
 			return NULL;
 		}
 
-		/* 解析 Delay */
+		/* 解析 Delay/DelayUs/DelayChars，三者必须且只能有一个 */
+		send_items[i].delay = -1;
+		send_items[i].delay_us = -1;
+		send_items[i].delay_chars = -1;
+		delay_fields = 0;
+
 		item = cJSON_GetObjectItemCaseSensitive(send_item, "Delay");
 		if (cJSON_IsNumber(item)) {
 			send_items[i].delay = item->valueint;
-		} else {
-			pr_error("SendList[%d].Delay is missing or invalid\n", i);
+			delay_fields++;
+		} else if (item != NULL) {
+			pr_error("SendList[%d].Delay is invalid\n", i);
+			cJSON_Delete(json);
+			free_json_config(config);
+			return NULL;
+		}
+
+		item = cJSON_GetObjectItemCaseSensitive(send_item, "DelayUs");
+		if (cJSON_IsNumber(item)) {
+			send_items[i].delay_us = item->valueint;
+			delay_fields++;
+		} else if (item != NULL) {
+			pr_error("SendList[%d].DelayUs is invalid\n", i);
+			cJSON_Delete(json);
+			free_json_config(config);
+			return NULL;
+		}
+
+		item = cJSON_GetObjectItemCaseSensitive(send_item, "DelayChars");
+		if (cJSON_IsNumber(item)) {
+			send_items[i].delay_chars = item->valuedouble;
+			delay_fields++;
+		} else if (item != NULL) {
+			pr_error("SendList[%d].DelayChars is invalid\n", i);
+			cJSON_Delete(json);
+			free_json_config(config);
+			return NULL;
+		}
+
+		if (delay_fields != 1) {
+			pr_error("SendList[%d] needs exactly one of Delay, DelayUs or DelayChars\n",
+			         i);
 			cJSON_Delete(json);
 			free_json_config(config);
 			return NULL;
@@ -202,12 +305,173 @@ json_config_t *parse_json_file(const char *filename)
 			free_json_config(config);
 			return NULL;
 		}
+
+		/* 解析可选的 ExpectHex/ExpectMask/OnFail/Timeout */
+		if (parse_optional_string(send_item, "ExpectHex", i, &send_items[i].expect_hex) < 0 ||
+		    parse_optional_string(send_item, "ExpectMask", i, &send_items[i].expect_mask) <
+		        0 ||
+		    parse_optional_string(send_item, "OnFail", i, &send_items[i].on_fail) < 0) {
+			cJSON_Delete(json);
+			free_json_config(config);
+			return NULL;
+		}
+
+		send_items[i].timeout = -1;
+		item = cJSON_GetObjectItemCaseSensitive(send_item, "Timeout");
+		if (cJSON_IsNumber(item)) {
+			send_items[i].timeout = item->valueint;
+		} else if (item != NULL) {
+			pr_error("SendList[%d].Timeout is invalid\n", i);
+			cJSON_Delete(json);
+			free_json_config(config);
+			return NULL;
+		}
 	}
 
 	cJSON_Delete(json);
 	return config;
 }
 
+/* 把启用项的 HexData 解码到一块连续内存中，生成发送记录 */
+static int compile_send_list(json_config_t *config)
+{
+	send_item_t *item;
+	send_record_t *rec;
+	size_t total = 0, expect_total = 0, err_pos;
+	uint8_t *expect;
+	int i, len;
+
+	free(config->arena);
+	free(config->records);
+	free(config->expect_arena);
+	config->arena = NULL;
+	config->records = NULL;
+	config->expect_arena = NULL;
+	config->arena_len = 0;
+	config->record_count = 0;
+	config->expect_count = 0;
+
+	for (i = 0; i < config->send_list_count; i++) {
+		item = &config->send_list[i];
+		if (item->enable != 0) {
+			total += strlen(item->hex_data) / 2;
+			config->record_count++;
+			if (item->expect_hex != NULL) {
+				len = strlen(item->expect_hex) / 2;
+				expect_total += item->expect_mask != NULL ? 2 * len : len;
+				config->expect_count++;
+			}
+		}
+	}
+
+	if (config->record_count == 0) {
+		return 0;
+	}
+
+	config->arena = malloc(total);
+	config->records = calloc(config->record_count, sizeof(send_record_t));
+	config->expect_arena = malloc(expect_total + 1);
+	if (config->arena == NULL || config->records == NULL || config->expect_arena == NULL) {
+		pr_error("Failed to allocate memory for send data\n");
+		return -1;
+	}
+	expect = config->expect_arena;
+
+	rec = config->records;
+	for (i = 0; i < config->send_list_count; i++) {
+		item = &config->send_list[i];
+		if (item->enable == 0) {
+			continue;
+		}
+
+		rec->offset = config->arena_len;
+		rec->len = strlen(item->hex_data) / 2;
+		if (item->delay_us >= 0) {
+			rec->delay_ns = item->delay_us * NSEC_PER_USEC;
+		} else if (item->delay_chars >= 0) {
+			rec->delay_chars = item->delay_chars;
+		} else {
+			rec->delay_ns = item->delay * NSEC_PER_MSEC;
+		}
+		rec->item = item;
+		if (hex_decode(item->hex_data, rec->len * 2, config->arena + rec->offset,
+		               &err_pos) < 0) {
+			pr_error("SendList[%d].HexData invalid hex character at position %zu: %c\n",
+			         i, err_pos, item->hex_data[err_pos]);
+			return -1;
+		}
+		config->arena_len += rec->len;
+
+		/* 期望响应和掩码也在加载时解码 */
+		if (item->expect_hex != NULL) {
+			rec->expect_len = strlen(item->expect_hex) / 2;
+			if (hex_decode(item->expect_hex, rec->expect_len * 2, expect, &err_pos) < 0) {
+				pr_error("SendList[%d].ExpectHex invalid hex character at position %zu: "
+				         "%c\n",
+				         i, err_pos, item->expect_hex[err_pos]);
+				return -1;
+			}
+			rec->expect = expect;
+			expect += rec->expect_len;
+			if (item->expect_mask != NULL) {
+				if (hex_decode(item->expect_mask, rec->expect_len * 2, expect, &err_pos) <
+				    0) {
+					pr_error("SendList[%d].ExpectMask invalid hex character at position "
+					         "%zu: %c\n",
+					         i, err_pos, item->expect_mask[err_pos]);
+					return -1;
+				}
+				rec->expect_mask = expect;
+				expect += rec->expect_len;
+			}
+			rec->timeout_ns = item->timeout > 0 ? item->timeout * NSEC_PER_MSEC : 0;
+			parse_on_fail(item->on_fail, &rec->on_fail, &rec->retries);
+		}
+		rec++;
+	}
+
+	return 0;
+}
+
+/* 验证 ExpectHex/ExpectMask/Timeout/OnFail */
+static int validate_expect(const send_item_t *item, int index)
+{
+	on_fail_t on_fail;
+	int retries;
+	int len;
+
+	if (item->expect_hex == NULL) {
+		if (item->expect_mask != NULL || item->timeout != -1 || item->on_fail != NULL) {
+			pr_error("SendList[%d].ExpectMask/Timeout/OnFail need ExpectHex\n", index);
+			return -1;
+		}
+		return 0;
+	}
+
+	len = strlen(item->expect_hex);
+	if (len == 0 || len % 2 != 0 || len / 2 > EXPECT_MAX_LEN) {
+		pr_error("SendList[%d].ExpectHex must be 1-%d bytes of hex, got %d characters\n",
+		         index, EXPECT_MAX_LEN, len);
+		return -1;
+	}
+	if (item->expect_mask != NULL && (int)strlen(item->expect_mask) != len) {
+		pr_error("SendList[%d].ExpectMask must be as long as ExpectHex\n", index);
+		return -1;
+	}
+	if (item->timeout != -1 && (item->timeout < 1 || item->timeout > EXPECT_MAX_TIMEOUT)) {
+		pr_error("SendList[%d].Timeout must be 1-%d, got %d\n", index, EXPECT_MAX_TIMEOUT,
+		         item->timeout);
+		return -1;
+	}
+	if (parse_on_fail(item->on_fail, &on_fail, &retries) < 0) {
+		pr_error("SendList[%d].OnFail must be continue, stop, retry or retry:1-%d, got %s\n",
+		         index, EXPECT_MAX_RETRIES, item->on_fail);
+		return -1;
+	}
+
+	return 0;
+}
+
 int validate_json_config(json_config_t *config)
 {
 	int i;
@@ -230,14 +494,36 @@ int validate_json_config(json_config_t *config)
 		return -1;
 	}
 
+	/* 验证 MaxOutstanding */
+	if (config->max_outstanding < 1 || config->max_outstanding > MAX_OUTSTANDING_LIMIT) {
+		pr_error("MaxOutstanding must be 1-%d, got %d\n", MAX_OUTSTANDING_LIMIT,
+		         config->max_outstanding);
+		return -1;
+	}
+
 	/* 验证每个发送项 */
 	for (i = 0; i < config->send_list_count; i++) {
 		/* 验证 Delay 范围 */
-		if (config->send_list[i].delay < 1 || config->send_list[i].delay > 1000) {
+		if (config->send_list[i].delay != -1 &&
+		    (config->send_list[i].delay < 1 || config->send_list[i].delay > 1000)) {
 			pr_error("SendList[%d].Delay must be 1-1000, got %d\n", i,
 			         config->send_list[i].delay);
 			return -1;
 		}
+		if (config->send_list[i].delay_us != -1 &&
+		    (config->send_list[i].delay_us < 0 ||
+		     config->send_list[i].delay_us > 1000000)) {
+			pr_error("SendList[%d].DelayUs must be 0-1000000, got %d\n", i,
+			         config->send_list[i].delay_us);
+			return -1;
+		}
+		if (config->send_list[i].delay_chars != -1 &&
+		    (config->send_list[i].delay_chars < 0 ||
+		     config->send_list[i].delay_chars > 100000)) {
+			pr_error("SendList[%d].DelayChars must be 0-100000, got %g\n", i,
+			         config->send_list[i].delay_chars);
+			return -1;
+		}
 
 		/* 验证 HexData 格式 */
 		if (config->send_list[i].hex_data == NULL) {
@@ -257,8 +543,45 @@ int validate_json_config(json_config_t *config)
 			         i, len);
 			return -1;
 		}
+
+		if (validate_expect(&config->send_list[i], i) < 0) {
+			return -1;
+		}
+	}
+
+	return compile_send_list(config);
+}
+
+int json_config_add_checksum(json_config_t *config, const checksum_t *cs)
+{
+	uint8_t *arena, *p;
+	send_record_t *rec;
+	int i;
+
+	if (config == NULL || cs == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	arena = malloc(config->arena_len + (size_t)config->record_count * checksum_size(cs) + 1);
+	if (arena == NULL) {
+		pr_error("Failed to allocate memory for send data\n");
+		return -1;
+	}
+
+	p = arena;
+	for (i = 0; i < config->record_count; i++) {
+		rec = &config->records[i];
+		memcpy(p, config->arena + rec->offset, rec->len);
+		rec->len += checksum_append(cs, p, rec->len, p + rec->len);
+		rec->offset = p - arena;
+		p += rec->len;
 	}
 
+	free(config->arena);
+	config->arena = arena;
+	config->arena_len = p - arena;
+
 	return 0;
 }
 
@@ -276,9 +599,15 @@ void free_json_config(json_config_t *config)
 		for (i = 0; i < config->send_list_count; i++) {
 			if (config->send_list[i].hex_data)
 				free(config->send_list[i].hex_data);
+			free(config->send_list[i].expect_hex);
+			free(config->send_list[i].expect_mask);
+			free(config->send_list[i].on_fail);
 		}
 		free(config->send_list);
 	}
 
+	free(config->arena);
+	free(config->records);
+	free(config->expect_arena);
 	free(config);
 }
@@ -0,0 +1,173 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "lowlat.h"
+#include "mydebug.h"
+#include <errno.h>
+#include <limits.h>
+#include <linux/serial.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+int lowlat_set_async(uartdev_t *dev, int enable)
+{
+	struct serial_struct ss;
+
+	if (dev == NULL || dev->fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ioctl(dev->fd, TIOCGSERIAL, &ss) < 0) {
+		return -1;
+	}
+
+	if (enable) {
+		ss.flags |= ASYNC_LOW_LATENCY;
+	} else {
+		ss.flags &= ~ASYNC_LOW_LATENCY;
+	}
+
+	if (ioctl(dev->fd, TIOCSSERIAL, &ss) < 0) {
+		return -1;
+	}
+
+	/* 部分驱动接受调用但忽略该标志，读回确认 */
+	if (ioctl(dev->fd, TIOCGSERIAL, &ss) < 0) {
+		return -1;
+	}
+	if (!!(ss.flags & ASYNC_LOW_LATENCY) != !!enable) {
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	return 0;
+}
+
+int lowlat_timer_path(const uartdev_t *dev, char *path, size_t len)
+{
+	char real[PATH_MAX];
+	const char *name;
+	FILE *fp;
+
+	if (dev == NULL || dev->port == NULL || realpath(dev->port, real) == NULL) {
+		return -1;
+	}
+
+	name = strrchr(real, '/');
+	name = name ? name + 1 : real;
+	/* 名字不截断，超长时返回 ENAMETOOLONG，而不是去查一个错误的路径 */
+	if (snprintf(path, len, "/sys/class/tty/%s/device/latency_timer", name) >= (int)len) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return -1;
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+int lowlat_get_timer(const uartdev_t *dev)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+	int ms;
+
+	if (lowlat_timer_path(dev, path, sizeof(path)) < 0) {
+		return -1;
+	}
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fscanf(fp, "%d", &ms) != 1) {
+		ms = -1;
+	}
+	fclose(fp);
+
+	return ms;
+}
+
+int lowlat_set_timer(const uartdev_t *dev, int ms)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	if (ms < LATENCY_TIMER_MIN || ms > LATENCY_TIMER_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (lowlat_timer_path(dev, path, sizeof(path)) < 0) {
+		if (errno != ENAMETOOLONG) {
+			errno = ENOENT;
+		}
+		return -1;
+	}
+
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		return -1;
+	}
+	fprintf(fp, "%d\n", ms);
+	if (fclose(fp) != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int lowlat_apply(uartdev_t *dev, int low_latency, int timer_ms)
+{
+	int old;
+	int ret = 0;
+
+	if (low_latency) {
+		if (lowlat_set_async(dev, 1) < 0) {
+			pr_info("%s: ASYNC_LOW_LATENCY not supported (%s)\n", dev->port,
+			        strerror(errno));
+		} else {
+			pr_info("%s: ASYNC_LOW_LATENCY enabled\n", dev->port);
+		}
+	}
+
+	old = lowlat_get_timer(dev);
+	if (old < 0) {
+		if (timer_ms > 0 && errno == ENAMETOOLONG) {
+			pr_error("%s: latency_timer path: %s\n", dev->port, strerror(errno));
+			ret = -1;
+		} else if (timer_ms > 0) {
+			pr_error("%s: no latency_timer in sysfs (only FTDI-style USB adapters have "
+			         "one)\n",
+			         dev->port);
+			ret = -1;
+		}
+		return ret;
+	}
+
+	if (timer_ms > 0 && timer_ms != old) {
+		if (lowlat_set_timer(dev, timer_ms) < 0) {
+			pr_error("%s: failed to set latency_timer to %d ms: %s\n", dev->port,
+			         timer_ms, strerror(errno));
+			return -1;
+		}
+		pr_info("%s: latency_timer %d ms -> %d ms\n", dev->port, old,
+		        lowlat_get_timer(dev));
+	} else {
+		pr_info("%s: latency_timer %d ms\n", dev->port, old);
+	}
+
+	return ret;
+}
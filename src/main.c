@@ -7,7 +7,20 @@ Free Software Foundation.
 */
 
 #include "args_parser.h"
+#include "bridge.h"
+#include "lowlat.h"
+#include "metrics.h"
+#include "modbus.h"
+#include "multiport.h"
 #include "mydebug.h"
+#include "ping.h"
+#include "prbs.h"
+#include "replay.h"
+#include "send_file.h"
+#include "server.h"
+#include "throughput.h"
+#include "trace.h"
+#include "trigger.h"
 #include "uart_assist.h"
 #include "uartdev.h"
 #include <errno.h>
@@ -20,6 +33,9 @@ Free Software Foundation.
 /* 全局运行标志，用于信号处理 */
 volatile int g_running = 1;
 
+/* 安静模式，不打印逐包输出 */
+int g_quiet = 0;
+
 /* 信号处理函数 */
 static void signal_handler(int sig)
 {
@@ -33,6 +49,8 @@ int main(int argc, char *argv[])
 {
 	uart_config_t config;
 	uartdev_t *dev = NULL;
+	trigger_t *trigger = NULL;
+	int exit_code;
 	int ret = 0;
 
 	/* 注册信号处理 */
@@ -49,11 +67,35 @@ int main(int argc, char *argv[])
 		return EXIT_SUCCESS;
 	}
 
+	/* 安静模式、指标导出线程和跟踪在所有模式开始前设置 */
+	g_quiet = config.quiet;
+	if (config.metrics_file != NULL &&
+	    metrics_open(config.metrics_file, config.metrics_format, config.metrics_interval) < 0) {
+		free_config(&config);
+		return EXIT_FAILURE;
+	}
+	if (config.trace_file != NULL && trace_open(config.trace_file) < 0) {
+		metrics_close();
+		free_config(&config);
+		return EXIT_FAILURE;
+	}
+
+	/* 多个设备时，由 epoll 多端口引擎统一驱动 */
+	if (config.device_count > 1) {
+		ret = uart_multi_test(&config);
+		metrics_close();
+		trace_close();
+		free_config(&config);
+		return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
 	/* 创建串口设备 */
 	dev = uartdev_new(config.device, config.baud, config.data_bit, config.parity,
 	                  config.stop_bit);
 	if (dev == NULL) {
 		pr_error("Failed to create uart device: %s\n", strerror(errno));
+		metrics_close();
+		trace_close();
 		free_config(&config);
 		return EXIT_FAILURE;
 	}
@@ -62,12 +104,24 @@ int main(int argc, char *argv[])
 	if (uartdev_setup(dev) < 0) {
 		pr_error("Failed to setup uart device: %s\n", strerror(errno));
 		uartdev_del(dev);
+		metrics_close();
+		trace_close();
 		free_config(&config);
 		return EXIT_FAILURE;
 	}
 
 	pr_info("UART device opened: %s, %d, %d%c%d\n", config.device, config.baud, config.data_bit,
 	        config.parity, config.stop_bit);
+	print_baud_info(dev);
+
+	/* 打印 USB 转串口芯片的 latency_timer，按需降低接收延迟 */
+	if (lowlat_apply(dev, config.low_latency, config.latency_timer) < 0) {
+		uartdev_del(dev);
+		metrics_close();
+		trace_close();
+		free_config(&config);
+		return EXIT_FAILURE;
+	}
 
 	/* 根据模式执行测试 */
 	switch (config.mode) {
@@ -76,16 +130,62 @@ int main(int argc, char *argv[])
 		break;
 
 	case MODE_SEND:
+		if (config.send_file != NULL) {
+			ret = uart_send_file_test(dev, config.send_file);
+			break;
+		}
 		ret = uart_send_test(dev, config.send_string, config.send_interval,
-		                     config.send_count, config.format);
+		                     config.send_count, config.format, config.checksum_spec);
 		break;
 
 	case MODE_RECV:
-		ret = uart_recv_test(dev, config.format);
+		if (config.trigger_count > 0) {
+			trigger = malloc(sizeof(trigger_t));
+			if (trigger == NULL ||
+			    trigger_setup(trigger, config.device, config.triggers, config.trigger_count,
+			                  config.actions, config.action_count) < 0) {
+				free(trigger);
+				trigger = NULL;
+				ret = -1;
+				break;
+			}
+		}
+		ret = uart_recv_test(dev, config.format, config.capture_file, config.frame_spec,
+		                     config.checksum_spec, trigger);
 		break;
 
 	case MODE_FILE:
-		ret = uart_file_test(dev, config.json_file);
+		ret = uart_file_test(dev, config.json_file, config.spin_us, config.checksum_spec,
+		                     config.timeout_ms);
+		break;
+
+	case MODE_BENCH:
+		ret = uart_bench_test(dev, config.duration);
+		break;
+
+	case MODE_PRBS:
+		ret = uart_prbs_test(dev, config.prbs_order, config.duration);
+		break;
+
+	case MODE_REPLAY:
+		ret = uart_replay_test(dev, config.json_file, config.speed);
+		break;
+
+	case MODE_PING:
+		ret = uart_ping_test(dev, config.send_string, config.format, config.send_interval,
+		                     config.send_count, config.timeout_ms);
+		break;
+
+	case MODE_MODBUS:
+		ret = uart_modbus_test(dev, config.send_string, config.duration, config.timeout_ms);
+		break;
+
+	case MODE_BRIDGE:
+		ret = uart_bridge_test(dev, &config);
+		break;
+
+	case MODE_SERVER:
+		ret = uart_server_test(dev, config.listen);
 		break;
 
 	default:
@@ -94,13 +194,21 @@ int main(int argc, char *argv[])
 		break;
 	}
 
+	/* exit 动作匹配时使用指定的退出码 */
+	exit_code = ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	if (trigger != NULL) {
+		if (trigger->fired_exit) {
+			exit_code = trigger->exit_code;
+		}
+		trigger_free(trigger);
+		free(trigger);
+	}
+
 	/* 清理资源 */
+	metrics_close();
+	trace_close();
 	uartdev_del(dev);
 	free_config(&config);
 
-	if (ret < 0) {
-		return EXIT_FAILURE;
-	}
-
-	return EXIT_SUCCESS;
+	return exit_code;
 }
@@ -0,0 +1,324 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "metrics.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define METRICS_POLL_MS 100 /* 导出线程检查退出标志的间隔 */
+
+/* 导出线程为每个端口保存的上一次的值，用于计算速率 */
+typedef struct {
+	uint64_t tx_bytes;
+	uint64_t rx_bytes;
+} metrics_last_t;
+
+static struct {
+	int enabled;
+	int stop;
+	int error;                 /* 写文件失败后只报告一次 */
+	metrics_format_t format;
+	int interval_sec;
+	char path[PATH_MAX];
+	char tmp_path[PATH_MAX + 8];
+	pthread_t tid;
+	pthread_mutex_t lock;      /* 只保护端口注册，计数不加锁 */
+	int count;                 /* 已注册的端口数 */
+	int64_t start_ns;
+	int64_t last_ns;           /* 上次导出的时间 */
+	metrics_port_t ports[METRICS_MAX_PORTS];
+	metrics_last_t last[METRICS_MAX_PORTS];
+} g_metrics = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+metrics_port_t *metrics_port(const char *port)
+{
+	metrics_port_t *m = NULL;
+	int i;
+
+	if (!g_metrics.enabled || port == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&g_metrics.lock);
+	for (i = 0; i < g_metrics.count; i++) {
+		if (strcmp(g_metrics.ports[i].port, port) == 0) {
+			m = &g_metrics.ports[i];
+			break;
+		}
+	}
+	if (m == NULL && g_metrics.count < METRICS_MAX_PORTS) {
+		m = &g_metrics.ports[g_metrics.count];
+		snprintf(m->port, sizeof(m->port), "%s", port);
+		/* 端口名写好后才对导出线程可见 */
+		__atomic_store_n(&g_metrics.count, g_metrics.count + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&g_metrics.lock);
+
+	return m;
+}
+
+/* 输出带引号的字符串，转义 JSON 和 Prometheus 标签共同需要转义的字符 */
+static void metrics_quote(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			fputc('\\', fp);
+			fputc(*s, fp);
+		} else if (*s == '\n') {
+			fputs("\\n", fp);
+		} else {
+			fputc(*s, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+/* 读取一个端口的计数快照 */
+static void metrics_snapshot(const metrics_port_t *m, metrics_port_t *s)
+{
+	memcpy(s->port, m->port, sizeof(s->port));
+	s->tx_bytes = __atomic_load_n(&m->tx_bytes, __ATOMIC_RELAXED);
+	s->tx_packets = __atomic_load_n(&m->tx_packets, __ATOMIC_RELAXED);
+	s->rx_bytes = __atomic_load_n(&m->rx_bytes, __ATOMIC_RELAXED);
+	s->rx_packets = __atomic_load_n(&m->rx_packets, __ATOMIC_RELAXED);
+	s->timeouts = __atomic_load_n(&m->timeouts, __ATOMIC_RELAXED);
+	s->errors = __atomic_load_n(&m->errors, __ATOMIC_RELAXED);
+	s->late_count = __atomic_load_n(&m->late_count, __ATOMIC_RELAXED);
+	s->late_sum_ns = __atomic_load_n(&m->late_sum_ns, __ATOMIC_RELAXED);
+	s->late_max_ns = __atomic_load_n(&m->late_max_ns, __ATOMIC_RELAXED);
+}
+
+static void metrics_write_json(FILE *fp, const metrics_port_t *s, int n, double now,
+                               double elapsed, double dt)
+{
+	metrics_last_t *last;
+	int i;
+
+	fprintf(fp, "{\"time\":%.3f,\"elapsed\":%.3f,\"ports\":[", now, elapsed);
+	for (i = 0; i < n; i++) {
+		last = &g_metrics.last[i];
+		fprintf(fp, "%s{\"port\":", i > 0 ? "," : "");
+		metrics_quote(fp, s[i].port);
+		fprintf(fp,
+		        ",\"tx_bytes\":%llu,\"tx_packets\":%llu,\"rx_bytes\":%llu,"
+		        "\"rx_packets\":%llu,\"tx_rate\":%.1f,\"rx_rate\":%.1f,\"timeouts\":%llu,"
+		        "\"errors\":%llu,\"late_count\":%llu,\"late_avg_us\":%.3f,"
+		        "\"late_max_us\":%.3f}",
+		        (unsigned long long)s[i].tx_bytes, (unsigned long long)s[i].tx_packets,
+		        (unsigned long long)s[i].rx_bytes, (unsigned long long)s[i].rx_packets,
+		        dt > 0 ? (s[i].tx_bytes - last->tx_bytes) / dt : 0.0,
+		        dt > 0 ? (s[i].rx_bytes - last->rx_bytes) / dt : 0.0,
+		        (unsigned long long)s[i].timeouts, (unsigned long long)s[i].errors,
+		        (unsigned long long)s[i].late_count,
+		        s[i].late_count ? s[i].late_sum_ns / 1e3 / s[i].late_count : 0.0,
+		        s[i].late_max_ns / 1e3);
+	}
+	fprintf(fp, "]}\n");
+}
+
+/* Prometheus 指标，按表中顺序输出 */
+enum {
+	PROM_TX_BYTES,
+	PROM_TX_PACKETS,
+	PROM_RX_BYTES,
+	PROM_RX_PACKETS,
+	PROM_TIMEOUTS,
+	PROM_ERRORS,
+	PROM_LATE_COUNT,
+	PROM_LATE_SUM,
+	PROM_LATE_MAX,
+	PROM_TX_RATE,
+	PROM_RX_RATE,
+	PROM_COUNT
+};
+
+static const struct {
+	const char *name;
+	const char *type;
+	const char *help;
+} prom_metrics[PROM_COUNT] = {
+    {"tx_bytes_total", "counter", "Bytes written to the port."},
+    {"tx_packets_total", "counter", "Writes to the port."},
+    {"rx_bytes_total", "counter", "Bytes read from the port."},
+    {"rx_packets_total", "counter", "Reads from the port."},
+    {"timeouts_total", "counter", "Receive or response timeouts."},
+    {"errors_total", "counter", "I/O errors, dropped data, bad checksums and failed responses."},
+    {"schedule_late_count", "counter", "Scheduled sends measured for lateness."},
+    {"schedule_late_seconds_sum", "counter", "Total time sends started after their deadline."},
+    {"schedule_late_seconds_max", "gauge", "Largest send lateness."},
+    {"tx_rate_bytes", "gauge", "Bytes per second written over the last interval."},
+    {"rx_rate_bytes", "gauge", "Bytes per second read over the last interval."},
+};
+
+static double prom_value(int k, const metrics_port_t *s, const metrics_last_t *last, double dt)
+{
+	switch (k) {
+	case PROM_TX_BYTES:
+		return (double)s->tx_bytes;
+	case PROM_TX_PACKETS:
+		return (double)s->tx_packets;
+	case PROM_RX_BYTES:
+		return (double)s->rx_bytes;
+	case PROM_RX_PACKETS:
+		return (double)s->rx_packets;
+	case PROM_TIMEOUTS:
+		return (double)s->timeouts;
+	case PROM_ERRORS:
+		return (double)s->errors;
+	case PROM_LATE_COUNT:
+		return (double)s->late_count;
+	case PROM_LATE_SUM:
+		return s->late_sum_ns / 1e9;
+	case PROM_LATE_MAX:
+		return s->late_max_ns / 1e9;
+	case PROM_TX_RATE:
+		return dt > 0 ? (s->tx_bytes - last->tx_bytes) / dt : 0.0;
+	default:
+		return dt > 0 ? (s->rx_bytes - last->rx_bytes) / dt : 0.0;
+	}
+}
+
+static void metrics_write_prom(FILE *fp, const metrics_port_t *s, int n, double now, double dt)
+{
+	int k, i;
+
+	for (k = 0; k < PROM_COUNT; k++) {
+		fprintf(fp, "# HELP uart_assist_%s %s\n# TYPE uart_assist_%s %s\n", prom_metrics[k].name,
+		        prom_metrics[k].help, prom_metrics[k].name, prom_metrics[k].type);
+		for (i = 0; i < n; i++) {
+			fprintf(fp, "uart_assist_%s{port=", prom_metrics[k].name);
+			metrics_quote(fp, s[i].port);
+			fprintf(fp, "} %.17g\n", prom_value(k, &s[i], &g_metrics.last[i], dt));
+		}
+	}
+	fprintf(fp, "# HELP uart_assist_last_update_seconds Unix time of this update.\n"
+	            "# TYPE uart_assist_last_update_seconds gauge\n"
+	            "uart_assist_last_update_seconds %.3f\n",
+	        now);
+}
+
+/* 导出所有端口当前的计数 */
+static void metrics_dump(void)
+{
+	static metrics_port_t snap[METRICS_MAX_PORTS];
+	struct timespec rt;
+	int64_t mono = timing_now_ns();
+	double now, dt;
+	FILE *fp;
+	int n, i, ok;
+
+	n = __atomic_load_n(&g_metrics.count, __ATOMIC_ACQUIRE);
+	for (i = 0; i < n; i++) {
+		metrics_snapshot(&g_metrics.ports[i], &snap[i]);
+	}
+
+	clock_gettime(CLOCK_REALTIME, &rt);
+	now = rt.tv_sec + rt.tv_nsec / 1e9;
+	dt = (mono - g_metrics.last_ns) / 1e9;
+
+	if (g_metrics.format == METRICS_JSON) {
+		fp = fopen(g_metrics.path, "a");
+	} else {
+		/* textfile collector 可能随时读取，先写临时文件再原子替换 */
+		fp = fopen(g_metrics.tmp_path, "w");
+	}
+	if (fp == NULL) {
+		ok = 0;
+	} else {
+		if (g_metrics.format == METRICS_JSON) {
+			metrics_write_json(fp, snap, n, now, (mono - g_metrics.start_ns) / 1e9, dt);
+		} else {
+			metrics_write_prom(fp, snap, n, now, dt);
+		}
+		ok = !ferror(fp);
+		ok = fclose(fp) == 0 && ok;
+		if (ok && g_metrics.format == METRICS_PROM) {
+			ok = rename(g_metrics.tmp_path, g_metrics.path) == 0;
+		}
+	}
+	if (!ok && !g_metrics.error) {
+		g_metrics.error = errno;
+		pr_error("Failed to write metrics to %s: %s\n", g_metrics.path, strerror(errno));
+	} else if (ok) {
+		g_metrics.error = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		g_metrics.last[i].tx_bytes = snap[i].tx_bytes;
+		g_metrics.last[i].rx_bytes = snap[i].rx_bytes;
+	}
+	g_metrics.last_ns = mono;
+}
+
+static void *metrics_thread(void *arg)
+{
+	int64_t next = g_metrics.start_ns + (int64_t)g_metrics.interval_sec * NSEC_PER_SEC;
+	struct timespec ts = {0, METRICS_POLL_MS * NSEC_PER_MSEC};
+
+	(void)arg;
+	while (!__atomic_load_n(&g_metrics.stop, __ATOMIC_ACQUIRE)) {
+		if (timing_now_ns() >= next) {
+			metrics_dump();
+			next += (int64_t)g_metrics.interval_sec * NSEC_PER_SEC;
+		}
+		nanosleep(&ts, NULL);
+	}
+
+	return NULL;
+}
+
+int metrics_open(const char *path, metrics_format_t format, int interval_sec)
+{
+	int ret;
+
+	if (path == NULL || interval_sec < 1 || interval_sec > METRICS_MAX_INTERVAL ||
+	    strlen(path) >= sizeof(g_metrics.path)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	snprintf(g_metrics.path, sizeof(g_metrics.path), "%s", path);
+	snprintf(g_metrics.tmp_path, sizeof(g_metrics.tmp_path), "%s.tmp", path);
+	g_metrics.format = format;
+	g_metrics.interval_sec = interval_sec;
+	g_metrics.start_ns = timing_now_ns();
+	g_metrics.last_ns = g_metrics.start_ns;
+	g_metrics.stop = 0;
+
+	ret = pthread_create(&g_metrics.tid, NULL, metrics_thread, NULL);
+	if (ret != 0) {
+		pr_error("Failed to create metrics thread: %s\n", strerror(ret));
+		return -1;
+	}
+	g_metrics.enabled = 1;
+
+	pr_info("Metrics: %s every %d s to %s\n",
+	        format == METRICS_JSON ? "JSON lines" : "Prometheus textfile", interval_sec, path);
+	return 0;
+}
+
+void metrics_close(void)
+{
+	if (!g_metrics.enabled) {
+		return;
+	}
+
+	__atomic_store_n(&g_metrics.stop, 1, __ATOMIC_RELEASE);
+	pthread_join(g_metrics.tid, NULL);
+	metrics_dump();
+	g_metrics.enabled = 0;
+}
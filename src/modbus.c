@@ -0,0 +1,358 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "modbus.h"
+#include "crc.h"
+#include "histogram.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+#define MODBUS_MAX_SLAVE 247
+#define MODBUS_EXCEPTION_LEN 5 /* 异常响应：地址、功能码|0x80、异常码、CRC */
+
+/* 按从站统计 */
+typedef struct {
+	int slave;
+	long requests;
+	long ok;
+	long timeouts;
+	long crc_errors;
+	long exceptions;
+	long bad;          /* 地址、功能码或长度不对 */
+	histogram_t *latency;
+} modbus_stat_t;
+
+static int parse_field(const char **p, char sep, long min, long max, long *val)
+{
+	char *end;
+
+	errno = 0;
+	*val = strtol(*p, &end, 10);
+	if (end == *p || errno != 0 || *val < min || *val > max || *end != sep) {
+		return -1;
+	}
+	*p = *end ? end + 1 : end;
+	return 0;
+}
+
+int modbus_parse_requests(const char *spec, modbus_req_t *reqs)
+{
+	const char *p = spec;
+	modbus_req_t *r;
+	long slave, function, address, count;
+	uint16_t crc;
+	int n = 0;
+	char sep;
+
+	if (spec == NULL || reqs == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	while (*p) {
+		if (n >= MODBUS_MAX_REQUESTS) {
+			pr_error("Too many Modbus requests (max %d)\n", MODBUS_MAX_REQUESTS);
+			return -1;
+		}
+
+		sep = strchr(p, ',') ? ',' : '\0';
+		if (parse_field(&p, ':', 1, MODBUS_MAX_SLAVE, &slave) < 0 ||
+		    parse_field(&p, ':', 1, 4, &function) < 0 ||
+		    parse_field(&p, ':', 0, 0xFFFF, &address) < 0 ||
+		    parse_field(&p, sep, 1,
+		                function <= 2 ? MODBUS_MAX_BITS : MODBUS_MAX_REGS, &count) < 0) {
+			pr_error("Invalid Modbus request in \"%s\" (should be "
+			         "slave(1-%d):function(1-4):address:count, count 1-%d for "
+			         "registers, 1-%d for coils)\n",
+			         spec, MODBUS_MAX_SLAVE, MODBUS_MAX_REGS, MODBUS_MAX_BITS);
+			return -1;
+		}
+		if (address + count > 0x10000) {
+			pr_error("Modbus request %ld:%ld:%ld:%ld exceeds address 65535\n", slave,
+			         function, address, count);
+			return -1;
+		}
+
+		r = &reqs[n++];
+		r->slave = slave;
+		r->function = function;
+		r->address = address;
+		r->count = count;
+		r->adu[0] = slave;
+		r->adu[1] = function;
+		r->adu[2] = address >> 8;
+		r->adu[3] = address & 0xFF;
+		r->adu[4] = count >> 8;
+		r->adu[5] = count & 0xFF;
+		crc = crc16_modbus(r->adu, 6);
+		r->adu[6] = crc & 0xFF;
+		r->adu[7] = crc >> 8;
+		/* 地址、功能码、字节数、数据、CRC */
+		r->resp_len = 3 + (function <= 2 ? (count + 7) / 8 : count * 2) + 2;
+	}
+
+	if (n == 0) {
+		pr_error("No Modbus request given (-s slave:function:address:count,...)\n");
+		return -1;
+	}
+
+	return n;
+}
+
+int64_t modbus_t35_ns(const uartdev_t *dev)
+{
+	if (dev->baud > 19200) {
+		return MODBUS_T35_FIXED_NS;
+	}
+	return uartdev_char_time_ns(dev) * 7 / 2;
+}
+
+/*
+ * 读取响应，收到 want 个字节、收到完整的异常响应或超时后返回。
+ * 返回: 收到的字节数, -1 读出错
+ */
+static int modbus_read_response(uartdev_t *dev, uint8_t *buf, int want, int64_t deadline_ns,
+                                int64_t *last_ns)
+{
+	struct pollfd pfd;
+	int64_t now;
+	int got = 0, n, timeout;
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLIN;
+
+	while (got < want && g_running) {
+		now = timing_now_ns();
+		if (now >= deadline_ns) {
+			break;
+		}
+		timeout = (int)((deadline_ns - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+		n = poll(&pfd, 1, timeout);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0) {
+			continue;
+		}
+
+		n = read(dev->fd, buf + got, want - got);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			return -1;
+		}
+		got += n;
+		*last_ns = timing_now_ns();
+
+		if (got >= 2 && (buf[1] & 0x80) && want > MODBUS_EXCEPTION_LEN) {
+			want = MODBUS_EXCEPTION_LEN;
+		}
+	}
+
+	return got;
+}
+
+/* 出错后丢弃线路上剩余的数据，直到空闲 T3.5，保证下一个请求重新对齐帧边界 */
+static void modbus_resync(uartdev_t *dev, int64_t t35_ns, int64_t *last_ns)
+{
+	struct pollfd pfd;
+	uint8_t junk[MODBUS_MAX_ADU];
+	int timeout = (int)((t35_ns + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLIN;
+
+	while (g_running && poll(&pfd, 1, timeout) > 0) {
+		if (read(dev->fd, junk, sizeof(junk)) <= 0) {
+			break;
+		}
+		*last_ns = timing_now_ns();
+	}
+	tcflush(dev->fd, TCIFLUSH);
+}
+
+static modbus_stat_t *modbus_stat_get(modbus_stat_t *stats, int *index, int *count, int slave)
+{
+	if (index[slave] < 0) {
+		index[slave] = (*count)++;
+		stats[index[slave]].slave = slave;
+	}
+	return &stats[index[slave]];
+}
+
+int uart_modbus_test(uartdev_t *dev, const char *spec, int duration, int timeout_ms)
+{
+	modbus_req_t reqs[MODBUS_MAX_REQUESTS];
+	modbus_stat_t stats[MODBUS_MAX_REQUESTS];
+	int index[MODBUS_MAX_SLAVE + 1];
+	modbus_stat_t *st;
+	modbus_req_t *req;
+	uint8_t resp[MODBUS_MAX_ADU];
+	int64_t t35_ns, start_ns, end_ns, next_report_ns, t0, last_ns, now;
+	long total = 0, last_total = 0;
+	int req_count, stat_count = 0;
+	int i, got, valid, cur = 0;
+	int ret = 0;
+
+	if (dev == NULL || spec == NULL || timeout_ms <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	req_count = modbus_parse_requests(spec, reqs);
+	if (req_count < 0) {
+		return -1;
+	}
+
+	memset(stats, 0, sizeof(stats));
+	for (i = 0; i <= MODBUS_MAX_SLAVE; i++) {
+		index[i] = -1;
+	}
+	for (i = 0; i < req_count; i++) {
+		modbus_stat_get(stats, index, &stat_count, reqs[i].slave);
+	}
+	for (i = 0; i < stat_count; i++) {
+		stats[i].latency = malloc(sizeof(histogram_t));
+		if (stats[i].latency == NULL) {
+			pr_error("Failed to allocate memory for latency histogram\n");
+			ret = -1;
+			goto out;
+		}
+		hist_init(stats[i].latency);
+	}
+
+	t35_ns = modbus_t35_ns(dev);
+	pr_info("Modbus RTU master: %d requests, %d slaves, T3.5=%.0f us, timeout=%d ms, "
+	        "duration=%d s%s\n",
+	        req_count, stat_count, t35_ns / 1e3, timeout_ms, duration,
+	        duration == 0 ? " (infinite)" : "");
+	for (i = 0; i < req_count; i++) {
+		pr_info("  [%d] slave %d, function %d, address %d, count %d, response %d bytes\n",
+		        i, reqs[i].slave, reqs[i].function, reqs[i].address, reqs[i].count,
+		        reqs[i].resp_len);
+	}
+
+	uartdev_flush(dev);
+	start_ns = timing_now_ns();
+	end_ns = start_ns + (int64_t)duration * NSEC_PER_SEC;
+	next_report_ns = start_ns + NSEC_PER_SEC;
+	last_ns = start_ns - t35_ns;
+
+	while (g_running && (duration == 0 || timing_now_ns() < end_ns)) {
+		req = &reqs[cur];
+		st = &stats[index[req->slave]];
+		cur = (cur + 1) % req_count;
+
+		/* 请求之前线路至少空闲 T3.5 */
+		timing_sleep_until(last_ns + t35_ns);
+
+		t0 = timing_now_ns();
+		if (uartdev_send_all(dev, (const char *)req->adu, sizeof(req->adu),
+		                     &g_running) < 0) {
+			/* 被 Ctrl+C 中断，不是发送失败 */
+			if (!g_running) {
+				break;
+			}
+			pr_error("Failed to send request: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+		last_ns = t0;
+
+		got = modbus_read_response(dev, resp, req->resp_len,
+		                           t0 + (int64_t)timeout_ms * NSEC_PER_MSEC, &last_ns);
+		if (got < 0) {
+			pr_error("Failed to receive response: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+		if (!g_running) {
+			break;
+		}
+
+		total++;
+		st->requests++;
+		valid = 0;
+		if (got == 0) {
+			st->timeouts++;
+		} else if (got < MODBUS_EXCEPTION_LEN || crc16_modbus(resp, got) != 0) {
+			/* 含 CRC 的整帧再算一次 CRC 结果为 0，超时收到的半帧也计为 CRC 错误 */
+			st->crc_errors++;
+		} else if (resp[0] != req->slave || (resp[1] & 0x7F) != req->function) {
+			st->bad++;
+		} else if (resp[1] & 0x80) {
+			st->exceptions++;
+			valid = 1;
+		} else if (got != req->resp_len || resp[2] != req->resp_len - 5) {
+			st->bad++;
+		} else {
+			st->ok++;
+			valid = 1;
+		}
+
+		if (valid) {
+			hist_add(st->latency, last_ns - t0);
+		} else {
+			modbus_resync(dev, t35_ns, &last_ns);
+		}
+
+		now = timing_now_ns();
+		if (now >= next_report_ns) {
+			long timeouts = 0, errors = 0;
+
+			for (i = 0; i < stat_count; i++) {
+				timeouts += stats[i].timeouts;
+				errors += stats[i].crc_errors + stats[i].bad;
+			}
+			printf("Modbus [%llds] : %ld req/s, total %ld, timeouts %ld, errors %ld\n",
+			       (long long)((now - start_ns) / NSEC_PER_SEC), total - last_total, total,
+			       timeouts, errors);
+			last_total = total;
+			next_report_ns += NSEC_PER_SEC * ((now - next_report_ns) / NSEC_PER_SEC + 1);
+		}
+	}
+
+	now = timing_now_ns();
+	pr_info("Modbus test completed: %ld requests in %.1f s, %.1f req/s\n", total,
+	        (now - start_ns) / 1e9, total * 1e9 / (now - start_ns > 0 ? now - start_ns : 1));
+	printf("  Slave  Requests        OK  Timeouts  CRC errors  Exceptions       Bad\n");
+	for (i = 0; i < stat_count; i++) {
+		st = &stats[i];
+		printf("  %5d  %8ld  %8ld  %8ld  %10ld  %10ld  %8ld\n", st->slave, st->requests,
+		       st->ok, st->timeouts, st->crc_errors, st->exceptions, st->bad);
+		if (st->requests != st->ok + st->exceptions) {
+			ret = -1;
+		}
+	}
+	for (i = 0; i < stat_count; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "Slave %d latency", stats[i].slave);
+		hist_report_us(stats[i].latency, name);
+	}
+
+out:
+	for (i = 0; i < stat_count; i++) {
+		free(stats[i].latency);
+	}
+
+	return ret;
+}
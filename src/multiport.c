@@ -0,0 +1,564 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "lowlat.h"
+#include "metrics.h"
+#include "multiport.h"
+#include "mydebug.h"
+#include "outbuf.h"
+#include "uart_assist.h"
+#include "uartdev.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+extern int g_quiet;            /* 安静模式，不打印逐包输出 */
+
+/* epoll 事件来源：串口或定时器 */
+#define EV_KIND_UART 0
+#define EV_KIND_TIMER 1
+#define EV_DATA(idx, kind) (((uint64_t)(idx) << 1) | (kind))
+
+typedef struct {
+	uartdev_t *dev;
+	int timer_fd; /* send 模式为发送周期定时器，loopback 模式为超时定时器 */
+	unsigned int events; /* 当前注册到 epoll 的事件 */
+	metrics_port_t *metrics;
+
+	/* 发送状态 */
+	int tx_pending;     /* 当前报文是否还有未写完的数据 */
+	int tx_off;         /* 当前报文已写出的字节数 */
+	int sent_count;     /* 已发送的报文数 */
+	long long tx_bytes; /* 已发送的字节数 */
+	int tx_overruns;    /* 定时到期时上一报文仍未写完的次数 */
+
+	/* 接收状态 */
+	char rx_buf[MULTIPORT_RX_BUF_SIZE];
+	int rx_len;         /* loopback 模式下已收集的字节数 */
+	int rx_packets;     /* 接收次数 */
+	long long rx_bytes; /* 已接收的字节数 */
+
+	int done;   /* 端口是否已完成 */
+	int failed; /* 端口是否出错 */
+} port_state_t;
+
+typedef struct {
+	const uart_config_t *config;
+	port_state_t *ports;
+	int port_count;
+	int active; /* 尚未完成的端口数 */
+	int epfd;
+	const char *tx_data; /* 所有端口共用的发送数据 */
+	int tx_len;
+	outbuf_t *out; /* 接收数据的输出缓冲区 */
+} multi_ctx_t;
+
+static int port_update_events(multi_ctx_t *ctx, int idx)
+{
+	port_state_t *p = &ctx->ports[idx];
+	struct epoll_event ev;
+	unsigned int events = 0;
+
+	if (ctx->config->mode != MODE_SEND) {
+		events |= EPOLLIN;
+	}
+	if (p->tx_pending) {
+		events |= EPOLLOUT;
+	}
+	if (events == p->events) {
+		return 0;
+	}
+
+	ev.events = events;
+	ev.data.u64 = EV_DATA(idx, EV_KIND_UART);
+	if (epoll_ctl(ctx->epfd, EPOLL_CTL_MOD, p->dev->fd, &ev) < 0) {
+		pr_error("%s: epoll_ctl() failed: %s\n", p->dev->port, strerror(errno));
+		return -1;
+	}
+	p->events = events;
+
+	return 0;
+}
+
+/* 端口完成：从 epoll 中移除并关闭定时器 */
+static void port_finish(multi_ctx_t *ctx, int idx, int failed)
+{
+	port_state_t *p = &ctx->ports[idx];
+
+	if (p->done) {
+		return;
+	}
+
+	epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, p->dev->fd, NULL);
+	if (p->timer_fd >= 0) {
+		epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, p->timer_fd, NULL);
+		close(p->timer_fd);
+		p->timer_fd = -1;
+	}
+
+	p->done = 1;
+	p->failed = failed;
+	if (failed) {
+		metrics_error(p->metrics);
+	}
+	ctx->active--;
+}
+
+/* 尽可能多地写出当前报文，写不完时等待 EPOLLOUT */
+static int port_flush_tx(multi_ctx_t *ctx, int idx)
+{
+	port_state_t *p = &ctx->ports[idx];
+	const uart_config_t *config = ctx->config;
+	int n;
+
+	while (p->tx_off < ctx->tx_len) {
+		n = uartdev_send(p->dev, ctx->tx_data + p->tx_off, ctx->tx_len - p->tx_off);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				break;
+			}
+			pr_error("%s: failed to send data: %s\n", p->dev->port, strerror(errno));
+			port_finish(ctx, idx, 1);
+			return -1;
+		}
+		p->tx_off += n;
+		p->tx_bytes += n;
+	}
+
+	p->tx_pending = p->tx_off < ctx->tx_len;
+	if (!p->tx_pending) {
+		p->sent_count++;
+		metrics_tx(p->metrics, ctx->tx_len);
+	}
+	if (!p->tx_pending && config->mode == MODE_SEND) {
+		if (g_quiet) {
+			/* 不打印 */
+		} else if (config->format == OUTPUT_HEX) {
+			printf("Send [%s][%d] : hex=\"%s\" (%d bytes, total: %lld bytes)\n",
+			       p->dev->port, p->sent_count, config->send_string, ctx->tx_len,
+			       p->tx_bytes);
+		} else {
+			printf("Send [%s][%d] : \"%s\" (%d bytes, total: %lld bytes)\n",
+			       p->dev->port, p->sent_count, config->send_string, ctx->tx_len,
+			       p->tx_bytes);
+		}
+		if (config->send_count > 0 && p->sent_count >= config->send_count) {
+			port_finish(ctx, idx, 0);
+			return 0;
+		}
+	}
+
+	return port_update_events(ctx, idx);
+}
+
+static int port_start_tx(multi_ctx_t *ctx, int idx)
+{
+	port_state_t *p = &ctx->ports[idx];
+
+	if (p->tx_pending) {
+		/* 上一报文还没写完，跳过本周期 */
+		p->tx_overruns++;
+		return 0;
+	}
+
+	p->tx_off = 0;
+	p->tx_pending = 1;
+
+	return port_flush_tx(ctx, idx);
+}
+
+static void port_handle_rx(multi_ctx_t *ctx, int idx)
+{
+	port_state_t *p = &ctx->ports[idx];
+	const uart_config_t *config = ctx->config;
+	char *buf;
+	int len;
+	int n;
+
+	/* 非阻塞读，直到内核缓冲区读空 */
+	while (!p->done) {
+		if (config->mode == MODE_LOOPBACK) {
+			buf = p->rx_buf + p->rx_len;
+			len = sizeof(p->rx_buf) - p->rx_len;
+		} else {
+			buf = p->rx_buf;
+			len = sizeof(p->rx_buf);
+		}
+		if (len <= 0) {
+			pr_error("%s: loopback receive buffer full\n", p->dev->port);
+			port_finish(ctx, idx, 1);
+			return;
+		}
+
+		n = uartdev_recv(p->dev, buf, len);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				return;
+			}
+			pr_error("%s: failed to receive data: %s\n", p->dev->port,
+			         strerror(errno));
+			port_finish(ctx, idx, 1);
+			return;
+		} else if (n == 0) {
+			return;
+		}
+
+		p->rx_packets++;
+		p->rx_bytes += n;
+		metrics_rx(p->metrics, n);
+
+		if (config->mode == MODE_LOOPBACK) {
+			p->rx_len += n;
+			if (p->rx_len < ctx->tx_len) {
+				continue;
+			}
+			if (p->rx_len != ctx->tx_len ||
+			    memcmp(p->rx_buf, ctx->tx_data, ctx->tx_len) != 0) {
+				pr_error("%s: loopback data mismatch (sent %d bytes, received %d "
+				         "bytes)\n",
+				         p->dev->port, ctx->tx_len, p->rx_len);
+				port_finish(ctx, idx, 1);
+			} else {
+				pr_info("%s: loopback test PASSED (%d bytes)\n", p->dev->port,
+				        ctx->tx_len);
+				port_finish(ctx, idx, 0);
+			}
+			return;
+		}
+
+		if (g_quiet) {
+			continue;
+		}
+		if (config->format == OUTPUT_ASCII) {
+			outbuf_printf(ctx->out, "Recv [%s][%d] : \"", p->dev->port, p->rx_packets);
+			outbuf_ascii(ctx->out, buf, n);
+			outbuf_printf(ctx->out, "\" (%d bytes, total: %lld bytes)\n", n,
+			              p->rx_bytes);
+		} else {
+			outbuf_printf(ctx->out, "Recv [%s][%d] : (%d bytes, total: %lld bytes)\n",
+			              p->dev->port, p->rx_packets, n, p->rx_bytes);
+			outbuf_hex(ctx->out, buf, n);
+		}
+		outbuf_flush(ctx->out);
+	}
+}
+
+static void port_handle_timer(multi_ctx_t *ctx, int idx)
+{
+	port_state_t *p = &ctx->ports[idx];
+	uint64_t expirations;
+
+	if (read(p->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+		return;
+	}
+
+	if (ctx->config->mode == MODE_SEND) {
+		/* 错过的周期计为超限 */
+		if (expirations > 1) {
+			p->tx_overruns += (int)(expirations - 1);
+		}
+		port_start_tx(ctx, idx);
+	} else if (ctx->config->mode == MODE_LOOPBACK) {
+		metrics_timeout(p->metrics);
+		pr_error("%s: receive timeout after %d seconds (received %d of %d bytes)\n",
+		         p->dev->port, RECV_TIMEOUT_SEC, p->rx_len, ctx->tx_len);
+		port_finish(ctx, idx, 1);
+	}
+}
+
+/* 创建并注册端口的定时器，first_ms 为首次到期时间，interval_ms 为周期（0 表示单次） */
+static int port_arm_timer(multi_ctx_t *ctx, int idx, int first_ms, int interval_ms)
+{
+	port_state_t *p = &ctx->ports[idx];
+	struct itimerspec its;
+	struct epoll_event ev;
+
+	p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (p->timer_fd < 0) {
+		pr_error("timerfd_create() failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = first_ms / 1000;
+	its.it_value.tv_nsec = (first_ms % 1000) * 1000000L;
+	if (first_ms == 0) {
+		its.it_value.tv_nsec = 1;
+	}
+	its.it_interval.tv_sec = interval_ms / 1000;
+	its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+	if (timerfd_settime(p->timer_fd, 0, &its, NULL) < 0) {
+		pr_error("timerfd_settime() failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = EV_DATA(idx, EV_KIND_TIMER);
+	if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+		pr_error("epoll_ctl() failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* 打开所有端口并注册到 epoll */
+static int open_ports(multi_ctx_t *ctx)
+{
+	const uart_config_t *config = ctx->config;
+	struct epoll_event ev;
+	port_state_t *p;
+	int i;
+
+	for (i = 0; i < ctx->port_count; i++) {
+		p = &ctx->ports[i];
+
+		p->dev = uartdev_new(config->devices[i], config->baud, config->data_bit,
+		                     config->parity, config->stop_bit);
+		if (p->dev == NULL) {
+			pr_error("Failed to create uart device %s: %s\n", config->devices[i],
+			         strerror(errno));
+			return -1;
+		}
+
+		if (uartdev_setup(p->dev) < 0) {
+			pr_error("Failed to setup uart device %s: %s\n", config->devices[i],
+			         strerror(errno));
+			return -1;
+		}
+
+		if (uartdev_set_nonblock(p->dev, 1) < 0) {
+			pr_error("Failed to set non-blocking mode on %s: %s\n", config->devices[i],
+			         strerror(errno));
+			return -1;
+		}
+
+		uartdev_flush(p->dev);
+		p->metrics = metrics_port(config->devices[i]);
+
+		p->events = config->mode == MODE_SEND ? 0 : EPOLLIN;
+		ev.events = p->events;
+		ev.data.u64 = EV_DATA(i, EV_KIND_UART);
+		if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, p->dev->fd, &ev) < 0) {
+			pr_error("epoll_ctl() failed on %s: %s\n", config->devices[i],
+			         strerror(errno));
+			return -1;
+		}
+
+		pr_info("UART device opened: %s, %d, %d%c%d\n", config->devices[i], config->baud,
+		        config->data_bit, config->parity, config->stop_bit);
+		print_baud_info(p->dev);
+
+		if (lowlat_apply(p->dev, config->low_latency, config->latency_timer) < 0) {
+			return -1;
+		}
+	}
+
+	ctx->active = ctx->port_count;
+	return 0;
+}
+
+static void close_ports(multi_ctx_t *ctx)
+{
+	port_state_t *p;
+	int i;
+
+	for (i = 0; i < ctx->port_count; i++) {
+		p = &ctx->ports[i];
+		if (p->timer_fd >= 0) {
+			close(p->timer_fd);
+		}
+		if (p->dev) {
+			uartdev_del(p->dev);
+		}
+	}
+}
+
+static void print_summary(multi_ctx_t *ctx)
+{
+	port_state_t *p;
+	int failed = 0;
+	int i;
+
+	pr_info("Multi-port summary (%d ports):\n", ctx->port_count);
+	for (i = 0; i < ctx->port_count; i++) {
+		p = &ctx->ports[i];
+		if (p->failed) {
+			failed++;
+		}
+		printf("  %-20s tx: %d packets, %lld bytes, %d overruns; rx: %d packets, %lld "
+		       "bytes%s\n",
+		       p->dev->port, p->sent_count, p->tx_bytes, p->tx_overruns, p->rx_packets,
+		       p->rx_bytes, p->failed ? " [FAILED]" : "");
+	}
+
+	if (ctx->config->mode == MODE_LOOPBACK) {
+		pr_info("Loopback test: %d passed, %d failed\n", ctx->port_count - failed, failed);
+	}
+}
+
+int uart_multi_test(const uart_config_t *config)
+{
+	struct epoll_event events[MULTIPORT_MAX_EVENTS];
+	multi_ctx_t ctx;
+	char *send_buf = NULL;
+	int ret = -1;
+	int i, n, idx;
+
+	/* 模式已由 parse_args() 检查 */
+	if (config == NULL || config->device_count <= 0 ||
+	    (config->mode != MODE_LOOPBACK && config->mode != MODE_SEND &&
+	     config->mode != MODE_RECV)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.config = config;
+	ctx.port_count = config->device_count;
+	ctx.epfd = -1;
+
+	/* 准备发送数据，所有端口共用一份 */
+	if (config->mode != MODE_RECV) {
+		if (config->format == OUTPUT_HEX) {
+			send_buf = malloc(strlen(config->send_string) / 2 + 1);
+			if (send_buf == NULL) {
+				pr_error("Failed to allocate memory for send buffer\n");
+				return -1;
+			}
+			ctx.tx_len = parse_hex_string(config->send_string, send_buf,
+			                              strlen(config->send_string) / 2 + 1);
+			if (ctx.tx_len < 0) {
+				free(send_buf);
+				return -1;
+			}
+			ctx.tx_data = send_buf;
+		} else {
+			ctx.tx_len = strlen(config->send_string);
+			if (ctx.tx_len == 0) {
+				pr_error("Send string is empty\n");
+				return -1;
+			}
+			ctx.tx_data = config->send_string;
+		}
+		if (config->mode == MODE_LOOPBACK && ctx.tx_len > MULTIPORT_RX_BUF_SIZE) {
+			pr_error("Loopback data too long: %d bytes (max: %d)\n", ctx.tx_len,
+			         MULTIPORT_RX_BUF_SIZE);
+			free(send_buf);
+			return -1;
+		}
+	}
+
+	ctx.ports = calloc(ctx.port_count, sizeof(port_state_t));
+	ctx.out = malloc(sizeof(outbuf_t));
+	if (ctx.ports == NULL || ctx.out == NULL) {
+		pr_error("Failed to allocate memory for port state\n");
+		free(ctx.ports);
+		free(ctx.out);
+		free(send_buf);
+		return -1;
+	}
+	outbuf_init(ctx.out, stdout);
+	/* 打开中途失败时 close_ports() 会处理所有端口，先全部标记为未创建定时器 */
+	for (i = 0; i < ctx.port_count; i++) {
+		ctx.ports[i].timer_fd = -1;
+	}
+
+	ctx.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (ctx.epfd < 0) {
+		pr_error("epoll_create1() failed: %s\n", strerror(errno));
+		goto out;
+	}
+
+	if (open_ports(&ctx) < 0) {
+		goto out;
+	}
+
+	/* 启动每个端口的发送 */
+	for (i = 0; i < ctx.port_count; i++) {
+		if (config->mode == MODE_SEND) {
+			if (port_arm_timer(&ctx, i, 0, config->send_interval) < 0) {
+				goto out;
+			}
+		} else if (config->mode == MODE_LOOPBACK) {
+			if (port_arm_timer(&ctx, i, RECV_TIMEOUT_SEC * 1000, 0) < 0) {
+				goto out;
+			}
+			port_start_tx(&ctx, i);
+		}
+	}
+
+	pr_info("Multi-port %s test started on %d ports\n",
+	        config->mode == MODE_SEND ? "send" : config->mode == MODE_RECV ? "receive"
+	                                                                       : "loopback",
+	        ctx.port_count);
+
+	/* 事件循环 */
+	while (g_running && ctx.active > 0) {
+		n = epoll_wait(ctx.epfd, events, MULTIPORT_MAX_EVENTS, 1000);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_error("epoll_wait() failed: %s\n", strerror(errno));
+			goto out;
+		}
+
+		for (i = 0; i < n; i++) {
+			idx = (int)(events[i].data.u64 >> 1);
+			if (ctx.ports[idx].done) {
+				continue;
+			}
+
+			if ((events[i].data.u64 & 1) == EV_KIND_TIMER) {
+				port_handle_timer(&ctx, idx);
+				continue;
+			}
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				pr_error("%s: device error or hang up\n", ctx.ports[idx].dev->port);
+				port_finish(&ctx, idx, 1);
+				continue;
+			}
+			if (events[i].events & EPOLLIN) {
+				port_handle_rx(&ctx, idx);
+			}
+			if ((events[i].events & EPOLLOUT) && !ctx.ports[idx].done) {
+				port_flush_tx(&ctx, idx);
+			}
+		}
+		fflush(stdout);
+	}
+
+	print_summary(&ctx);
+
+	ret = 0;
+	for (i = 0; i < ctx.port_count; i++) {
+		if (ctx.ports[i].failed ||
+		    (config->mode == MODE_LOOPBACK && !ctx.ports[i].done)) {
+			ret = -1;
+		}
+	}
+
+out:
+	close_ports(&ctx);
+	if (ctx.epfd >= 0) {
+		close(ctx.epfd);
+	}
+	free(ctx.ports);
+	free(ctx.out);
+	free(send_buf);
+
+	return ret;
+}
@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "outbuf.h"
+#include "hex_codec.h"
+#include "timing.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define HEX_LINE_BYTES 16 /* 每行 16 字节 */
+#define HEX_LINE_MAX (HEX_LINE_BYTES * 3 + 1)
+
+/* 字节到两位大写 hex 的查找表，第 i 个字节对应 hex_digits[2*i] 和 hex_digits[2*i+1] */
+static const char hex_digits[513] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+/* 字节到 ASCII 显示形式的查找表：可打印字符原样，控制字符为转义序列 */
+typedef struct {
+	char s[4];
+	uint8_t len;
+} esc_entry_t;
+
+static esc_entry_t esc_table[256];
+static pthread_once_t esc_once = PTHREAD_ONCE_INIT;
+
+static void esc_table_init(void)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		esc_entry_t *e = &esc_table[i];
+
+		if (i >= 32 && i < 127) {
+			e->s[0] = (char)i;
+			e->len = 1;
+			continue;
+		}
+
+		e->s[0] = '\\';
+		e->len = 2;
+		switch (i) {
+		case '\n':
+			e->s[1] = 'n';
+			break;
+		case '\r':
+			e->s[1] = 'r';
+			break;
+		case '\t':
+			e->s[1] = 't';
+			break;
+		case '\0':
+			e->s[1] = '0';
+			break;
+		default:
+			e->s[1] = 'x';
+			e->s[2] = hex_digits[i * 2];
+			e->s[3] = hex_digits[i * 2 + 1];
+			e->len = 4;
+			break;
+		}
+	}
+}
+
+void outbuf_init(outbuf_t *o, FILE *fp)
+{
+	pthread_once(&esc_once, esc_table_init);
+
+	o->fp = fp;
+	o->len = 0;
+	o->ts_sec = (time_t)-1;
+	o->ts_len = 0;
+}
+
+int outbuf_flush(outbuf_t *o)
+{
+	size_t len = o->len;
+
+	o->len = 0;
+	if (len == 0) {
+		return 0;
+	}
+
+	if (fwrite(o->buf, 1, len, o->fp) != len) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* 保证缓冲区还有 n 字节空间 */
+static inline void outbuf_reserve(outbuf_t *o, size_t n)
+{
+	if (o->len + n > OUTBUF_SIZE) {
+		outbuf_flush(o);
+	}
+}
+
+void outbuf_write(outbuf_t *o, const char *s, size_t len)
+{
+	if (len > OUTBUF_SIZE) {
+		outbuf_flush(o);
+		fwrite(s, 1, len, o->fp);
+		return;
+	}
+
+	outbuf_reserve(o, len);
+	memcpy(o->buf + o->len, s, len);
+	o->len += len;
+}
+
+void outbuf_printf(outbuf_t *o, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(o->buf + o->len, OUTBUF_SIZE - o->len, fmt, ap);
+	va_end(ap);
+	if (n < 0) {
+		return;
+	}
+
+	if ((size_t)n >= OUTBUF_SIZE - o->len) {
+		/* 空间不足，先写出已有内容再重试 */
+		outbuf_flush(o);
+		va_start(ap, fmt);
+		if ((size_t)n >= OUTBUF_SIZE) {
+			vfprintf(o->fp, fmt, ap);
+			n = 0;
+		} else {
+			vsnprintf(o->buf, OUTBUF_SIZE, fmt, ap);
+		}
+		va_end(ap);
+	}
+
+	o->len += n;
+}
+
+void outbuf_timestamp(outbuf_t *o, int64_t realtime_ns)
+{
+	time_t sec = (time_t)(realtime_ns / NSEC_PER_SEC);
+	int ms = (int)(realtime_ns % NSEC_PER_SEC / NSEC_PER_MSEC);
+	struct tm tm_info;
+	char *p;
+
+	/* 只有秒变化时才重新格式化日期和时间 */
+	if (sec != o->ts_sec) {
+		localtime_r(&sec, &tm_info);
+		o->ts_str[0] = '[';
+		o->ts_len = 1 + strftime(o->ts_str + 1, sizeof(o->ts_str) - 2,
+		                         "%Y-%m-%d %H:%M:%S", &tm_info);
+		o->ts_str[o->ts_len++] = '.';
+		o->ts_sec = sec;
+	}
+
+	outbuf_reserve(o, o->ts_len + 5);
+	p = o->buf + o->len;
+	memcpy(p, o->ts_str, o->ts_len);
+	p += o->ts_len;
+	p[0] = (char)('0' + ms / 100);
+	p[1] = (char)('0' + ms / 10 % 10);
+	p[2] = (char)('0' + ms % 10);
+	p[3] = ']';
+	p[4] = ' ';
+	o->len += o->ts_len + 5;
+}
+
+void outbuf_ascii(outbuf_t *o, const char *buf, int len)
+{
+	const esc_entry_t *e;
+	char *p;
+	int n, i;
+
+	while (len > 0) {
+		/* 每个字节最多展开为 4 个字符 */
+		n = len < OUTBUF_SIZE / 4 ? len : OUTBUF_SIZE / 4;
+		outbuf_reserve(o, (size_t)n * 4);
+
+		p = o->buf + o->len;
+		for (i = 0; i < n; i++) {
+			e = &esc_table[(uint8_t)buf[i]];
+			memcpy(p, e->s, 4);
+			p += e->len;
+		}
+		o->len = p - o->buf;
+
+		buf += n;
+		len -= n;
+	}
+}
+
+void outbuf_hex(outbuf_t *o, const char *buf, int len)
+{
+	const hex_codec_t *codec = hex_codec_best();
+	int i, n;
+
+	for (i = 0; i < len; i += HEX_LINE_BYTES) {
+		n = len - i < HEX_LINE_BYTES ? len - i : HEX_LINE_BYTES;
+		outbuf_reserve(o, HEX_LINE_MAX);
+
+		codec->encode_spaced((const uint8_t *)buf + i, n, o->buf + o->len);
+		o->len += n * 3;
+		o->buf[o->len++] = '\n';
+	}
+}
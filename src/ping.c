@@ -0,0 +1,185 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "ping.h"
+#include "histogram.h"
+#include "mydebug.h"
+#include "timing.h"
+#include "uart_assist.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+/*
+ * 等待 len 字节回显，返回收到的字节数，超时或出错时可能小于 len。
+ * done_ns 为收到最后一个字节的时间。
+ */
+static int ping_wait_echo(uartdev_t *dev, char *buf, int len, int64_t deadline_ns,
+                          int64_t *done_ns)
+{
+	struct pollfd pfd;
+	int64_t now;
+	int got = 0, n, timeout;
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLIN;
+
+	while (got < len && g_running) {
+		now = timing_now_ns();
+		if (now >= deadline_ns) {
+			break;
+		}
+		/* 向上取整到毫秒，避免提前超时 */
+		timeout = (int)((deadline_ns - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+		n = poll(&pfd, 1, timeout);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0) {
+			continue;
+		}
+
+		n = read(dev->fd, buf + got, len - got);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			return -1;
+		}
+		got += n;
+		*done_ns = timing_now_ns();
+	}
+
+	return got;
+}
+
+int uart_ping_test(uartdev_t *dev, const char *send_str, output_format_t format, int interval_ms,
+                   int count, int timeout_ms)
+{
+	histogram_t *rtt;
+	char *req = NULL, *echo = NULL;
+	int req_len, got;
+	int64_t start_ns, t0, t1 = 0, deadline, next_report_ns, now;
+	long sent = 0, received = 0, lost = 0, mismatched = 0, missed = 0;
+	int ret = 0;
+
+	if (dev == NULL || send_str == NULL || timeout_ms <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	req_len = strlen(send_str);
+	req = malloc(req_len + 1);
+	echo = malloc(req_len + 1);
+	rtt = malloc(sizeof(histogram_t));
+	if (req == NULL || echo == NULL || rtt == NULL) {
+		pr_error("Failed to allocate memory for ping test\n");
+		ret = -1;
+		goto out;
+	}
+	hist_init(rtt);
+
+	if (format == OUTPUT_HEX) {
+		req_len = parse_hex_string(send_str, req, req_len);
+		if (req_len < 0) {
+			ret = -1;
+			goto out;
+		}
+	} else {
+		memcpy(req, send_str, req_len);
+	}
+	if (req_len == 0) {
+		pr_error("Send string is empty\n");
+		ret = -1;
+		goto out;
+	}
+
+	pr_info("Ping test: %d bytes, interval=%d ms, timeout=%d ms, count=%d%s\n", req_len,
+	        interval_ms, timeout_ms, count, count == 0 ? " (infinite)" : "");
+	pr_info("Line time for %d bytes: %.1f us one way\n", req_len,
+	        req_len * uartdev_char_time_ns(dev) / 1e3);
+
+	uartdev_flush(dev);
+	start_ns = timing_now_ns();
+	deadline = start_ns;
+	next_report_ns = start_ns + NSEC_PER_SEC;
+
+	while (g_running && (count == 0 || sent < count)) {
+		/* 丢弃上一次超时后才到达的回显 */
+		tcflush(dev->fd, TCIFLUSH);
+
+		t0 = timing_now_ns();
+		if (uartdev_send_all(dev, req, req_len, &g_running) < 0) {
+			/* 被 Ctrl+C 中断，不是发送失败 */
+			if (!g_running) {
+				break;
+			}
+			pr_error("Failed to send data: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+		sent++;
+
+		got = ping_wait_echo(dev, echo, req_len, t0 + timeout_ms * NSEC_PER_MSEC, &t1);
+		if (got < 0) {
+			pr_error("Failed to receive data: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+		if (!g_running) {
+			sent--;
+			break;
+		}
+
+		if (got < req_len) {
+			lost++;
+		} else if (memcmp(req, echo, req_len) != 0) {
+			mismatched++;
+		} else {
+			received++;
+			hist_add(rtt, t1 - t0);
+		}
+
+		now = timing_now_ns();
+		if (now >= next_report_ns) {
+			printf("Ping [%llds] : sent %ld, received %ld, lost %ld, mismatched %ld, "
+			       "p50 %.1f us, max %.1f us\n",
+			       (long long)((now - start_ns) / NSEC_PER_SEC), sent, received, lost,
+			       mismatched, hist_percentile(rtt, 50) / 1e3, rtt->max / 1e3);
+			next_report_ns += NSEC_PER_SEC * ((now - next_report_ns) / NSEC_PER_SEC + 1);
+		}
+
+		deadline = timing_next_deadline(deadline, interval_ms * NSEC_PER_MSEC, now, &missed);
+		while (timing_sleep_until(deadline) < 0 && g_running) {
+		}
+	}
+
+	pr_info("Ping completed: sent %ld, received %ld, lost %ld (%.2f%%), mismatched %ld\n",
+	        sent, received, lost, sent ? lost * 100.0 / sent : 0.0, mismatched);
+	hist_report_us(rtt, "Round-trip latency");
+	hist_print_table_us(rtt);
+	if (lost > 0 || mismatched > 0) {
+		ret = -1;
+	}
+
+out:
+	free(rtt);
+	free(echo);
+	free(req);
+
+	return ret;
+}
@@ -0,0 +1,413 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "prbs.h"
+#include "icount.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PRBS_TX_CHUNK 4096     /* 发送线程单次写入的字节数 */
+#define PRBS_RX_BUF_SIZE 65536 /* 接收缓冲区大小 */
+#define PRBS_DRAIN_IDLE_MS 500 /* 发送结束后，接收端空闲多久视为收完 */
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+int prbs_gen_init(prbs_gen_t *g, int order)
+{
+	switch (order) {
+	case 7:
+		g->tap = 6;
+		break;
+	case 15:
+		g->tap = 14;
+		break;
+	case 23:
+		g->tap = 18;
+		break;
+	case 31:
+		g->tap = 28;
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	g->order = order;
+	g->state = ~0ULL;
+
+	return 0;
+}
+
+/*
+ * 一次生成 nbits 位（<= 32），第 t 位为序列中的第 t 个位。
+ * s[n] = s[n-order] ^ s[n-tap]，每步最多可并行生成 tap 位。
+ */
+static inline uint64_t prbs_gen_bits(prbs_gen_t *g, int nbits)
+{
+	uint64_t out = 0;
+	uint64_t n;
+	int done = 0;
+	int w;
+
+	while (done < nbits) {
+		w = nbits - done;
+		if (w > g->tap) {
+			w = g->tap;
+		}
+		n = ((g->state >> (64 - g->order)) ^ (g->state >> (64 - g->tap))) &
+		    ((1ULL << w) - 1);
+		g->state = (g->state >> w) | (n << (64 - w));
+		out |= n << done;
+		done += w;
+	}
+
+	return out;
+}
+
+void prbs_gen_fill(prbs_gen_t *g, uint8_t *buf, size_t len)
+{
+	uint64_t v;
+
+	while (len >= 4) {
+		v = prbs_gen_bits(g, 32);
+		buf[0] = (uint8_t)v;
+		buf[1] = (uint8_t)(v >> 8);
+		buf[2] = (uint8_t)(v >> 16);
+		buf[3] = (uint8_t)(v >> 24);
+		buf += 4;
+		len -= 4;
+	}
+
+	while (len > 0) {
+		*buf++ = (uint8_t)prbs_gen_bits(g, 8);
+		len--;
+	}
+}
+
+int prbs_check_init(prbs_check_t *c, int order)
+{
+	memset(c, 0, sizeof(*c));
+
+	return prbs_gen_init(&c->ref, order);
+}
+
+/* 统计 diff 中非零字节的个数 */
+static inline int count_nonzero_bytes(uint64_t diff)
+{
+	diff |= diff >> 4;
+	diff |= diff >> 2;
+	diff |= diff >> 1;
+
+	return __builtin_popcountll(diff & 0x0101010101010101ULL);
+}
+
+static inline void prbs_count_add(prbs_count_t *dst, const prbs_count_t *src)
+{
+	dst->bits += src->bits;
+	dst->bit_errors += src->bit_errors;
+	dst->bytes += src->bytes;
+	dst->byte_errors += src->byte_errors;
+}
+
+/*
+ * 校验一个 nb 位（8 或 32）的字。
+ * 未同步时用接收到的历史位预测当前位（自同步），预测全部正确 PRBS_SYNC_BITS
+ * 位后，以接收历史作为参考序列的初始状态进入同步状态；同步后与参考序列逐位
+ * 比较，窗口内误码过多则判定失步，丢弃当前和待定窗口的统计，回到搜索状态。
+ */
+static void prbs_check_word(prbs_check_t *c, uint64_t v, int nb)
+{
+	const uint64_t mask = (1ULL << nb) - 1;
+	const int k = c->ref.order;
+	const int m = c->ref.tap;
+	uint64_t e;
+
+	c->hist = (c->hist >> nb) | (v << (64 - nb));
+
+	if (!c->locked) {
+		c->hunt_bytes += nb / 8;
+		e = ((c->hist >> (64 - nb)) ^ (c->hist >> (64 - nb - k)) ^
+		     (c->hist >> (64 - nb - m))) &
+		    mask;
+		if (e) {
+			/* 最后一个误码之后的位数 */
+			c->sync_bits = nb - 1 - (63 - __builtin_clzll(e));
+			return;
+		}
+		c->sync_bits += nb;
+		/* 全零序列满足递推关系但不是有效的 PRBS */
+		if (c->sync_bits >= PRBS_SYNC_BITS && (c->hist >> (64 - k)) != 0) {
+			c->ref.state = c->hist;
+			c->locked = 1;
+			c->locks++;
+			memset(&c->window, 0, sizeof(c->window));
+			memset(&c->pending, 0, sizeof(c->pending));
+		}
+		return;
+	}
+
+	e = (v ^ prbs_gen_bits(&c->ref, nb)) & mask;
+	c->window.bits += nb;
+	c->window.bit_errors += __builtin_popcountll(e);
+	c->window.bytes += nb / 8;
+	c->window.byte_errors += count_nonzero_bytes(e);
+
+	if (c->window.bit_errors > PRBS_LOSS_ERRORS) {
+		/* 失步（丢字节或插入字节），重新搜索 */
+		c->locked = 0;
+		c->slips++;
+		c->sync_bits = 0;
+		c->hunt_bytes += c->window.bytes + c->pending.bytes;
+	} else if (c->window.bits >= PRBS_WINDOW_BITS) {
+		prbs_count_add(&c->total, &c->pending);
+		c->pending = c->window;
+		memset(&c->window, 0, sizeof(c->window));
+	}
+}
+
+void prbs_check_feed(prbs_check_t *c, const uint8_t *buf, size_t len)
+{
+	uint64_t v;
+
+	/* 每次处理 32 位 */
+	while (len >= 4) {
+		v = (uint64_t)buf[0] | ((uint64_t)buf[1] << 8) | ((uint64_t)buf[2] << 16) |
+		    ((uint64_t)buf[3] << 24);
+		prbs_check_word(c, v, 32);
+		buf += 4;
+		len -= 4;
+	}
+
+	while (len > 0) {
+		prbs_check_word(c, *buf++, 8);
+		len--;
+	}
+}
+
+void prbs_check_result(const prbs_check_t *c, prbs_count_t *result)
+{
+	*result = c->total;
+	if (c->locked) {
+		prbs_count_add(result, &c->pending);
+		prbs_count_add(result, &c->window);
+	}
+}
+
+typedef struct {
+	uartdev_t *dev;
+	int order;
+	int chunk;           /* 单次写入字节数 */
+	int64_t deadline_ns; /* 发送截止时间 */
+	long long tx_bytes;  /* 已写入的字节数 */
+	int64_t end_ns;      /* 发送完成时间 */
+	int done;            /* 发送线程是否结束 */
+	int error;           /* 发送线程的 errno */
+} prbs_tx_t;
+
+static void *prbs_tx_thread(void *arg)
+{
+	prbs_tx_t *tx = (prbs_tx_t *)arg;
+	uint8_t buf[PRBS_TX_CHUNK];
+	prbs_gen_t gen;
+	int off = tx->chunk;
+	int n;
+
+	prbs_gen_init(&gen, tx->order);
+
+	while (g_running && timing_now_ns() < __atomic_load_n(&tx->deadline_ns, __ATOMIC_RELAXED)) {
+		if (off == tx->chunk) {
+			prbs_gen_fill(&gen, buf, tx->chunk);
+			off = 0;
+		}
+		n = uartdev_send(tx->dev, (const char *)buf + off, tx->chunk - off);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			tx->error = errno;
+			break;
+		}
+		__atomic_add_fetch(&tx->tx_bytes, n, __ATOMIC_RELAXED);
+		off += n;
+	}
+
+	tcdrain(tx->dev->fd);
+	tx->end_ns = timing_now_ns();
+	__atomic_store_n(&tx->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void prbs_print_stats(const prbs_check_t *c, long long rx_bytes)
+{
+	prbs_count_t r;
+
+	prbs_check_result(c, &r);
+	printf("rx %lld bytes, %s, BER %.3e (%llu/%llu bits), byte errors %.3e (%llu/%llu), "
+	       "slips %llu, resyncs %llu, unsynced %llu bytes\n",
+	       rx_bytes, c->locked ? "locked" : "hunting",
+	       r.bits ? (double)r.bit_errors / r.bits : 0.0, (unsigned long long)r.bit_errors,
+	       (unsigned long long)r.bits, r.bytes ? (double)r.byte_errors / r.bytes : 0.0,
+	       (unsigned long long)r.byte_errors, (unsigned long long)r.bytes,
+	       (unsigned long long)c->slips,
+	       (unsigned long long)(c->locks > 0 ? c->locks - 1 : 0),
+	       (unsigned long long)c->hunt_bytes);
+}
+
+int uart_prbs_test(uartdev_t *dev, int order, int duration_sec)
+{
+	prbs_tx_t tx;
+	prbs_check_t check;
+	prbs_count_t result;
+	icount_t ic;
+	pthread_t tid;
+	struct pollfd pfd;
+	uint8_t *rx_buf;
+	long long rx_bytes = 0;
+	int64_t last_rx_ns = 0, now, next_report;
+	int elapsed = 0;
+	int rx_error = 0;
+	int ret, n;
+
+	if (dev == NULL || duration_sec < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (dev->data_bit != 8) {
+		pr_error("PRBS test requires 8 data bits\n");
+		return -1;
+	}
+
+	if (prbs_check_init(&check, order) < 0) {
+		pr_error("Invalid PRBS order: %d (should be 7/15/23/31)\n", order);
+		return -1;
+	}
+
+	rx_buf = malloc(PRBS_RX_BUF_SIZE);
+	if (rx_buf == NULL) {
+		pr_error("Failed to allocate memory for receive buffer\n");
+		return -1;
+	}
+
+	memset(&tx, 0, sizeof(tx));
+	tx.dev = dev;
+	tx.order = order;
+	/* 每次写入约 50ms 的数据量 */
+	tx.chunk = dev->baud / uartdev_frame_bits(dev) / 20;
+	if (tx.chunk < 64) {
+		tx.chunk = 64;
+	} else if (tx.chunk > PRBS_TX_CHUNK) {
+		tx.chunk = PRBS_TX_CHUNK;
+	}
+	tx.deadline_ns = duration_sec > 0
+	                     ? timing_now_ns() + (int64_t)duration_sec * NSEC_PER_SEC
+	                     : INT64_MAX;
+
+	if (duration_sec > 0) {
+		pr_info("PRBS test: PRBS%d, duration %d seconds\n", order, duration_sec);
+	} else {
+		pr_info("PRBS test: PRBS%d, duration infinite\n", order);
+	}
+
+	/* 清空缓冲区 */
+	uartdev_flush(dev);
+	icount_start(&ic, dev);
+
+	ret = pthread_create(&tid, NULL, prbs_tx_thread, &tx);
+	if (ret != 0) {
+		pr_error("Failed to create TX thread: %s\n", strerror(ret));
+		free(rx_buf);
+		return -1;
+	}
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLIN;
+	next_report = timing_now_ns() + NSEC_PER_SEC;
+
+	while (g_running) {
+		now = timing_now_ns();
+
+		if (__atomic_load_n(&tx.done, __ATOMIC_ACQUIRE) &&
+		    now - (last_rx_ns > tx.end_ns ? last_rx_ns : tx.end_ns) >
+		        PRBS_DRAIN_IDLE_MS * NSEC_PER_MSEC) {
+			break;
+		}
+
+		if (now >= next_report) {
+			elapsed++;
+			printf("PRBS [%ds] : ", elapsed);
+			prbs_print_stats(&check, rx_bytes);
+			icount_poll(&ic, 0);
+			next_report += NSEC_PER_SEC;
+		}
+
+		ret = poll(&pfd, 1, 100);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			rx_error = errno;
+			pr_error("poll() failed: %s\n", strerror(errno));
+			break;
+		} else if (ret == 0) {
+			continue;
+		}
+
+		n = 0;
+		if (pfd.revents & POLLIN) {
+			n = uartdev_recv(dev, (char *)rx_buf, PRBS_RX_BUF_SIZE);
+		}
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			rx_error = errno;
+			pr_error("uartdev_recv() failed: %s\n", strerror(errno));
+			break;
+		} else if (n == 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+			/* 挂断或出错后 poll 会一直立即返回，继续轮询只会空转 */
+			rx_error = EIO;
+			pr_error("Serial port closed or failed\n");
+			break;
+		} else if (n == 0) {
+			continue;
+		}
+
+		last_rx_ns = timing_now_ns();
+		rx_bytes += n;
+		prbs_check_feed(&check, rx_buf, n);
+	}
+
+	/* 接收出错退出循环时发送线程可能还在运行（-t 0 时没有截止时间），让它尽快退出 */
+	__atomic_store_n(&tx.deadline_ns, 0, __ATOMIC_RELAXED);
+	pthread_join(tid, NULL);
+	free(rx_buf);
+
+	if (tx.error) {
+		pr_error("Failed to send data: %s\n", strerror(tx.error));
+	}
+
+	pr_info("PRBS%d result: tx %lld bytes, ", order, tx.tx_bytes);
+	prbs_print_stats(&check, rx_bytes);
+	icount_report(&ic, rx_bytes, tx.tx_bytes);
+
+	prbs_check_result(&check, &result);
+	if (tx.error || rx_error || check.locks == 0 || result.bit_errors > 0 || check.slips > 0) {
+		return -1;
+	}
+
+	return 0;
+}
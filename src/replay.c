@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "replay.h"
+#include "capture.h"
+#include "histogram.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+int uart_replay_test(uartdev_t *dev, const char *capture_file, double speed)
+{
+	capture_reader_t reader;
+	capture_record_t rec;
+	histogram_t *late;
+	int64_t first_ts = -1, start_ns = 0, deadline, now, elapsed;
+	int64_t next_report_ns = 0;
+	long long records = 0, bytes = 0, skipped = 0;
+	int ret = 0, next;
+
+	if (dev == NULL || capture_file == NULL || speed < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (capture_reader_open(&reader, capture_file) < 0) {
+		pr_error("Failed to open capture file %s: %s\n", capture_file,
+		         errno == EINVAL ? "not a capture file" : strerror(errno));
+		return -1;
+	}
+
+	late = malloc(sizeof(histogram_t));
+	if (late == NULL) {
+		pr_error("Failed to allocate memory for statistics\n");
+		capture_reader_close(&reader);
+		return -1;
+	}
+	hist_init(late);
+
+	pr_info("Replay: %s (captured on %s, %d %d%c%d, %zu bytes)\n", capture_file, reader.port,
+	        reader.baud, reader.data_bit, reader.parity, reader.stop_bit, reader.size);
+	if (speed > 0) {
+		pr_info("Replay speed: %.3fx\n", speed);
+	} else {
+		pr_info("Replay speed: max\n");
+	}
+	if (reader.baud != dev->baud || reader.data_bit != dev->data_bit ||
+	    reader.stop_bit != dev->stop_bit) {
+		pr_info("Warning: port settings differ from the capture, timing may not match\n");
+	}
+
+	while (g_running) {
+		next = capture_reader_next(&reader, &rec);
+		if (next <= 0) {
+			if (next < 0) {
+				pr_error("Capture file is truncated after %lld records\n",
+				         records + skipped);
+				ret = -1;
+			}
+			break;
+		}
+
+		/* 只回放接收方向的数据，即被测设备当时发出的数据 */
+		if (rec.dir != CAPTURE_DIR_RX) {
+			skipped++;
+			continue;
+		}
+
+		if (first_ts < 0) {
+			first_ts = rec.ts_ns;
+			start_ns = timing_now_ns();
+			next_report_ns = start_ns + NSEC_PER_SEC;
+		}
+
+		/* 按绝对时间调度，发送耗时不累积 */
+		if (speed > 0) {
+			deadline = start_ns + (int64_t)((rec.ts_ns - first_ts) / speed);
+			while (timing_sleep_until(deadline) < 0 && g_running) {
+			}
+			if (!g_running) {
+				break;
+			}
+			hist_add(late, timing_now_ns() - deadline);
+		}
+
+		if (uartdev_send_all(dev, (const char *)rec.data, rec.len, &g_running) < 0) {
+			/* 被 Ctrl+C 中断，不是发送失败 */
+			if (!g_running) {
+				break;
+			}
+			pr_error("Failed to send data: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+		records++;
+		bytes += rec.len;
+
+		now = timing_now_ns();
+		if (now >= next_report_ns) {
+			printf("Replay [%llds] : %lld records, %lld bytes\n",
+			       (long long)((now - start_ns) / NSEC_PER_SEC), records, bytes);
+			next_report_ns += NSEC_PER_SEC * ((now - next_report_ns) / NSEC_PER_SEC + 1);
+		}
+	}
+
+	/* 等待发送缓冲区中的数据全部发出 */
+	tcdrain(dev->fd);
+	elapsed = records > 0 ? timing_now_ns() - start_ns : 0;
+
+	pr_info("Replay completed: %lld records, %lld bytes in %.3f s (%.0f bytes/s)\n", records,
+	        bytes, elapsed / 1e9, elapsed > 0 ? bytes * 1e9 / elapsed : 0.0);
+	if (skipped > 0) {
+		pr_info("Skipped %lld records of the transmit direction\n", skipped);
+	}
+	if (speed > 0) {
+		hist_report_us(late, "Replay lateness");
+	}
+
+	free(late);
+	capture_reader_close(&reader);
+
+	return ret;
+}
@@ -0,0 +1,142 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "send_file.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+/* 打印进度：已发送/总数、百分比、平均速率和预计剩余时间 */
+static void print_progress(size_t sent, size_t total, int64_t elapsed_ns, char end)
+{
+	double rate = elapsed_ns > 0 ? sent * 1e9 / elapsed_ns : 0.0;
+	double eta = rate > 0 ? (total - sent) / rate : 0.0;
+
+	printf("Send file : %zu/%zu bytes (%.1f%%), %.0f bytes/s, ETA %d:%02d%c", sent, total,
+	       total ? sent * 100.0 / total : 100.0, rate, (int)eta / 60, (int)eta % 60, end);
+	fflush(stdout);
+}
+
+int uart_send_file_test(uartdev_t *dev, const char *path)
+{
+	struct pollfd pfd;
+	struct stat st;
+	const uint8_t *map = NULL;
+	size_t size, sent = 0, released = 0, chunk;
+	int64_t start_ns, now, next_report_ns;
+	long page = sysconf(_SC_PAGESIZE);
+	char end = isatty(STDOUT_FILENO) ? '\r' : '\n';
+	ssize_t n;
+	int fd, ret = 0;
+
+	if (dev == NULL || path == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		pr_error("Failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		pr_error("%s is not a regular file\n", path);
+		close(fd);
+		return -1;
+	}
+
+	size = st.st_size;
+	if (size > 0) {
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			pr_error("Failed to map %s: %s\n", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		madvise((void *)map, size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	if (uartdev_set_nonblock(dev, 1) < 0) {
+		pr_error("Failed to set non-blocking mode: %s\n", strerror(errno));
+		if (map != NULL) {
+			munmap((void *)map, size);
+		}
+		return -1;
+	}
+
+	pr_info("Send file: %s (%zu bytes), theoretical %.1f s at %d baud\n", path, size,
+	        size * (double)uartdev_frame_bits(dev) / dev->baud, dev->baud);
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLOUT;
+	start_ns = timing_now_ns();
+	next_report_ns = start_ns + SEND_FILE_REPORT_MS * NSEC_PER_MSEC;
+
+	while (sent < size && g_running) {
+		chunk = size - sent < SEND_FILE_CHUNK ? size - sent : SEND_FILE_CHUNK;
+		n = write(dev->fd, map + sent, chunk);
+		if (n > 0) {
+			sent += n;
+		} else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			/* 发送缓冲区满，等待可写，超时用于刷新进度和检查退出标志 */
+			if (poll(&pfd, 1, SEND_FILE_REPORT_MS) < 0 && errno != EINTR) {
+				pr_error("poll() failed: %s\n", strerror(errno));
+				ret = -1;
+				break;
+			}
+		} else if (n < 0 && errno != EINTR) {
+			pr_error("Failed to send data: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+
+		/* 释放已发送部分的页，保持内存占用不随文件大小增长 */
+		if (sent - released >= SEND_FILE_RELEASE) {
+			size_t upto = sent & ~(size_t)(page - 1);
+
+			madvise((void *)(map + released), upto - released, MADV_DONTNEED);
+			released = upto;
+		}
+
+		now = timing_now_ns();
+		if (now >= next_report_ns) {
+			print_progress(sent, size, now - start_ns, end);
+			next_report_ns = now + SEND_FILE_REPORT_MS * NSEC_PER_MSEC;
+		}
+	}
+
+	/* 等待串口把缓冲区中的数据全部发出，计时包括这部分时间 */
+	uartdev_set_nonblock(dev, 0);
+	if (g_running) {
+		tcdrain(dev->fd);
+	}
+	now = timing_now_ns();
+	print_progress(sent, size, now - start_ns, '\n');
+
+	pr_info("Send file %s: %zu/%zu bytes in %.3f s, %.0f bytes/s\n",
+	        sent == size ? "completed" : "stopped", sent, size, (now - start_ns) / 1e9,
+	        now > start_ns ? sent * 1e9 / (now - start_ns) : 0.0);
+
+	if (map != NULL) {
+		munmap((void *)map, size);
+	}
+
+	return ret;
+}
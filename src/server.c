@@ -0,0 +1,658 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "server.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+/* epoll 事件来源 */
+#define EV_KIND_LISTEN 0
+#define EV_KIND_UART 1
+#define EV_KIND_CLIENT 2
+#define EV_DATA(idx, kind) (((uint64_t)(idx) << 2) | (kind))
+
+typedef struct {
+	int fd;                 /* -1 表示已断开，等本轮事件处理完再释放 */
+	int id;                 /* 连接序号，从 1 开始 */
+	char addr[64];          /* 客户端地址 "ip:port" */
+	unsigned int events;    /* 当前注册到 epoll 的事件 */
+	char *queue;            /* 发往客户端的环形队列 */
+	size_t head;
+	size_t len;
+	size_t max_len;         /* 队列深度的最大值 */
+	uint64_t out_bytes;     /* 已发给客户端的字节数 */
+	uint64_t in_bytes;      /* 从客户端收到的字节数 */
+	uint64_t dropped;       /* 队列放不下而丢弃的字节数 */
+	uint64_t last_out;      /* 上次打印统计时的 out_bytes */
+	uint64_t last_in;
+	int64_t connect_ns;
+} client_t;
+
+typedef struct {
+	uartdev_t *dev;
+	int epfd;
+	int listen_fd;
+	unsigned int uart_events;
+	client_t **clients;     /* 按槽位存放，NULL 为空槽 */
+	int slots;
+	int count;              /* 已连接的客户端数 */
+	int next_id;
+	int closing;            /* 本轮有客户端断开，需要释放 */
+	char tx[SERVER_TX_SIZE]; /* 待写入串口的数据 */
+	size_t tx_off;
+	size_t tx_len;
+	uint64_t uart_rx;       /* 串口收到的字节数 */
+	uint64_t uart_tx;       /* 已写入串口的字节数 */
+	uint64_t last_rx;
+	uint64_t last_tx;
+	long accepted;          /* 累计连接数 */
+} server_t;
+
+/* 解析 "[addr:]port" 并开始监听 */
+static int server_listen(server_t *s, const char *spec)
+{
+	struct addrinfo hints, *res, *ai;
+	char host[256];
+	const char *port = spec;
+	const char *colon = strrchr(spec, ':');
+	size_t len;
+	int one = 1;
+	int ret;
+
+	host[0] = '\0';
+	if (colon != NULL) {
+		len = colon - spec;
+		/* [::1]:port 形式的 IPv6 地址去掉方括号 */
+		if (len >= 2 && spec[0] == '[' && spec[len - 1] == ']') {
+			spec++;
+			len -= 2;
+		}
+		if (len >= sizeof(host)) {
+			pr_error("Invalid listen address: %s\n", spec);
+			return -1;
+		}
+		memcpy(host, spec, len);
+		host[len] = '\0';
+		port = colon + 1;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	ret = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+	if (ret != 0) {
+		pr_error("Invalid listen address %s: %s\n", spec, gai_strerror(ret));
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (ai = res; ai != NULL; ai = ai->ai_next) {
+		s->listen_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		                      ai->ai_protocol);
+		if (s->listen_fd < 0) {
+			continue;
+		}
+		setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(s->listen_fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+		    listen(s->listen_fd, SERVER_BACKLOG) == 0) {
+			break;
+		}
+		close(s->listen_fd);
+		s->listen_fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (s->listen_fd < 0) {
+		pr_error("Failed to listen on %s: %s\n", spec, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static void format_addr(const struct sockaddr_storage *sa, char *buf, size_t size)
+{
+	char ip[INET6_ADDRSTRLEN];
+
+	if (sa->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)sa;
+
+		inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+		snprintf(buf, size, "[%s]:%d", ip, ntohs(in6->sin6_port));
+	} else {
+		const struct sockaddr_in *in = (const struct sockaddr_in *)sa;
+
+		inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+		snprintf(buf, size, "%s:%d", ip, ntohs(in->sin_port));
+	}
+}
+
+static int server_set_events(server_t *s, int fd, unsigned int *cur, unsigned int events,
+                             uint64_t data)
+{
+	struct epoll_event ev;
+
+	if (events == *cur) {
+		return 0;
+	}
+	ev.events = events;
+	ev.data.u64 = data;
+	if (epoll_ctl(s->epfd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+		pr_error("epoll_ctl() failed: %s\n", strerror(errno));
+		return -1;
+	}
+	*cur = events;
+	return 0;
+}
+
+/* 串口缓冲区还能放下一整块时读客户端，队列非空时等客户端可写 */
+static int client_update_events(server_t *s, int idx)
+{
+	client_t *c = s->clients[idx];
+	unsigned int events = 0;
+
+	if (SERVER_TX_SIZE - s->tx_len >= SERVER_CHUNK) {
+		events |= EPOLLIN;
+	}
+	if (c->len > 0) {
+		events |= EPOLLOUT;
+	}
+	return server_set_events(s, c->fd, &c->events, events, EV_DATA(idx, EV_KIND_CLIENT));
+}
+
+static void client_print(const client_t *c, int64_t now)
+{
+	printf("  [%d] %s: sent %llu bytes, received %llu bytes, dropped %llu bytes, "
+	       "max queue %zu bytes, connected %.1f s\n",
+	       c->id, c->addr, (unsigned long long)c->out_bytes, (unsigned long long)c->in_bytes,
+	       (unsigned long long)c->dropped, c->max_len, (now - c->connect_ns) / 1e9);
+}
+
+/* 断开客户端，fd 关闭后槽位保留到本轮事件处理完 */
+static void client_close(server_t *s, client_t *c, const char *reason)
+{
+	pr_info("Client [%d] %s disconnected (%s)\n", c->id, c->addr, reason);
+	client_print(c, timing_now_ns());
+	close(c->fd);
+	c->fd = -1;
+	s->count--;
+	s->closing = 1;
+}
+
+static void server_sweep(server_t *s)
+{
+	int i;
+
+	for (i = 0; i < s->slots; i++) {
+		if (s->clients[i] != NULL && s->clients[i]->fd < 0) {
+			free(s->clients[i]->queue);
+			free(s->clients[i]);
+			s->clients[i] = NULL;
+		}
+	}
+	s->closing = 0;
+}
+
+static int server_accept(server_t *s)
+{
+	struct sockaddr_storage sa;
+	socklen_t sa_len = sizeof(sa);
+	struct epoll_event ev;
+	client_t **slots;
+	client_t *c;
+	int fd, idx, n;
+	int one = 1;
+
+	fd = accept(s->listen_fd, (struct sockaddr *)&sa, &sa_len);
+	if (fd < 0) {
+		if (errno == EAGAIN || errno == EINTR || errno == ECONNABORTED) {
+			return 0;
+		}
+		pr_error("accept() failed: %s\n", strerror(errno));
+		/* 文件描述符用完等情况不退出，下次再试 */
+		return 0;
+	}
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+		pr_error("Failed to set client socket non-blocking: %s\n", strerror(errno));
+		close(fd);
+		return 0;
+	}
+	/* 串口数据到达后立即发出，不等待凑满一个 TCP 段 */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	for (idx = 0; idx < s->slots && s->clients[idx] != NULL; idx++) {
+	}
+	if (idx == s->slots) {
+		n = s->slots ? s->slots * 2 : 8;
+		slots = realloc(s->clients, n * sizeof(client_t *));
+		if (slots == NULL) {
+			pr_error("Failed to allocate memory for clients\n");
+			close(fd);
+			return 0;
+		}
+		memset(slots + s->slots, 0, (n - s->slots) * sizeof(client_t *));
+		s->clients = slots;
+		s->slots = n;
+	}
+
+	c = calloc(1, sizeof(client_t));
+	if (c == NULL || (c->queue = malloc(SERVER_QUEUE_SIZE)) == NULL) {
+		pr_error("Failed to allocate memory for client queue\n");
+		free(c);
+		close(fd);
+		return 0;
+	}
+	c->fd = fd;
+	c->id = ++s->next_id;
+	c->connect_ns = timing_now_ns();
+	format_addr(&sa, c->addr, sizeof(c->addr));
+
+	c->events = SERVER_TX_SIZE - s->tx_len >= SERVER_CHUNK ? EPOLLIN : 0;
+	ev.events = c->events;
+	ev.data.u64 = EV_DATA(idx, EV_KIND_CLIENT);
+	if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		pr_error("epoll_ctl() failed: %s\n", strerror(errno));
+		free(c->queue);
+		free(c);
+		close(fd);
+		return 0;
+	}
+
+	s->clients[idx] = c;
+	s->count++;
+	s->accepted++;
+	pr_info("Client [%d] %s connected, %d clients\n", c->id, c->addr, s->count);
+	return 0;
+}
+
+/* 把队列中的数据发给客户端，发不出时等待 EPOLLOUT */
+static int client_flush(server_t *s, client_t *c)
+{
+	size_t seg;
+	ssize_t n;
+
+	while (c->len > 0) {
+		seg = SERVER_QUEUE_SIZE - c->head;
+		if (seg > c->len) {
+			seg = c->len;
+		}
+		n = send(c->fd, c->queue + c->head, seg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				break;
+			}
+			client_close(s, c, strerror(errno));
+			return -1;
+		}
+		c->out_bytes += n;
+		c->head = (c->head + n) % SERVER_QUEUE_SIZE;
+		c->len -= n;
+	}
+	if (c->len == 0) {
+		c->head = 0;
+	}
+	return 0;
+}
+
+/* 把串口数据放入客户端队列，放不下时整块丢弃，保证客户端收到的每块数据都完整 */
+static void client_enqueue(client_t *c, const char *data, size_t len)
+{
+	size_t tail, seg;
+
+	if (SERVER_QUEUE_SIZE - c->len < len) {
+		c->dropped += len;
+		return;
+	}
+
+	tail = (c->head + c->len) % SERVER_QUEUE_SIZE;
+	seg = SERVER_QUEUE_SIZE - tail;
+	if (seg > len) {
+		seg = len;
+	}
+	memcpy(c->queue + tail, data, seg);
+	memcpy(c->queue, data + seg, len - seg);
+	c->len += len;
+	if (c->len > c->max_len) {
+		c->max_len = c->len;
+	}
+}
+
+/* 读串口并分发给所有客户端 */
+static int server_uart_read(server_t *s)
+{
+	char buf[SERVER_CHUNK];
+	client_t *c;
+	ssize_t n;
+	int i;
+
+	n = read(s->dev->fd, buf, sizeof(buf));
+	if (n < 0) {
+		if (errno == EINTR || errno == EAGAIN) {
+			return 0;
+		}
+		pr_error("Failed to receive data: %s\n", strerror(errno));
+		return -1;
+	}
+	if (n == 0) {
+		return 0;
+	}
+
+	s->uart_rx += n;
+	for (i = 0; i < s->slots; i++) {
+		c = s->clients[i];
+		if (c == NULL || c->fd < 0) {
+			continue;
+		}
+		client_enqueue(c, buf, n);
+		/* 先直接发送，只有发不完时才需要 EPOLLOUT */
+		if (client_flush(s, c) == 0 && client_update_events(s, i) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int server_uart_write(server_t *s)
+{
+	ssize_t n;
+
+	while (s->tx_len > 0) {
+		n = write(s->dev->fd, s->tx + s->tx_off, s->tx_len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				break;
+			}
+			pr_error("Failed to send data: %s\n", strerror(errno));
+			return -1;
+		}
+		s->uart_tx += n;
+		s->tx_off += n;
+		s->tx_len -= n;
+	}
+
+	/* 腾出空间给下一次读取 */
+	if (s->tx_len == 0) {
+		s->tx_off = 0;
+	} else if (s->tx_off > 0 && SERVER_TX_SIZE - s->tx_off - s->tx_len < SERVER_CHUNK) {
+		memmove(s->tx, s->tx + s->tx_off, s->tx_len);
+		s->tx_off = 0;
+	}
+	return 0;
+}
+
+/* 读客户端一块数据，整体放入串口缓冲区 */
+static int client_read(server_t *s, client_t *c)
+{
+	ssize_t n;
+
+	if (SERVER_TX_SIZE - s->tx_len < SERVER_CHUNK) {
+		return 0;
+	}
+	if (SERVER_TX_SIZE - s->tx_off - s->tx_len < SERVER_CHUNK) {
+		memmove(s->tx, s->tx + s->tx_off, s->tx_len);
+		s->tx_off = 0;
+	}
+
+	n = recv(c->fd, s->tx + s->tx_off + s->tx_len, SERVER_CHUNK, 0);
+	if (n < 0) {
+		if (errno == EINTR || errno == EAGAIN) {
+			return 0;
+		}
+		client_close(s, c, strerror(errno));
+		return -1;
+	}
+	if (n == 0) {
+		client_close(s, c, "closed by peer");
+		return -1;
+	}
+
+	c->in_bytes += n;
+	s->tx_len += n;
+	return 0;
+}
+
+/* 串口缓冲区状态变化后更新串口和所有客户端关注的事件 */
+static int server_update_events(server_t *s)
+{
+	int i;
+
+	if (server_set_events(s, s->dev->fd, &s->uart_events,
+	                      EPOLLIN | (s->tx_len > 0 ? EPOLLOUT : 0),
+	                      EV_DATA(0, EV_KIND_UART)) < 0) {
+		return -1;
+	}
+	for (i = 0; i < s->slots; i++) {
+		if (s->clients[i] != NULL && s->clients[i]->fd >= 0 &&
+		    client_update_events(s, i) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* 每秒打印一次串口和每个客户端的速率及队列深度 */
+static void server_print_stats(server_t *s, int64_t elapsed_ns)
+{
+	client_t *c;
+	int i;
+
+	if (s->count == 0 && s->uart_rx == s->last_rx && s->uart_tx == s->last_tx) {
+		return;
+	}
+
+	printf("Server [%llds] : %d clients, uart rx %llu bytes/s, tx %llu bytes/s\n",
+	       (long long)(elapsed_ns / NSEC_PER_SEC), s->count,
+	       (unsigned long long)(s->uart_rx - s->last_rx),
+	       (unsigned long long)(s->uart_tx - s->last_tx));
+	s->last_rx = s->uart_rx;
+	s->last_tx = s->uart_tx;
+
+	for (i = 0; i < s->slots; i++) {
+		c = s->clients[i];
+		if (c == NULL || c->fd < 0) {
+			continue;
+		}
+		printf("  [%d] %s: out %llu bytes/s, in %llu bytes/s, queue %zu bytes, "
+		       "dropped %llu bytes\n",
+		       c->id, c->addr, (unsigned long long)(c->out_bytes - c->last_out),
+		       (unsigned long long)(c->in_bytes - c->last_in), c->len,
+		       (unsigned long long)c->dropped);
+		c->last_out = c->out_bytes;
+		c->last_in = c->in_bytes;
+	}
+}
+
+static int server_handle(server_t *s, const struct epoll_event *ev)
+{
+	int idx = (int)(ev->data.u64 >> 2);
+	client_t *c;
+
+	switch (ev->data.u64 & 3) {
+	case EV_KIND_LISTEN:
+		return server_accept(s);
+
+	case EV_KIND_UART:
+		if (ev->events & EPOLLOUT) {
+			if (server_uart_write(s) < 0) {
+				return -1;
+			}
+		}
+		if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+			if (ev->events & (EPOLLHUP | EPOLLERR) && !(ev->events & EPOLLIN)) {
+				pr_error("Serial port closed or failed\n");
+				return -1;
+			}
+			return server_uart_read(s);
+		}
+		return 0;
+
+	default:
+		c = s->clients[idx];
+		if (c == NULL || c->fd < 0) {
+			return 0; /* 本轮已断开 */
+		}
+		if ((ev->events & EPOLLOUT) && client_flush(s, c) < 0) {
+			return 0;
+		}
+		if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+			if (!(ev->events & EPOLLIN)) {
+				client_close(s, c, "connection error");
+				return 0;
+			}
+			if (client_read(s, c) < 0) {
+				return 0;
+			}
+			/* 新数据尽快写入串口 */
+			if (server_uart_write(s) < 0) {
+				return -1;
+			}
+		}
+		return 0;
+	}
+}
+
+static void server_close(server_t *s)
+{
+	int64_t now = timing_now_ns();
+	int i;
+
+	for (i = 0; i < s->slots; i++) {
+		if (s->clients[i] == NULL) {
+			continue;
+		}
+		if (s->clients[i]->fd >= 0) {
+			client_print(s->clients[i], now);
+			close(s->clients[i]->fd);
+		}
+		free(s->clients[i]->queue);
+		free(s->clients[i]);
+	}
+	free(s->clients);
+	if (s->listen_fd >= 0) {
+		close(s->listen_fd);
+	}
+	if (s->epfd >= 0) {
+		close(s->epfd);
+	}
+}
+
+int uart_server_test(uartdev_t *dev, const char *listen_spec)
+{
+	struct epoll_event events[SERVER_MAX_EVENTS];
+	struct epoll_event ev;
+	server_t *s;
+	int64_t start_ns, now, next_report_ns;
+	int i, n, timeout;
+	int ret = 0;
+
+	if (dev == NULL || listen_spec == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	s = calloc(1, sizeof(server_t));
+	if (s == NULL) {
+		pr_error("Failed to allocate memory for server\n");
+		return -1;
+	}
+	s->dev = dev;
+	s->listen_fd = -1;
+
+	s->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (s->epfd < 0) {
+		pr_error("epoll_create1() failed: %s\n", strerror(errno));
+		ret = -1;
+		goto out;
+	}
+	if (server_listen(s, listen_spec) < 0 || uartdev_set_nonblock(dev, 1) < 0) {
+		ret = -1;
+		goto out;
+	}
+	uartdev_flush(dev);
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = EV_DATA(0, EV_KIND_LISTEN);
+	if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->listen_fd, &ev) < 0) {
+		pr_error("epoll_ctl() failed: %s\n", strerror(errno));
+		ret = -1;
+		goto out;
+	}
+	s->uart_events = EPOLLIN;
+	ev.data.u64 = EV_DATA(0, EV_KIND_UART);
+	if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, dev->fd, &ev) < 0) {
+		pr_error("epoll_ctl() failed: %s\n", strerror(errno));
+		ret = -1;
+		goto out;
+	}
+
+	pr_info("Server listening on %s, press Ctrl+C to stop\n", listen_spec);
+
+	start_ns = timing_now_ns();
+	next_report_ns = start_ns + NSEC_PER_SEC;
+
+	while (g_running) {
+		now = timing_now_ns();
+		if (now >= next_report_ns) {
+			server_print_stats(s, now - start_ns);
+			next_report_ns += NSEC_PER_SEC * ((now - next_report_ns) / NSEC_PER_SEC + 1);
+		}
+
+		timeout = (int)((next_report_ns - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+		n = epoll_wait(s->epfd, events, SERVER_MAX_EVENTS, timeout);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_error("epoll_wait() failed: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+
+		for (i = 0; i < n && ret == 0; i++) {
+			ret = server_handle(s, &events[i]);
+		}
+		if (ret == 0) {
+			ret = server_update_events(s);
+		}
+		if (s->closing) {
+			server_sweep(s);
+		}
+		if (ret < 0) {
+			break;
+		}
+	}
+
+	pr_info("Server completed: %ld connections, uart rx %llu bytes, tx %llu bytes\n",
+	        s->accepted, (unsigned long long)s->uart_rx, (unsigned long long)s->uart_tx);
+
+out:
+	server_close(s);
+	free(s);
+	return ret;
+}
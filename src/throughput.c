@@ -0,0 +1,228 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "throughput.h"
+#include "icount.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+
+typedef struct {
+	uartdev_t *dev;
+	uint8_t mask;        /* 数据位掩码，7 位数据时为 0x7F */
+	int chunk;           /* 单次写入字节数 */
+	int64_t deadline_ns; /* 发送截止时间 */
+	long long tx_bytes;  /* 已写入的字节数 */
+	int64_t start_ns;    /* 开始发送时间 */
+	int64_t end_ns;      /* 发送完成（tcdrain 返回）时间 */
+	int done;            /* 发送线程是否结束 */
+	int error;           /* 发送线程的 errno，0 表示无错误 */
+} bench_tx_t;
+
+/*
+ * 发送线程：循环写入递增序列，阻塞 write() 保证 TX FIFO 始终是满的。
+ * 序列周期为 256，块大小是 256 的整数倍，所以缓冲区只需填充一次，
+ * 短写时从中断处继续即可保持序列连续。
+ */
+static void *bench_tx_thread(void *arg)
+{
+	bench_tx_t *tx = (bench_tx_t *)arg;
+	char buf[BENCH_TX_CHUNK];
+	int off = 0;
+	int n, i;
+
+	for (i = 0; i < tx->chunk; i++) {
+		buf[i] = (char)(i & tx->mask);
+	}
+
+	tx->start_ns = timing_now_ns();
+	while (g_running && timing_now_ns() < __atomic_load_n(&tx->deadline_ns, __ATOMIC_RELAXED)) {
+		n = uartdev_send(tx->dev, buf + off, tx->chunk - off);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			tx->error = errno;
+			break;
+		}
+		__atomic_add_fetch(&tx->tx_bytes, n, __ATOMIC_RELAXED);
+		off = (off + n) % tx->chunk;
+	}
+
+	/* 等待内核缓冲区中的数据全部发出 */
+	tcdrain(tx->dev->fd);
+	tx->end_ns = timing_now_ns();
+	__atomic_store_n(&tx->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void print_rate(const char *name, long long bytes, int64_t ns, double line_cps)
+{
+	double sec = ns > 0 ? (double)ns / NSEC_PER_SEC : 0;
+	double rate = sec > 0 ? bytes / sec : 0;
+
+	pr_info("  %s: %lld bytes in %.3f s, %.0f bytes/s = %.0f cps, efficiency %.1f%%\n", name,
+	        bytes, sec, rate, rate, line_cps > 0 ? rate * 100.0 / line_cps : 0);
+}
+
+int uart_bench_test(uartdev_t *dev, int duration_sec)
+{
+	bench_tx_t tx;
+	icount_t ic;
+	pthread_t tid;
+	struct pollfd pfd;
+	char *rx_buf;
+	long long rx_bytes = 0;
+	long long seq_errors = 0;
+	long long lost;
+	uint8_t expected = 0;
+	int64_t first_rx_ns = 0, last_rx_ns = 0, now, next_report;
+	int frame_bits;
+	double line_cps;
+	int elapsed = 0;
+	int ret, n, i;
+
+	if (dev == NULL || duration_sec < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	frame_bits = uartdev_frame_bits(dev);
+	line_cps = (double)dev->baud / frame_bits;
+
+	rx_buf = malloc(BENCH_RX_BUF_SIZE);
+	if (rx_buf == NULL) {
+		pr_error("Failed to allocate memory for receive buffer\n");
+		return -1;
+	}
+
+	memset(&tx, 0, sizeof(tx));
+	tx.dev = dev;
+	tx.mask = (uint8_t)((1 << dev->data_bit) - 1);
+	/* 每次写入约 50ms 的数据量，保证截止时间到达后能及时退出 */
+	tx.chunk = (int)(line_cps / 20) & ~255;
+	if (tx.chunk < 256) {
+		tx.chunk = 256;
+	} else if (tx.chunk > BENCH_TX_CHUNK) {
+		tx.chunk = BENCH_TX_CHUNK;
+	}
+
+	pr_info("Bench test: %d %d%c%d (%d bits/char), theoretical %.0f cps, duration %d "
+	        "seconds\n",
+	        dev->baud, dev->data_bit, dev->parity, dev->stop_bit, frame_bits, line_cps,
+	        duration_sec);
+
+	/* 清空缓冲区 */
+	uartdev_flush(dev);
+	icount_start(&ic, dev);
+
+	tx.deadline_ns = duration_sec > 0
+	                     ? timing_now_ns() + (int64_t)duration_sec * NSEC_PER_SEC
+	                     : INT64_MAX;
+	ret = pthread_create(&tid, NULL, bench_tx_thread, &tx);
+	if (ret != 0) {
+		pr_error("Failed to create TX thread: %s\n", strerror(ret));
+		free(rx_buf);
+		return -1;
+	}
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLIN;
+	next_report = timing_now_ns() + NSEC_PER_SEC;
+
+	/*
+	 * 被 Ctrl+C 中断时发送线程停止写入并等待 tcdrain()，接收端继续读到发送结束并空闲
+	 * 一段时间为止，否则还在路上的数据都会被算作丢失
+	 */
+	while (1) {
+		now = timing_now_ns();
+
+		/* 发送结束后，接收端空闲一段时间即认为数据已收完 */
+		if (__atomic_load_n(&tx.done, __ATOMIC_ACQUIRE) &&
+		    now - (last_rx_ns > tx.end_ns ? last_rx_ns : tx.end_ns) >
+		        BENCH_DRAIN_IDLE_MS * NSEC_PER_MSEC) {
+			break;
+		}
+
+		if (now >= next_report) {
+			elapsed++;
+			printf("Bench [%ds] : tx %lld bytes, rx %lld bytes\n", elapsed,
+			       __atomic_load_n(&tx.tx_bytes, __ATOMIC_RELAXED), rx_bytes);
+			icount_poll(&ic, 0);
+			next_report += NSEC_PER_SEC;
+		}
+
+		ret = poll(&pfd, 1, 100);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_error("poll() failed: %s\n", strerror(errno));
+			break;
+		} else if (ret == 0 || !(pfd.revents & POLLIN)) {
+			continue;
+		}
+
+		n = uartdev_recv(dev, rx_buf, BENCH_RX_BUF_SIZE);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			pr_error("uartdev_recv() failed: %s\n", strerror(errno));
+			break;
+		}
+
+		last_rx_ns = timing_now_ns();
+		if (rx_bytes == 0) {
+			first_rx_ns = last_rx_ns;
+		}
+		rx_bytes += n;
+
+		/* 校验序列，出错后以收到的值重新同步 */
+		for (i = 0; i < n; i++) {
+			if ((uint8_t)rx_buf[i] != expected) {
+				seq_errors++;
+				expected = (uint8_t)rx_buf[i];
+			}
+			expected = (expected + 1) & tx.mask;
+		}
+	}
+
+	/* 接收出错退出循环时发送线程可能还在运行，让它在当前写入完成后退出 */
+	__atomic_store_n(&tx.deadline_ns, 0, __ATOMIC_RELAXED);
+	pthread_join(tid, NULL);
+	free(rx_buf);
+
+	if (tx.error) {
+		pr_error("Failed to send data: %s\n", strerror(tx.error));
+	}
+
+	lost = tx.tx_bytes - rx_bytes;
+	pr_info("Bench result: %d %d%c%d, theoretical %.0f cps (%d bits/s line rate)\n",
+	        dev->baud, dev->data_bit, dev->parity, dev->stop_bit, line_cps, dev->baud);
+	print_rate("TX", tx.tx_bytes, tx.end_ns - tx.start_ns, line_cps);
+	print_rate("RX", rx_bytes, last_rx_ns - first_rx_ns, line_cps);
+	pr_info("  Lost: %lld bytes (%.4f%%), sequence errors: %lld\n", lost,
+	        tx.tx_bytes > 0 ? lost * 100.0 / tx.tx_bytes : 0, seq_errors);
+	icount_report(&ic, rx_bytes, tx.tx_bytes);
+
+	if (tx.error || lost != 0 || seq_errors != 0) {
+		return -1;
+	}
+
+	return 0;
+}
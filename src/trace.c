@@ -0,0 +1,193 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "trace.h"
+#include "mydebug.h"
+#include <errno.h>
+
+#ifdef __TRACE__
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int g_trace_enabled = 0;
+__thread trace_buf_t *g_trace_buf = NULL;
+
+static struct {
+	FILE *fp;
+	char *path;
+	int64_t start_ns;       /* 事件时间相对于此输出 */
+	pthread_mutex_t lock;   /* 保护缓冲区链表，只在线程第一次记录时使用 */
+	trace_buf_t *bufs;
+} g_trace = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+trace_buf_t *trace_thread_buf(void)
+{
+	trace_buf_t *b;
+
+	if (g_trace_buf != NULL) {
+		return g_trace_buf;
+	}
+	if (!g_trace_enabled) {
+		return NULL;
+	}
+
+	b = calloc(1, sizeof(*b));
+	if (b == NULL) {
+		return NULL;
+	}
+	b->events = malloc(TRACE_BUF_EVENTS * sizeof(trace_event_t));
+	if (b->events == NULL) {
+		free(b);
+		return NULL;
+	}
+	/* 提前触发缺页，记录事件时不会因此产生延迟 */
+	memset(b->events, 0, TRACE_BUF_EVENTS * sizeof(trace_event_t));
+	b->tid = (int)syscall(SYS_gettid);
+	prctl(PR_GET_NAME, b->name, 0, 0, 0);
+	b->name[TRACE_NAME_LEN - 1] = '\0';
+
+	pthread_mutex_lock(&g_trace.lock);
+	b->next = g_trace.bufs;
+	g_trace.bufs = b;
+	pthread_mutex_unlock(&g_trace.lock);
+
+	g_trace_buf = b;
+	return b;
+}
+
+void trace_thread_name(const char *name)
+{
+	trace_buf_t *b = trace_thread_buf();
+
+	if (b != NULL) {
+		snprintf(b->name, sizeof(b->name), "%s", name);
+	}
+}
+
+int trace_open(const char *path)
+{
+	g_trace.fp = fopen(path, "w");
+	if (g_trace.fp == NULL) {
+		pr_error("Failed to open trace file %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	g_trace.path = strdup(path);
+	if (g_trace.path == NULL) {
+		fclose(g_trace.fp);
+		g_trace.fp = NULL;
+		return -1;
+	}
+
+	g_trace.start_ns = timing_now_ns();
+	g_trace_enabled = 1;
+	if (trace_thread_buf() == NULL) {
+		pr_error("Failed to allocate trace buffer\n");
+		g_trace_enabled = 0;
+		fclose(g_trace.fp);
+		g_trace.fp = NULL;
+		free(g_trace.path);
+		g_trace.path = NULL;
+		return -1;
+	}
+
+	pr_info("Trace: recording up to %d events per thread, written to %s at exit\n",
+	        TRACE_BUF_EVENTS, path);
+	return 0;
+}
+
+/* 纳秒按微秒输出，保留 3 位小数，用整数运算避免大数值的 double 精度损失 */
+static void trace_print_us(FILE *fp, int64_t ns)
+{
+	fprintf(fp, "%lld.%03lld", (long long)(ns / NSEC_PER_USEC),
+	        (long long)(ns % NSEC_PER_USEC));
+}
+
+void trace_close(void)
+{
+	trace_buf_t *b, *next;
+	const trace_event_t *e;
+	unsigned long long total = 0, dropped = 0;
+	int pid = (int)getpid();
+	int first = 1;
+	uint32_t i;
+	int ok;
+
+	if (g_trace.fp == NULL) {
+		return;
+	}
+	g_trace_enabled = 0;
+
+	fprintf(g_trace.fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (b = g_trace.bufs; b != NULL; b = b->next) {
+		fprintf(g_trace.fp,
+		        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+		        "\"args\":{\"name\":\"%s\"}}",
+		        first ? "" : ",\n", pid, b->tid, b->name);
+		first = 0;
+		for (i = 0; i < b->count; i++) {
+			e = &b->events[i];
+			fprintf(g_trace.fp,
+			        ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":",
+			        e->name, pid, b->tid);
+			trace_print_us(g_trace.fp, e->start_ns - g_trace.start_ns);
+			fprintf(g_trace.fp, ",\"dur\":");
+			trace_print_us(g_trace.fp, e->dur_ns);
+			fprintf(g_trace.fp, "}");
+		}
+		total += b->count;
+		dropped += b->dropped;
+	}
+	fprintf(g_trace.fp, "\n]}\n");
+
+	ok = !ferror(g_trace.fp);
+	if (fclose(g_trace.fp) != 0) {
+		ok = 0;
+	}
+	if (ok) {
+		pr_info("Trace: %llu events written to %s", total, g_trace.path);
+		if (dropped > 0) {
+			printf(", %llu dropped (buffer full)", dropped);
+		}
+		printf("\n");
+	} else {
+		pr_error("Failed to write trace file %s: %s\n", g_trace.path, strerror(errno));
+	}
+
+	for (b = g_trace.bufs; b != NULL; b = next) {
+		next = b->next;
+		free(b->events);
+		free(b);
+	}
+	g_trace.bufs = NULL;
+	g_trace_buf = NULL;
+	g_trace.fp = NULL;
+	free(g_trace.path);
+	g_trace.path = NULL;
+}
+
+#else
+
+int trace_open(const char *path)
+{
+	(void)path;
+	pr_error("--trace is not available, rebuild with cmake -DENABLE_TRACE=ON\n");
+	errno = ENOTSUP;
+	return -1;
+}
+
+void trace_close(void)
+{
+}
+
+#endif /* __TRACE__ */
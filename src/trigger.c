@@ -0,0 +1,540 @@
+/*
+Copyright (C) 2025 Lishaocheng <https://shaocheng.li>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License version 3 as published by the
+Free Software Foundation.
+*/
+
+#include "trigger.h"
+#include "hex_codec.h"
+#include "mydebug.h"
+#include "timing.h"
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define NO_STATE 0xFFFF /* 生成自动机时表示没有转移 */
+#define HOOK_ENV_COUNT 4
+
+int trigger_init(trigger_t *t, const char *port)
+{
+	if (t == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(t, 0, sizeof(*t));
+	t->port = port;
+	return 0;
+}
+
+int trigger_add_pattern(trigger_t *t, const char *spec)
+{
+	trigger_pattern_t *p;
+	size_t len, err_pos;
+	int i;
+
+	if (t == NULL || spec == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (t->pattern_count >= TRIGGER_MAX_PATTERNS) {
+		pr_error("Too many trigger patterns (max %d)\n", TRIGGER_MAX_PATTERNS);
+		return -1;
+	}
+
+	p = &t->patterns[t->pattern_count];
+	if (strncmp(spec, "hex:", 4) == 0) {
+		len = strlen(spec + 4);
+		if (len == 0 || len % 2 != 0 || len / 2 > TRIGGER_MAX_PATTERN_LEN ||
+		    hex_decode(spec + 4, len, p->data, &err_pos) < 0) {
+			pr_error("Invalid trigger pattern: %s (should be 1-%d bytes of hex, e.g. "
+			         "hex:0d0a)\n",
+			         spec, TRIGGER_MAX_PATTERN_LEN);
+			return -1;
+		}
+		p->len = len / 2;
+		snprintf(p->label, sizeof(p->label), "%s", spec);
+	} else {
+		len = strlen(spec);
+		if (len == 0 || len > TRIGGER_MAX_PATTERN_LEN) {
+			pr_error("Invalid trigger pattern: \"%s\" (should be 1-%d characters)\n", spec,
+			         TRIGGER_MAX_PATTERN_LEN);
+			return -1;
+		}
+		memcpy(p->data, spec, len);
+		p->len = len;
+		snprintf(p->label, sizeof(p->label), "\"%s\"", spec);
+	}
+
+	for (i = 0; i < t->pattern_count; i++) {
+		if (t->patterns[i].len == p->len && memcmp(t->patterns[i].data, p->data, p->len) == 0) {
+			pr_error("Duplicate trigger pattern: %s\n", spec);
+			return -1;
+		}
+	}
+
+	p->matches = 0;
+	t->pattern_count++;
+	return 0;
+}
+
+static int parse_int(const char *s, long min, long max, long *val)
+{
+	char *end;
+
+	errno = 0;
+	*val = strtol(s, &end, 10);
+	if (end == s || *end != '\0' || errno != 0 || *val < min || *val > max) {
+		return -1;
+	}
+	return 0;
+}
+
+int trigger_add_action(trigger_t *t, const char *spec)
+{
+	long val;
+
+	if (t == NULL || spec == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (strcmp(spec, "log") == 0) {
+		t->do_log = 1;
+	} else if (strcmp(spec, "exit") == 0) {
+		t->do_exit = 1;
+		t->exit_code = 0;
+	} else if (strncmp(spec, "exit:", 5) == 0) {
+		if (parse_int(spec + 5, 0, 255, &val) < 0) {
+			pr_error("Invalid exit code: %s (should be 0-255)\n", spec + 5);
+			return -1;
+		}
+		t->do_exit = 1;
+		t->exit_code = val;
+	} else if (strncmp(spec, "hook:", 5) == 0) {
+		if (spec[5] == '\0') {
+			pr_error("Empty hook command\n");
+			return -1;
+		}
+		if (t->hook != NULL) {
+			pr_error("Only one hook command is supported\n");
+			return -1;
+		}
+		t->hook = strdup(spec + 5);
+		if (t->hook == NULL) {
+			return -1;
+		}
+	} else if (strcmp(spec, "snapshot") == 0) {
+		t->snapshot = TRIGGER_SNAPSHOT_DEFAULT;
+	} else if (strncmp(spec, "snapshot:", 9) == 0) {
+		if (parse_int(spec + 9, 1, TRIGGER_SNAPSHOT_MAX, &val) < 0) {
+			pr_error("Invalid snapshot size: %s (should be 1-%d bytes)\n", spec + 9,
+			         TRIGGER_SNAPSHOT_MAX);
+			return -1;
+		}
+		t->snapshot = val;
+	} else {
+		pr_error("Invalid match action: %s (should be log, exit[:code], hook:<cmd> or "
+		         "snapshot[:N])\n",
+		         spec);
+		return -1;
+	}
+
+	return 0;
+}
+
+int trigger_compile(trigger_t *t)
+{
+	uint16_t *queue;
+	int total = 1, max_len = 0;
+	int head = 0, tail = 0;
+	int i, j, c, s, u, f;
+
+	if (t == NULL || t->pattern_count == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < t->pattern_count; i++) {
+		total += t->patterns[i].len;
+		if (t->patterns[i].len > max_len) {
+			max_len = t->patterns[i].len;
+		}
+	}
+	if (total > TRIGGER_MAX_STATES) {
+		pr_error("Trigger patterns too long: %d bytes in total (max %d)\n", total - 1,
+		         TRIGGER_MAX_STATES - 1);
+		return -1;
+	}
+
+	if (!t->do_log && !t->do_exit && t->hook == NULL && t->snapshot == 0) {
+		t->do_log = 1;
+	}
+
+	t->delta = malloc((size_t)total * 256 * sizeof(uint16_t));
+	t->out = malloc(total * sizeof(int16_t));
+	t->dict = calloc(total, sizeof(uint16_t));
+	t->flag = calloc(total, sizeof(uint8_t));
+	t->out_buf = malloc(sizeof(outbuf_t));
+	queue = malloc(total * sizeof(uint16_t));
+	if (t->delta == NULL || t->out == NULL || t->dict == NULL || t->flag == NULL ||
+	    t->out_buf == NULL || queue == NULL) {
+		pr_error("Failed to allocate memory for trigger automaton\n");
+		free(queue);
+		return -1;
+	}
+	memset(t->delta, 0xFF, (size_t)total * 256 * sizeof(uint16_t));
+	for (i = 0; i < total; i++) {
+		t->out[i] = -1;
+	}
+	outbuf_init(t->out_buf, stdout);
+
+	/* 字典树 */
+	t->state_count = 1;
+	for (i = 0; i < t->pattern_count; i++) {
+		s = 0;
+		for (j = 0; j < t->patterns[i].len; j++) {
+			c = t->patterns[i].data[j];
+			if (t->delta[s * 256 + c] == NO_STATE) {
+				t->delta[s * 256 + c] = t->state_count++;
+			}
+			s = t->delta[s * 256 + c];
+		}
+		t->out[s] = i;
+	}
+
+	/*
+	 * 按层次遍历求失败链，同时把缺失的转移补成失败状态的转移，
+	 * 得到完整的 DFA：扫描时每个字节只查一次表，不回溯
+	 */
+	for (c = 0; c < 256; c++) {
+		u = t->delta[c];
+		if (u == NO_STATE) {
+			t->delta[c] = 0;
+		} else {
+			t->dict[u] = 0;
+			queue[tail++] = u;
+		}
+	}
+	/* dict 暂存失败状态，出队时再换成最近的输出状态 */
+	while (head < tail) {
+		s = queue[head++];
+		f = t->dict[s];
+		for (c = 0; c < 256; c++) {
+			u = t->delta[s * 256 + c];
+			if (u == NO_STATE) {
+				t->delta[s * 256 + c] = t->delta[f * 256 + c];
+			} else {
+				t->dict[u] = t->delta[f * 256 + c];
+				queue[tail++] = u;
+			}
+		}
+		/* f 比 s 浅，已经出队，dict[f] 已是最终值 */
+		t->dict[s] = t->out[f] >= 0 ? f : t->dict[f];
+		t->flag[s] = t->out[s] >= 0 || t->dict[s] != 0;
+	}
+	free(queue);
+
+	/* snapshot 需要的历史数据：前后各 N 字节加模式本身，分段扫描时每段不超过一半 */
+	if (t->snapshot > 0) {
+		t->history_size = 1024;
+		while (t->history_size < 2 * (2 * (size_t)t->snapshot + max_len)) {
+			t->history_size *= 2;
+		}
+		t->history = malloc(t->history_size);
+		if (t->history == NULL) {
+			pr_error("Failed to allocate memory for trigger snapshot\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int trigger_setup(trigger_t *t, const char *port, char *const *patterns, int pattern_count,
+                  char *const *actions, int action_count)
+{
+	int i;
+
+	if (trigger_init(t, port) < 0) {
+		return -1;
+	}
+	for (i = 0; i < pattern_count; i++) {
+		if (trigger_add_pattern(t, patterns[i]) < 0) {
+			goto fail;
+		}
+	}
+	for (i = 0; i < action_count; i++) {
+		if (trigger_add_action(t, actions[i]) < 0) {
+			goto fail;
+		}
+	}
+	if (trigger_compile(t) < 0) {
+		goto fail;
+	}
+	return 0;
+
+fail:
+	trigger_free(t);
+	return -1;
+}
+
+/* 打印匹配的前缀：时间戳和序号 */
+static void trigger_print_head(trigger_t *t, const char *what, long number, int64_t ts_ns,
+                               int pattern, uint64_t start)
+{
+	outbuf_timestamp(t->out_buf, ts_ns);
+	outbuf_printf(t->out_buf, "%s [%ld] : %s at byte %llu", what, number,
+	              t->patterns[pattern].label, (unsigned long long)start);
+}
+
+static void trigger_run_hook(trigger_t *t, int pattern, uint64_t start, int64_t ts_ns)
+{
+	char env_pattern[TRIGGER_MAX_PATTERN_LEN + 64];
+	char env_offset[48], env_time[48], env_port[256];
+	char *argv[] = {"/bin/sh", "-c", t->hook, NULL};
+	char **envp;
+	int n = 0, i, status, err;
+
+	/* 上一个 hook 还在运行时跳过，避免频繁匹配时进程堆积 */
+	if (t->hook_pid > 0) {
+		if (waitpid(t->hook_pid, &status, WNOHANG) == 0) {
+			t->hooks_skipped++;
+			return;
+		}
+		t->hook_pid = 0;
+	}
+
+	while (environ[n] != NULL) {
+		n++;
+	}
+	envp = malloc((n + HOOK_ENV_COUNT + 1) * sizeof(char *));
+	if (envp == NULL) {
+		t->hooks_skipped++;
+		return;
+	}
+
+	snprintf(env_pattern, sizeof(env_pattern), "UART_TRIGGER_PATTERN=%s",
+	         t->patterns[pattern].label);
+	snprintf(env_offset, sizeof(env_offset), "UART_TRIGGER_OFFSET=%llu",
+	         (unsigned long long)start);
+	snprintf(env_time, sizeof(env_time), "UART_TRIGGER_TIME=%lld.%09lld",
+	         (long long)(ts_ns / NSEC_PER_SEC), (long long)(ts_ns % NSEC_PER_SEC));
+	snprintf(env_port, sizeof(env_port), "UART_PORT=%s", t->port ? t->port : "");
+	envp[0] = env_pattern;
+	envp[1] = env_offset;
+	envp[2] = env_time;
+	envp[3] = env_port;
+	for (i = 0; i < n; i++) {
+		envp[HOOK_ENV_COUNT + i] = environ[i];
+	}
+	envp[HOOK_ENV_COUNT + n] = NULL;
+
+	err = posix_spawn(&t->hook_pid, "/bin/sh", NULL, NULL, argv, envp);
+	free(envp);
+	if (err != 0) {
+		pr_error("Failed to run hook: %s\n", strerror(err));
+		t->hook_pid = 0;
+		t->hooks_skipped++;
+		return;
+	}
+	t->hooks_started++;
+}
+
+static void trigger_fire(trigger_t *t, int pattern, uint64_t end, int64_t ts_ns)
+{
+	trigger_pattern_t *p = &t->patterns[pattern];
+	trigger_pending_t *pd;
+	uint64_t start = end - p->len;
+
+	t->matches++;
+	p->matches++;
+
+	if (t->do_log || (t->do_exit && !t->fired_exit)) {
+		trigger_print_head(t, "Trigger", t->matches, ts_ns, pattern, start);
+		outbuf_write(t->out_buf, "\n", 1);
+	}
+
+	if (t->snapshot > 0) {
+		if (t->pending_count < TRIGGER_MAX_PENDING) {
+			pd = &t->pending[t->pending_count++];
+			pd->pattern = pattern;
+			pd->start = start > (uint64_t)t->snapshot ? start - t->snapshot : 0;
+			pd->end = end + t->snapshot;
+			pd->match = start;
+			pd->ts_ns = ts_ns;
+			pd->number = t->matches;
+		} else {
+			t->snapshots_dropped++;
+		}
+	}
+
+	if (t->hook != NULL) {
+		trigger_run_hook(t, pattern, start, ts_ns);
+	}
+
+	if (t->do_exit) {
+		t->fired_exit = 1;
+	}
+}
+
+/* 输出一个 snapshot，数据取自历史缓冲区，end 不超过已扫描的字节数 */
+static void trigger_print_snapshot(trigger_t *t, const trigger_pending_t *pd, uint64_t end)
+{
+	char buf[2 * TRIGGER_SNAPSHOT_MAX + TRIGGER_MAX_PATTERN_LEN];
+	size_t mask = t->history_size - 1;
+	uint64_t off;
+	int n = 0;
+
+	for (off = pd->start; off < end; off++) {
+		buf[n++] = t->history[off & mask];
+	}
+
+	trigger_print_head(t, "Snapshot", pd->number, pd->ts_ns, pd->pattern, pd->match);
+	outbuf_printf(t->out_buf, " (%llu bytes before, %llu after)\n",
+	              (unsigned long long)(pd->match - pd->start),
+	              (unsigned long long)(end - pd->match - t->patterns[pd->pattern].len));
+	outbuf_hex(t->out_buf, buf, n);
+}
+
+/* 输出后续数据已经收齐的 snapshot，pending 按 end 递增排列 */
+static void trigger_resolve(trigger_t *t, int all)
+{
+	int done = 0;
+
+	while (done < t->pending_count && (all || t->pending[done].end <= t->offset)) {
+		trigger_print_snapshot(t, &t->pending[done],
+		                       t->pending[done].end < t->offset ? t->pending[done].end
+		                                                         : t->offset);
+		done++;
+	}
+	if (done > 0) {
+		t->pending_count -= done;
+		memmove(t->pending, t->pending + done, t->pending_count * sizeof(t->pending[0]));
+	}
+}
+
+/* 扫描一段数据，热点循环 */
+static void trigger_scan(trigger_t *t, const uint8_t *data, size_t len, int64_t ts_ns)
+{
+	const uint16_t *delta = t->delta;
+	const uint8_t *flag = t->flag;
+	unsigned int s = t->state;
+	unsigned int u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		s = delta[(s << 8) | data[i]];
+		if (__builtin_expect(flag[s], 0)) {
+			/* 当前状态及失败链上所有以此结尾的模式 */
+			for (u = t->out[s] >= 0 ? s : t->dict[s]; u != 0; u = t->dict[u]) {
+				trigger_fire(t, t->out[u], t->offset + i + 1, ts_ns);
+			}
+		}
+	}
+	t->state = s;
+}
+
+int trigger_push(trigger_t *t, const char *data, size_t len, int64_t realtime_ns)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	size_t mask, piece, pos, n, part;
+
+	if (t->history == NULL) {
+		trigger_scan(t, p, len, realtime_ns);
+		t->offset += len;
+	} else {
+		/*
+		 * 分段扫描，每段不超过历史缓冲区的一半：段结束时收齐的 snapshot
+		 * 起点距当前位置不超过缓冲区大小，数据一定还在缓冲区中
+		 */
+		mask = t->history_size - 1;
+		piece = t->history_size / 2;
+		while (len > 0) {
+			n = len < piece ? len : piece;
+			trigger_scan(t, p, n, realtime_ns);
+			for (pos = 0; pos < n; pos += part) {
+				part = t->history_size - ((t->offset + pos) & mask);
+				if (part > n - pos) {
+					part = n - pos;
+				}
+				memcpy(t->history + ((t->offset + pos) & mask), p + pos, part);
+			}
+			t->offset += n;
+			if (t->pending_count > 0) {
+				trigger_resolve(t, 0);
+			}
+			p += n;
+			len -= n;
+		}
+	}
+
+	outbuf_flush(t->out_buf);
+
+	return t->fired_exit;
+}
+
+void trigger_finish(trigger_t *t)
+{
+	int status, i;
+
+	if (t == NULL || t->delta == NULL) {
+		return;
+	}
+
+	if (t->pending_count > 0) {
+		trigger_resolve(t, 1);
+	}
+	outbuf_flush(t->out_buf);
+
+	if (t->hook_pid > 0) {
+		pr_info("Waiting for hook (pid %d) to finish...\n", (int)t->hook_pid);
+		waitpid(t->hook_pid, &status, 0);
+		t->hook_pid = 0;
+	}
+
+	pr_info("Trigger: %ld matches in %llu bytes", t->matches, (unsigned long long)t->offset);
+	if (t->hook != NULL) {
+		printf(", %ld hooks run, %ld skipped", t->hooks_started, t->hooks_skipped);
+	}
+	if (t->snapshots_dropped > 0) {
+		printf(", %ld snapshots dropped", t->snapshots_dropped);
+	}
+	printf("\n");
+	for (i = 0; i < t->pattern_count; i++) {
+		printf("  %s: %llu\n", t->patterns[i].label,
+		       (unsigned long long)t->patterns[i].matches);
+	}
+	if (t->fired_exit) {
+		pr_info("Trigger: exit with code %d\n", t->exit_code);
+	}
+}
+
+void trigger_free(trigger_t *t)
+{
+	if (t == NULL) {
+		return;
+	}
+
+	free(t->delta);
+	free(t->out);
+	free(t->dict);
+	free(t->flag);
+	free(t->history);
+	free(t->out_buf);
+	free(t->hook);
+	t->delta = NULL;
+	t->out = NULL;
+	t->dict = NULL;
+	t->flag = NULL;
+	t->history = NULL;
+	t->out_buf = NULL;
+	t->hook = NULL;
+}
@@ -7,25 +7,39 @@ Free Software Foundation.
 */
 
 #include "uart_assist.h"
+#include "capture.h"
+#include "checksum.h"
+#include "expect.h"
+#include "framer.h"
+#include "hex_codec.h"
+#include "histogram.h"
+#include "icount.h"
 #include "json_config.h"
+#include "metrics.h"
 #include "mydebug.h"
+#include "outbuf.h"
+#include "spsc_ring.h"
+#include "timing.h"
+#include "trace.h"
 #include <ctype.h>
 #include <errno.h>
 #include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/prctl.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
 extern volatile int g_running; /* 全局运行标志，由信号处理设置 */
+extern int g_quiet;            /* 安静模式，不打印逐包输出 */
 
 int parse_hex_string(const char *hex_str, char *buf, int buf_len)
 {
-	int i, j;
+	size_t err_pos;
 	int len;
-	char c1, c2;
-	unsigned char byte;
 
 	if (hex_str == NULL || buf == NULL || buf_len <= 0) {
 		errno = EINVAL;
@@ -44,42 +58,13 @@ int parse_hex_string(const char *hex_str, char *buf, int buf_len)
 		return -1;
 	}
 
-	for (i = 0, j = 0; i < len; i += 2, j++) {
-		c1 = hex_str[i];
-		c2 = hex_str[i + 1];
-
-		/* 转换为小写并验证 */
-		c1 = tolower(c1);
-		c2 = tolower(c2);
-
-		if (!((c1 >= '0' && c1 <= '9') || (c1 >= 'a' && c1 <= 'f'))) {
-			pr_error("Invalid hex character at position %d: %c\n",
-			         i, c1);
-			return -1;
-		}
-		if (!((c2 >= '0' && c2 <= '9') || (c2 >= 'a' && c2 <= 'f'))) {
-			pr_error("Invalid hex character at position %d: %c\n",
-			         i + 1, c2);
-			return -1;
-		}
-
-		/* 转换为字节 */
-		if (c1 >= '0' && c1 <= '9') {
-			byte = (c1 - '0') << 4;
-		} else {
-			byte = (c1 - 'a' + 10) << 4;
-		}
-
-		if (c2 >= '0' && c2 <= '9') {
-			byte |= (c2 - '0');
-		} else {
-			byte |= (c2 - 'a' + 10);
-		}
-
-		buf[j] = (char)byte;
+	if (hex_decode(hex_str, len, (uint8_t *)buf, &err_pos) < 0) {
+		pr_error("Invalid hex character at position %d: %c\n", (int)err_pos,
+		         tolower((unsigned char)hex_str[err_pos]));
+		return -1;
 	}
 
-	return j;
+	return len / 2;
 }
 
 void print_timestamp(void)
@@ -139,6 +124,30 @@ void print_hex(const char *buf, int len)
 	}
 }
 
+void print_baud_info(const uartdev_t *dev)
+{
+	double err;
+
+	if (dev->actual_baud <= 0) {
+		if (_get_baud(dev->baud) < 0) {
+			pr_info("Baud rate: requested %d, granted rate unknown\n", dev->baud);
+		}
+		return;
+	}
+
+	if (dev->actual_baud == dev->baud && _get_baud(dev->baud) >= 0) {
+		return;
+	}
+
+	err = uartdev_baud_error(dev);
+	pr_info("Baud rate: requested %d, granted %d (error %+.3f%%)\n", dev->baud,
+	        dev->actual_baud, err);
+	if (err > UART_BAUD_TOLERANCE || err < -UART_BAUD_TOLERANCE) {
+		pr_error("Baud rate error exceeds %.1f%%, communication may fail\n",
+		         UART_BAUD_TOLERANCE);
+	}
+}
+
 int uart_recv_with_timeout(uartdev_t *dev, char *buf, int len, int timeout_sec)
 {
 	struct pollfd pfd;
@@ -154,7 +163,9 @@ int uart_recv_with_timeout(uartdev_t *dev, char *buf, int len, int timeout_sec)
 	pfd.events = POLLIN;
 
 	/* 使用 poll 实现超时 */
+	TRACE_BEGIN(poll);
 	ret = poll(&pfd, 1, timeout_sec * 1000);
+	TRACE_END(poll, "poll");
 	if (ret < 0) {
 		/* 如果被信号中断（如 Ctrl+C），检查 g_running 标志 */
 		if (errno == EINTR) {
@@ -170,7 +181,9 @@ int uart_recv_with_timeout(uartdev_t *dev, char *buf, int len, int timeout_sec)
 
 	/* 有数据可读 */
 	if (pfd.revents & POLLIN) {
+		TRACE_BEGIN(read);
 		nread = uartdev_recv(dev, buf, len);
+		TRACE_END(read, "read");
 		if (nread < 0) {
 			pr_error("uartdev_recv() failed: %s\n",
 			         strerror(errno));
@@ -190,6 +203,8 @@ int uart_loopback_test(uartdev_t *dev, const char *send_str,
 	int total_recv = 0;
 	const char *send_data;
 	int send_data_len;
+	icount_t ic;
+	int ret = -1;
 
 	if (dev == NULL || send_str == NULL) {
 		errno = EINVAL;
@@ -220,6 +235,7 @@ int uart_loopback_test(uartdev_t *dev, const char *send_str,
 
 	/* 清空缓冲区 */
 	uartdev_flush(dev);
+	icount_start(&ic, dev);
 
 	/* 发送数据 */
 	if (uartdev_send(dev, send_data, send_data_len) != send_data_len) {
@@ -235,11 +251,11 @@ int uart_loopback_test(uartdev_t *dev, const char *send_str,
 	                                  RECV_TIMEOUT_SEC);
 	if (recv_len < 0) {
 		pr_error("Failed to receive data: %s\n", strerror(errno));
-		return -1;
+		goto out;
 	} else if (recv_len == 0) {
 		pr_error("Receive timeout after %d seconds\n",
 		         RECV_TIMEOUT_SEC);
-		return -1;
+		goto out;
 	}
 
 	total_recv += recv_len;
@@ -256,7 +272,7 @@ int uart_loopback_test(uartdev_t *dev, const char *send_str,
 			pr_info("Sent: \"%s\"\n", send_str);
 		}
 		pr_info("Received: \"%s\"\n", recv_buf);
-		return -1;
+		goto out;
 	}
 
 	if (memcmp(send_data, recv_buf, send_data_len) != 0) {
@@ -267,22 +283,120 @@ int uart_loopback_test(uartdev_t *dev, const char *send_str,
 			pr_info("Sent: \"%s\"\n", send_str);
 		}
 		pr_info("Received: \"%s\"\n", recv_buf);
-		return -1;
+		goto out;
 	}
 
 	pr_info("Loopback test PASSED: sent and received %d bytes match\n",
 	        send_data_len);
-	return 0;
+	ret = 0;
+
+out:
+	/* 区分数据丢失在线路、驱动还是程序 */
+	icount_report(&ic, total_recv, send_data_len);
+	return ret;
+}
+
+/* 定时发送的周期统计 */
+typedef struct {
+	histogram_t period; /* 相邻两次发送的实际间隔 */
+	histogram_t jitter; /* 实际间隔与计划间隔之差的绝对值 */
+	histogram_t late;   /* 实际发送时间晚于 deadline 的时间 */
+	int64_t last_ns;    /* 上一次发送的时间 */
+	int64_t last_deadline_ns; /* 上一次发送的 deadline */
+	long missed;        /* 因为发送或打印超时而跳过的周期数 */
+	metrics_port_t *metrics; /* 调度延迟同时计入指标，NULL 表示不导出 */
+} cadence_t;
+
+/*
+ * 设置调用线程的定时器松弛，返回原来的值供结束时恢复。默认 50us 的松弛会推迟
+ * nanosleep/poll 的唤醒，send/file 模式的微秒级延时需要把它设为 1ns。
+ * 松弛按线程生效，之后创建的线程会继承，所以只在发送循环期间设置
+ */
+static unsigned long timer_slack_set(unsigned long ns)
+{
+	int old = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+
+	prctl(PR_SET_TIMERSLACK, ns, 0, 0, 0);
+	return old > 0 ? (unsigned long)old : ns;
+}
+
+static void cadence_init(cadence_t *c)
+{
+	hist_init(&c->period);
+	hist_init(&c->jitter);
+	hist_init(&c->late);
+	c->last_ns = 0;
+	c->last_deadline_ns = 0;
+	c->missed = 0;
+	c->metrics = NULL;
+}
+
+/* 在发送前调用，记录实际发送时间 */
+static void cadence_mark(cadence_t *c, int64_t deadline_ns)
+{
+	int64_t now = timing_now_ns();
+	int64_t diff;
+
+	hist_add(&c->late, now - deadline_ns);
+	metrics_late(c->metrics, now - deadline_ns);
+	if (c->last_ns != 0) {
+		hist_add(&c->period, now - c->last_ns);
+		diff = (now - c->last_ns) - (deadline_ns - c->last_deadline_ns);
+		hist_add(&c->jitter, diff < 0 ? -diff : diff);
+	}
+	c->last_ns = now;
+	c->last_deadline_ns = deadline_ns;
+}
+
+/* 睡眠到 deadline，最后 spin_ns 忙等，被信号中断时检查退出标志 */
+static void cadence_wait(int64_t deadline_ns, int64_t spin_ns)
+{
+	TRACE_BEGIN(sleep);
+	while (timing_wait_until(deadline_ns, spin_ns) < 0 && g_running) {
+	}
+	TRACE_END(sleep, "sleep");
+}
+
+static void cadence_report(const cadence_t *c)
+{
+	if (c->period.count > 0) {
+		pr_info("Period: min %.1f, avg %.1f, max %.1f us\n", c->period.min / 1e3,
+		        hist_mean(&c->period) / 1e3, c->period.max / 1e3);
+	}
+	hist_report_us(&c->jitter, "Period jitter");
+	hist_report_us(&c->late, "Wakeup latency");
+	if (c->missed > 0) {
+		pr_info("Missed periods: %ld (send took longer than the interval)\n", c->missed);
+	}
+}
+
+/* 生成打印用的校验值说明，如 " + crc16-modbus 374B" */
+static void checksum_label(const checksum_t *cs, const uint8_t *value, char *buf, size_t len)
+{
+	char hex[CHECKSUM_MAX_SIZE * 2 + 1];
+
+	hex_encode(value, checksum_size(cs), hex);
+	hex[checksum_size(cs) * 2] = '\0';
+	snprintf(buf, len, " + %s %s", cs->name, hex);
 }
 
 int uart_send_test(uartdev_t *dev, const char *send_str, int interval_ms,
-                   int count, output_format_t format)
+                   int count, output_format_t format, const char *checksum_spec)
 {
-	char send_buf[512];
+	checksum_t cs;
+	char cs_label[80] = "";
+	char *cs_buf = NULL;
+	char *send_buf = NULL;
 	int i = 0;
 	int sent_bytes = 0;
 	const char *send_data;
 	int send_data_len;
+	int ret;
+	int64_t interval_ns = interval_ms * NSEC_PER_MSEC;
+	int64_t deadline;
+	cadence_t cadence;
+	metrics_port_t *metrics;
+	unsigned long slack;
 
 	if (dev == NULL || send_str == NULL) {
 		errno = EINVAL;
@@ -290,10 +404,16 @@ int uart_send_test(uartdev_t *dev, const char *send_str, int interval_ms,
 	}
 
 	if (format == OUTPUT_HEX) {
-		/* 解析hex字符串 */
-		send_data_len =
-		    parse_hex_string(send_str, send_buf, sizeof(send_buf));
+		/* 解析hex字符串，缓冲区按字符串长度分配，不限制数据长度 */
+		send_data_len = strlen(send_str) / 2 + 1;
+		send_buf = malloc(send_data_len);
+		if (send_buf == NULL) {
+			pr_error("Failed to allocate memory for send data\n");
+			return -1;
+		}
+		send_data_len = parse_hex_string(send_str, send_buf, send_data_len);
 		if (send_data_len < 0) {
+			free(send_buf);
 			return -1;
 		}
 		send_data = send_buf;
@@ -325,114 +445,537 @@ int uart_send_test(uartdev_t *dev, const char *send_str, int interval_ms,
 		}
 	}
 
+	/* 校验值只计算一次，和数据一起放到新缓冲区 */
+	if (checksum_spec != NULL) {
+		if (checksum_init(&cs, checksum_spec) < 0) {
+			free(send_buf);
+			return -1;
+		}
+		cs_buf = malloc(send_data_len + CHECKSUM_MAX_SIZE);
+		if (cs_buf == NULL) {
+			pr_error("Failed to allocate memory for send data\n");
+			free(send_buf);
+			return -1;
+		}
+		memcpy(cs_buf, send_data, send_data_len);
+		checksum_append(&cs, cs_buf, send_data_len, (uint8_t *)cs_buf + send_data_len);
+		checksum_label(&cs, (uint8_t *)cs_buf + send_data_len, cs_label, sizeof(cs_label));
+		send_data_len += checksum_size(&cs);
+		send_data = cs_buf;
+		pr_info("Checksum: %s (%s), appended%s\n", cs.name, cs.impl, cs_label);
+	}
+
 	/* 清空缓冲区 */
 	uartdev_flush(dev);
 
+	/* 按 CLOCK_MONOTONIC 绝对时间调度，发送和打印的耗时不会累积 */
+	metrics = metrics_port(dev->port);
+	cadence_init(&cadence);
+	cadence.metrics = metrics;
+	slack = timer_slack_set(1);
+	deadline = timing_now_ns();
 	while (g_running) {
-		/* 发送数据 */
-		if (uartdev_send(dev, send_data, send_data_len) !=
-		    send_data_len) {
+		cadence_mark(&cadence, deadline);
+
+		/* 发送数据，部分写入时继续发送剩余部分 */
+		TRACE_BEGIN(write);
+		ret = uartdev_send_all(dev, send_data, send_data_len, &g_running);
+		TRACE_END(write, "write");
+		if (ret < 0 && !g_running) {
+			/* 被 Ctrl+C 中断，不是发送失败 */
+			break;
+		}
+		if (ret < 0) {
 			pr_error("Failed to send data: %s\n", strerror(errno));
+			metrics_error(metrics);
+			timer_slack_set(slack);
+			free(cs_buf);
+			free(send_buf);
 			return -1;
 		}
 
 		sent_bytes += send_data_len;
 		i++;
+		metrics_tx(metrics, send_data_len);
 
-		if (format == OUTPUT_HEX) {
-			printf("Send [%d] : hex=\"%s\" (%d bytes, total: %d "
+		TRACE_BEGIN(print);
+		if (g_quiet) {
+			/* 不打印 */
+		} else if (format == OUTPUT_HEX) {
+			printf("Send [%d] : hex=\"%s\"%s (%d bytes, total: %d "
 			       "bytes)\n",
-			       i, send_str, send_data_len, sent_bytes);
+			       i, send_str, cs_label, send_data_len, sent_bytes);
 		} else {
 			printf(
-			    "Send [%d] : \"%s\" (%d bytes, total: %d bytes)\n",
-			    i, send_str, send_data_len, sent_bytes);
+			    "Send [%d] : \"%s\"%s (%d bytes, total: %d bytes)\n",
+			    i, send_str, cs_label, send_data_len, sent_bytes);
 		}
+		TRACE_END(print, "print");
 
 		/* 检查发送次数 */
 		if (count > 0 && i >= count) {
 			break;
 		}
 
-		/* 延时 */
-		usleep(interval_ms * 1000);
+		/* 等待下一个周期 */
+		deadline = timing_next_deadline(deadline, interval_ns, timing_now_ns(),
+		                                &cadence.missed);
+		cadence_wait(deadline, 0);
 	}
 
+	timer_slack_set(slack);
 	pr_info("Send test completed: sent %d times, total %d bytes\n", i,
 	        sent_bytes);
+	cadence_report(&cadence);
+	free(cs_buf);
+	free(send_buf);
 	return 0;
 }
 
-int uart_recv_test(uartdev_t *dev, output_format_t format)
+/* 接收线程上下文 */
+typedef struct {
+	uartdev_t *dev;
+	spsc_ring_t ring;        /* 接收线程 -> 打印线程 */
+	long long dropped_bytes; /* 缓冲区满时丢弃的字节数 */
+	int done;                /* 接收线程是否结束 */
+	int error;               /* 接收线程的 errno，0 表示无错误 */
+	metrics_port_t *metrics;
+} recv_reader_t;
+
+/*
+ * 接收线程：只负责读串口并把数据块放入环形缓冲区，从不等待输出。
+ * 数据直接读入环形缓冲区的槽位，缓冲区满时读入临时缓冲区后丢弃并计数，
+ * 保证内核 tty 缓冲区始终被及时读空。
+ */
+static void *recv_reader_thread(void *arg)
 {
-	char recv_buf[256];
-	int recv_len;
-	int total_bytes = 0;
+	recv_reader_t *r = (recv_reader_t *)arg;
+	char scratch[RECV_CHUNK_SIZE];
+	struct pollfd pfd;
+	recv_chunk_t *chunk;
+	int64_t last_ns = timing_now_ns();
+	int64_t now;
+	char *buf;
+	int ret, n;
+
+	pfd.fd = r->dev->fd;
+	pfd.events = POLLIN;
+	TRACE_THREAD("recv_reader");
+
+	while (g_running) {
+		/* 短超时轮询，以便及时响应退出标志 */
+		TRACE_BEGIN(poll);
+		ret = poll(&pfd, 1, 100);
+		TRACE_END(poll, "poll");
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			r->error = errno;
+			metrics_error(r->metrics);
+			break;
+		} else if (ret == 0) {
+			now = timing_now_ns();
+			if (now - last_ns >= RECV_TIMEOUT_SEC * NSEC_PER_SEC) {
+				/* 超时事件也通过环形缓冲区通知打印线程，缓冲区满时跳过 */
+				chunk = spsc_ring_reserve(&r->ring);
+				if (chunk != NULL) {
+					chunk->ts_ns = now;
+					chunk->len = 0;
+					spsc_ring_commit(&r->ring);
+				}
+				last_ns = now;
+			}
+			continue;
+		}
+
+		chunk = spsc_ring_reserve(&r->ring);
+		buf = chunk != NULL ? chunk->data : scratch;
+
+		TRACE_BEGIN(read);
+		n = uartdev_recv(r->dev, buf, RECV_CHUNK_SIZE);
+		TRACE_END(read, "read");
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			r->error = errno;
+			metrics_error(r->metrics);
+			break;
+		} else if (n == 0) {
+			continue;
+		}
+
+		last_ns = timing_now_ns();
+		if (chunk == NULL) {
+			/* 只有真正读到并丢弃了数据才计数 */
+			spsc_ring_drop(&r->ring);
+			__atomic_add_fetch(&r->dropped_bytes, n, __ATOMIC_RELAXED);
+			metrics_error(r->metrics);
+			continue;
+		}
+
+		chunk->ts_ns = last_ns;
+		chunk->len = n;
+		spsc_ring_commit(&r->ring);
+	}
+
+	__atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/* 分帧打印的上下文 */
+typedef struct {
+	outbuf_t *out;
+	output_format_t format;
+	int64_t realtime_offset; /* CLOCK_REALTIME - CLOCK_MONOTONIC */
+	int64_t last_ns;         /* 上一帧最后一个数据块的时间 */
+	long count;
+	int checksum;            /* 是否检查校验值 */
+	metrics_port_t *metrics; /* 校验错误计入指标 */
+} recv_frame_ctx_t;
+
+/* 打印一帧，时间戳为帧的第一个数据块的时间，gap 为与上一帧结尾的间隔 */
+static void recv_print_frame(void *arg, const frame_t *frame)
+{
+	recv_frame_ctx_t *ctx = arg;
+	const char *flag = "";
+
+	if (frame->flags & FRAME_FLAG_OVERFLOW) {
+		flag = ", overflow";
+	} else if (frame->flags & FRAME_FLAG_INCOMPLETE) {
+		flag = ", incomplete";
+	} else if (frame->flags & FRAME_FLAG_BAD_CHECKSUM) {
+		flag = ", checksum ERROR";
+		metrics_error(ctx->metrics);
+	} else if (ctx->checksum) {
+		flag = ", checksum ok";
+	}
+
+	ctx->count++;
+	if (g_quiet) {
+		ctx->last_ns = frame->last_ns;
+		return;
+	}
+	outbuf_timestamp(ctx->out, frame->first_ns + ctx->realtime_offset);
+	if (ctx->format == OUTPUT_ASCII) {
+		outbuf_printf(ctx->out, "Frame [%ld] : \"", ctx->count);
+		outbuf_ascii(ctx->out, frame->data, frame->len);
+		outbuf_printf(ctx->out, "\" (%zu bytes, gap %.3f ms%s)\n", frame->len,
+		              ctx->last_ns ? (frame->first_ns - ctx->last_ns) / 1e6 : 0.0, flag);
+	} else {
+		outbuf_printf(ctx->out, "Frame [%ld] : (%zu bytes, gap %.3f ms%s)\n", ctx->count,
+		              frame->len,
+		              ctx->last_ns ? (frame->first_ns - ctx->last_ns) / 1e6 : 0.0, flag);
+		outbuf_hex(ctx->out, frame->data, frame->len);
+	}
+	outbuf_flush(ctx->out);
+	ctx->last_ns = frame->last_ns;
+}
+
+/* 触发器扫描原始字节流，状态跨数据块保存，exit 动作匹配时停止接收 */
+static inline void recv_trigger(trigger_t *trigger, const recv_chunk_t *chunk,
+                                int64_t realtime_offset)
+{
+	if (trigger != NULL && !trigger->fired_exit &&
+	    trigger_push(trigger, chunk->data, chunk->len, chunk->ts_ns + realtime_offset)) {
+		g_running = 0;
+	}
+}
+
+int uart_recv_test(uartdev_t *dev, output_format_t format, const char *capture_file,
+                   const char *frame_spec, const char *checksum_spec, trigger_t *trigger)
+{
+	recv_reader_t reader;
+	recv_chunk_t *chunk;
+	capture_t cap;
+	frame_rule_t rule;
+	framer_t framer;
+	checksum_t cs;
+	recv_frame_ctx_t frame_ctx;
+	char rule_str[128];
+	outbuf_t *out;
+	int64_t start_ns, next_report_ns;
+	pthread_t tid;
+	struct timespec rt;
+	int64_t realtime_offset;
+	uint64_t drops, last_drops = 0;
+	int64_t now, next_icount_ns;
+	icount_t ic;
+	long long total_bytes = 0;
 	int packet_count = 0;
+	int ret;
 
-	if (dev == NULL) {
+	/* 校验值在帧末尾检查，没有分帧规则时无法使用 */
+	if (dev == NULL || (checksum_spec != NULL && frame_spec == NULL)) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	pr_info("Receive test: format=%s, timeout=%d seconds\n",
-	        format == OUTPUT_ASCII ? "ASCII" : "HEX", RECV_TIMEOUT_SEC);
+	out = malloc(sizeof(outbuf_t));
+	if (out == NULL) {
+		pr_error("Failed to allocate memory for output buffer\n");
+		return -1;
+	}
+	outbuf_init(out, stdout);
+
+	/* 分帧器直接处理环形缓冲区中的数据块，只有跨块的帧才复制 */
+	memset(&frame_ctx, 0, sizeof(frame_ctx));
+	frame_ctx.out = out;
+	frame_ctx.format = format;
+	if (frame_spec != NULL &&
+	    (framer_parse_rule(&rule, frame_spec) < 0 ||
+	     framer_init(&framer, &rule, uartdev_char_time_ns(dev), recv_print_frame,
+	                 &frame_ctx) < 0)) {
+		pr_error("Failed to set up framer: %s\n", frame_spec);
+		free(out);
+		return -1;
+	}
+	if (checksum_spec != NULL) {
+		if (checksum_init(&cs, checksum_spec) < 0) {
+			framer_free(&framer);
+			free(out);
+			return -1;
+		}
+		framer_set_checksum(&framer, &cs);
+		frame_ctx.checksum = 1;
+	}
+
+	if (capture_file != NULL && capture_open(&cap, capture_file, dev) < 0) {
+		pr_error("Failed to create capture file %s: %s\n", capture_file, strerror(errno));
+		if (frame_spec != NULL) {
+			framer_free(&framer);
+		}
+		free(out);
+		return -1;
+	}
+
+	memset(&reader, 0, sizeof(reader));
+	reader.dev = dev;
+	reader.metrics = metrics_port(dev->port);
+	frame_ctx.metrics = reader.metrics;
+	if (spsc_ring_init(&reader.ring, RECV_RING_SLOTS, sizeof(recv_chunk_t)) < 0) {
+		pr_error("Failed to allocate receive ring: %s\n", strerror(errno));
+		if (capture_file != NULL) {
+			capture_close(&cap);
+		}
+		if (frame_spec != NULL) {
+			framer_free(&framer);
+		}
+		free(out);
+		return -1;
+	}
+
+	/* 数据块使用单调时钟，打印时换算成墙上时间 */
+	clock_gettime(CLOCK_REALTIME, &rt);
+	realtime_offset = (int64_t)rt.tv_sec * NSEC_PER_SEC + rt.tv_nsec - timing_now_ns();
+	frame_ctx.realtime_offset = realtime_offset;
+
+	if (capture_file != NULL) {
+		pr_info("Receive test: capture to %s, timeout=%d seconds\n", capture_file,
+		        RECV_TIMEOUT_SEC);
+	} else if (frame_spec != NULL) {
+		framer_describe(&rule, rule_str, sizeof(rule_str));
+		pr_info("Receive test: format=%s, frames split by %s, timeout=%d seconds\n",
+		        format == OUTPUT_ASCII ? "ASCII" : "HEX", rule_str, RECV_TIMEOUT_SEC);
+		if (checksum_spec != NULL) {
+			pr_info("Checksum: %s (%s), checked at the end of every frame\n", cs.name,
+			        cs.impl);
+		}
+	} else {
+		pr_info("Receive test: format=%s, timeout=%d seconds\n",
+		        format == OUTPUT_ASCII ? "ASCII" : "HEX", RECV_TIMEOUT_SEC);
+	}
+	if (trigger != NULL) {
+		pr_info("Trigger: %d patterns, %d automaton states, actions:%s%s%s%s\n",
+		        trigger->pattern_count, trigger->state_count, trigger->do_log ? " log" : "",
+		        trigger->do_exit ? " exit" : "", trigger->hook ? " hook" : "",
+		        trigger->snapshot ? " snapshot" : "");
+	}
 
 	/* 清空缓冲区 */
 	uartdev_flush(dev);
+	icount_start(&ic, dev);
+
+	ret = pthread_create(&tid, NULL, recv_reader_thread, &reader);
+	if (ret != 0) {
+		pr_error("Failed to create receive thread: %s\n", strerror(ret));
+		spsc_ring_free(&reader.ring);
+		if (capture_file != NULL) {
+			capture_close(&cap);
+		}
+		if (frame_spec != NULL) {
+			framer_free(&framer);
+		}
+		free(out);
+		return -1;
+	}
+	start_ns = timing_now_ns();
+	next_report_ns = start_ns + NSEC_PER_SEC;
+	next_icount_ns = next_report_ns;
+
+	/* 打印线程：读空环形缓冲区，接收线程结束后退出 */
+	while (1) {
+		/* 每秒检查一次驱动错误计数，有新错误时打印 */
+		now = timing_now_ns();
+		if (now >= next_icount_ns) {
+			icount_poll(&ic, 1);
+			next_icount_ns = now + NSEC_PER_SEC;
+		}
 
-	while (g_running) {
-		/* 接收数据（带超时） */
-		recv_len = uart_recv_with_timeout(
-		    dev, recv_buf, sizeof(recv_buf) - 1, RECV_TIMEOUT_SEC);
-		if (recv_len < 0) {
-			pr_error("Failed to receive data: %s\n",
-			         strerror(errno));
-			return -1;
-		} else if (recv_len == 0) {
-			/* 超时或被信号中断，检查是否需要退出 */
-			if (!g_running) {
-				/* 收到退出信号，退出循环 */
+		chunk = spsc_ring_peek(&reader.ring);
+		if (chunk == NULL) {
+			if (__atomic_load_n(&reader.done, __ATOMIC_ACQUIRE) &&
+			    spsc_ring_peek(&reader.ring) == NULL) {
 				break;
 			}
-			/* 超时，继续等待 */
+			if (frame_spec != NULL) {
+				framer_poll(&framer, timing_now_ns());
+			}
+			fflush(stdout);
+			usleep(1000);
+			continue;
+		}
+
+		if (chunk->len == 0) {
 			pr_info("Receive timeout (%d seconds), waiting for "
 			        "data...\n",
 			        RECV_TIMEOUT_SEC);
+			metrics_timeout(reader.metrics);
+			spsc_ring_release(&reader.ring);
 			continue;
 		}
 
-		total_bytes += recv_len;
+		total_bytes += chunk->len;
 		packet_count++;
+		metrics_rx(reader.metrics, chunk->len);
 
-		/* 打印统计信息和数据 */
-		if (format == OUTPUT_ASCII) {
-			/* 为ASCII格式，先打印数据，然后显示统计信息 */
-			printf("Recv [%d] : \"", packet_count);
-			print_ascii(recv_buf, recv_len);
-			printf("\" (%d bytes, total: %d bytes)\n", recv_len,
-			       total_bytes);
+		if (capture_file != NULL) {
+			/* 抓包：写入文件缓冲区，每秒打印一次统计 */
+			if (cap.error == 0 && capture_write(&cap, chunk->ts_ns, CAPTURE_DIR_RX,
+			                                    chunk->data, chunk->len) < 0) {
+				pr_error("Failed to write capture file: %s\n", strerror(errno));
+			}
+			recv_trigger(trigger, chunk, realtime_offset);
+
+			if (chunk->ts_ns >= next_report_ns) {
+				printf("Capture [%llds] : %d records, %lld bytes\n",
+				       (long long)((chunk->ts_ns - start_ns) / NSEC_PER_SEC),
+				       packet_count, total_bytes);
+				next_report_ns += NSEC_PER_SEC *
+				                  ((chunk->ts_ns - next_report_ns) / NSEC_PER_SEC + 1);
+			}
+			/* 用完槽位再归还，之后接收线程可能立即覆盖它 */
+			spsc_ring_release(&reader.ring);
+			continue;
+		}
+
+		if (frame_spec != NULL) {
+			TRACE_BEGIN(frame);
+			framer_push(&framer, chunk->data, chunk->len, chunk->ts_ns);
+			TRACE_END(frame, "frame");
+		} else if (!g_quiet) {
+			/* 打印时间戳、统计信息和数据，整块拼好后一次写出 */
+			TRACE_BEGIN(format);
+			outbuf_timestamp(out, chunk->ts_ns + realtime_offset);
+			if (format == OUTPUT_ASCII) {
+				/* 为ASCII格式，先打印数据，然后显示统计信息 */
+				outbuf_printf(out, "Recv [%d] : \"", packet_count);
+				outbuf_ascii(out, chunk->data, chunk->len);
+				outbuf_printf(out, "\" (%d bytes, total: %lld bytes)\n", chunk->len,
+				              total_bytes);
+			} else {
+				/* HEX格式，先显示统计信息，然后打印hex数据 */
+				outbuf_printf(out, "Recv [%d] : (%d bytes, total: %lld bytes)\n",
+				              packet_count, chunk->len, total_bytes);
+				outbuf_hex(out, chunk->data, chunk->len);
+			}
+			TRACE_END(format, "format");
+			TRACE_BEGIN(print);
+			outbuf_flush(out);
+			TRACE_END(print, "print");
+		}
+
+		recv_trigger(trigger, chunk, realtime_offset);
+		spsc_ring_release(&reader.ring);
+
+		drops = spsc_ring_drops(&reader.ring);
+		if (drops != last_drops) {
+			pr_error("Receive ring full, output too slow: dropped %llu chunks, %lld "
+			         "bytes so far\n",
+			         (unsigned long long)drops,
+			         __atomic_load_n(&reader.dropped_bytes, __ATOMIC_RELAXED));
+			last_drops = drops;
+		}
+	}
+
+	pthread_join(tid, NULL);
+
+	if (reader.error) {
+		pr_error("Failed to receive data: %s\n", strerror(reader.error));
+	}
+
+	pr_info("Receive test completed: received %d packets, total %lld bytes\n", packet_count,
+	        total_bytes);
+	icount_report(&ic, total_bytes, -1);
+	if (frame_spec != NULL) {
+		framer_flush(&framer);
+		pr_info("Framer: %llu frames, %llu bytes, %llu reassembled across reads, "
+		        "%llu truncated, %llu bytes discarded\n",
+		        (unsigned long long)framer.frames, (unsigned long long)framer.bytes,
+		        (unsigned long long)framer.copied, (unsigned long long)framer.overflows,
+		        (unsigned long long)framer.discarded);
+		if (checksum_spec != NULL) {
+			pr_info("Checksum: %llu errors in %llu frames\n",
+			        (unsigned long long)framer.checksum_errors,
+			        (unsigned long long)framer.frames);
+		}
+		framer_free(&framer);
+	}
+	if (trigger != NULL) {
+		trigger_finish(trigger);
+	}
+	pr_info("Receive ring: %zu/%zu slots high-water, dropped %llu chunks (%lld bytes)\n",
+	        spsc_ring_high_water(&reader.ring), spsc_ring_capacity(&reader.ring),
+	        (unsigned long long)spsc_ring_drops(&reader.ring), reader.dropped_bytes);
+	if (capture_file != NULL) {
+		if (capture_close(&cap) < 0) {
+			pr_error("Capture file %s is incomplete: %s\n", capture_file,
+			         strerror(cap.error ? cap.error : errno));
+			reader.error = reader.error ? reader.error : EIO;
 		} else {
-			/* HEX格式，先显示统计信息，然后打印hex数据 */
-			printf("Recv [%d] : (%d bytes, total: %d bytes)\n",
-			       packet_count, recv_len, total_bytes);
-			print_hex(recv_buf, recv_len);
+			pr_info("Capture: %llu records, %llu bytes written to %s\n",
+			        (unsigned long long)cap.records, (unsigned long long)cap.bytes,
+			        capture_file);
 		}
 	}
 
-	pr_info("Receive test completed: received %d packets, total %d bytes\n",
-	        packet_count, total_bytes);
-	return 0;
+	spsc_ring_free(&reader.ring);
+	free(out);
+
+	return reader.error ? -1 : 0;
 }
 
-int uart_file_test(uartdev_t *dev, const char *json_file)
+int uart_file_test(uartdev_t *dev, const char *json_file, int spin_us,
+                   const char *checksum_spec, int timeout_ms)
 {
 	json_config_t *config = NULL;
-	int cycle, i;
-	char send_buf[512];
-	int send_len;
+	expect_t *expect = NULL;
+	checksum_t cs;
+	char cs_label[80] = "";
+	send_record_t *rec, *end;
+	int64_t spin_ns = spin_us * NSEC_PER_USEC;
+	int64_t char_ns;
+	int64_t deadline, now;
+	cadence_t cadence;
+	metrics_port_t *metrics;
+	unsigned long slack;
+	int cycle;
 	int total_bytes = 0;
 	int sent_count = 0;
+	int ret = 0;
+	int n;
 
 	if (dev == NULL || json_file == NULL) {
 		errno = EINVAL;
@@ -453,63 +996,145 @@ int uart_file_test(uartdev_t *dev, const char *json_file)
 		return -1;
 	}
 
+	if (checksum_spec != NULL) {
+		if (checksum_init(&cs, checksum_spec) < 0 ||
+		    json_config_add_checksum(config, &cs) < 0) {
+			free_json_config(config);
+			return -1;
+		}
+		pr_info("Checksum: %s (%s), appended to every item\n", cs.name, cs.impl);
+	}
+
 	pr_info("Group: %s\n", config->group_name);
 	pr_info("CycleCount: %d\n", config->cycle_count);
+	end = config->records + config->record_count;
+
+	/* DelayChars 按当前波特率和帧格式换算为纳秒 */
+	char_ns = uartdev_char_time_ns(dev);
+	for (rec = config->records; rec < end; rec++) {
+		rec->delay_ns += (int64_t)(rec->delay_chars * char_ns);
+	}
+	if (spin_us > 0) {
+		pr_info("Busy-wait the last %d us of each delay\n", spin_us);
+	}
+
+	/* 有 ExpectHex 的项时，延时期间持续接收并匹配响应 */
+	if (config->expect_count > 0) {
+		expect = malloc(sizeof(expect_t));
+		if (expect == NULL || expect_init(expect, dev, config, timeout_ms) < 0) {
+			free(expect);
+			free_json_config(config);
+			return -1;
+		}
+		pr_info("Expect: %d items wait for a response, up to %d outstanding, default "
+		        "timeout %d ms\n",
+		        config->expect_count, config->max_outstanding, timeout_ms);
+	}
 
 	/* 清空缓冲区 */
 	uartdev_flush(dev);
 
-	/* 执行发送循环 */
+	/* 执行发送循环，数据已在加载时解码，每项的发送时间为上一项的 deadline 加上其延时 */
+	metrics = metrics_port(dev->port);
+	cadence_init(&cadence);
+	cadence.metrics = metrics;
+	slack = timer_slack_set(1);
+	deadline = timing_now_ns();
 	for (cycle = 1; cycle <= config->cycle_count && g_running; cycle++) {
-		pr_info("Cycle: %d/%d\n", cycle, config->cycle_count);
+		if (!g_quiet) {
+			pr_info("Cycle: %d/%d\n", cycle, config->cycle_count);
+		}
 
-		/* 遍历发送列表 */
-		for (i = 0; i < config->send_list_count && g_running; i++) {
-			/* 检查是否启用 */
-			if (config->send_list[i].enable == 0) {
-				continue;
+		/* 遍历启用的发送项 */
+		for (rec = config->records; rec < end && g_running; rec++) {
+			/* 等待中的请求已达 MaxOutstanding 时，先等前面的响应 */
+			if (expect != NULL && rec->expect != NULL && expect_wait_slot(expect) < 0) {
+				ret = -1;
+				break;
 			}
 
-			/* 解析HEX数据 */
-			send_len =
-			    parse_hex_string(config->send_list[i].hex_data,
-			                     send_buf, sizeof(send_buf));
-			if (send_len < 0) {
-				pr_error(
-				    "Failed to parse HexData for item %d\n",
-				    config->send_list[i].number);
-				continue;
-			}
+			cadence_mark(&cadence, deadline);
 
 			/* 发送数据 */
-			if (uartdev_send(dev, send_buf, send_len) != send_len) {
+			now = timing_now_ns();
+			TRACE_BEGIN(write);
+			n = uartdev_send_all(dev, (const char *)config->arena + rec->offset,
+			                     rec->len, &g_running);
+			TRACE_END(write, "write");
+			if (n < 0 && !g_running) {
+				break;
+			}
+			if (n < 0) {
 				pr_error("Failed to send data: %s\n",
 				         strerror(errno));
+				metrics_error(metrics);
 				continue;
 			}
+			if (expect != NULL) {
+				expect_sent(expect, rec, now);
+			}
 
-			total_bytes += send_len;
+			total_bytes += rec->len;
 			sent_count++;
+			metrics_tx(metrics, rec->len);
 
 			/* 打印发送信息 */
-			printf("Send [%d] : hex=\"%s\" (%d bytes, total: %d "
-			       "bytes)\n",
-			       config->send_list[i].number,
-			       config->send_list[i].hex_data, send_len,
-			       total_bytes);
-
-			/* 延时 */
-			if (config->send_list[i].delay > 0) {
-				usleep(config->send_list[i].delay * 1000);
+			TRACE_BEGIN(print);
+			if (!g_quiet) {
+				if (checksum_spec != NULL) {
+					checksum_label(&cs,
+					               config->arena + rec->offset + rec->len -
+					                   checksum_size(&cs),
+					               cs_label, sizeof(cs_label));
+				}
+				printf("Send [%d] : hex=\"%s\"%s (%d bytes, total: %d "
+				       "bytes)\n",
+				       rec->item->number, rec->item->hex_data, cs_label, rec->len,
+				       total_bytes);
+			}
+			TRACE_END(print, "print");
+
+			/* 延时，已经落后时从当前时间重新开始计算 */
+			deadline += rec->delay_ns;
+			now = timing_now_ns();
+			if (deadline < now) {
+				deadline = now;
+				cadence.missed++;
 			}
+			TRACE_BEGIN(expect);
+			n = expect != NULL ? expect_poll_until(expect, deadline - spin_ns) : 0;
+			TRACE_END(expect, "expect");
+			if (n < 0) {
+				ret = -1;
+				break;
+			}
+			cadence_wait(deadline, spin_ns);
+		}
+		if (ret < 0) {
+			break;
 		}
 	}
 
+	timer_slack_set(slack);
 	pr_info("Send completed: sent %d items, total %d bytes\n", sent_count,
 	        total_bytes);
+	cadence_report(&cadence);
+
+	if (expect != NULL) {
+		/* 等待最后几个请求的响应，Ctrl+C 时不再等待 */
+		if (ret == 0 && expect_drain(expect) < 0) {
+			ret = -1;
+		}
+		expect_report(expect);
+		if (expect->failed > 0 || expect->stop || expect->error) {
+			ret = -1;
+		}
+		expect_free(expect);
+		free(expect);
+	}
 
 	/* 清理资源 */
 	free_json_config(config);
 
-	return 0;
+	return ret;
 }